@@ -0,0 +1,202 @@
+#include "block.hpp"
+#include "chunk.hpp"
+#include "collision.hpp"
+#include "terrain.hpp"
+#include "timer.hpp"
+#include "world_view.hpp"
+#include <array>
+#include <cstdint>
+#include <glm/common.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int2.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace engine;
+
+namespace {
+
+constexpr float DT = 1.f / 60.f;
+constexpr float GRAVITY = 10.f;
+constexpr int STEPS = 60;
+
+struct Body {
+  glm::vec3 position;
+  glm::vec3 velocity;
+  // Horizontal velocity the input sets every step
+  glm::vec3 walk;
+  BoxCollider collider;
+};
+
+// Same size as the player, standing on position
+CollisionBox3D boxAt(const glm::vec3 &position) {
+  glm::vec3 halfWidth{0.4f, 0.f, 0.4f};
+  return {position - halfWidth,
+          position + halfWidth + glm::vec3{0.f, 2.f, 0.f}};
+}
+
+// The collision path sweepBox replaced, kept here for comparison. It is
+// Player::getBlocksAround, Player::getBlockBeneath, MovementController::move
+// and the gravity and ground snap steps of App::run as they were.
+
+// Back, front, left, right, then the diagonals, in xz
+constexpr array<glm::ivec2, 8> NEIGHBOURS{
+    {{0, -1}, {0, 1}, {-1, 0}, {1, 0}, {-1, -1}, {1, -1}, {-1, 1}, {1, 1}}};
+
+Block getBlockBeneath(const WorldView &world, const glm::vec3 &position) {
+  glm::ivec3 playerBlock{glm::floor(position)};
+
+  Block blockBeneath{glm::vec3{playerBlock}};
+  blockBeneath.type = world.getBlock(playerBlock - glm::ivec3{0, 1, 0});
+  return blockBeneath;
+}
+
+vector<Block> getBlocksAround(const WorldView &world,
+                              const glm::vec3 &position) {
+  glm::ivec3 playerBlock{glm::floor(position)};
+
+  vector<Block> surroundingBlocks;
+  for (const glm::ivec2 &neighbour : NEIGHBOURS) {
+    for (int y = 0; y < 2; y++) {
+      glm::ivec3 blockPosition =
+          playerBlock + glm::ivec3{neighbour.x, y, neighbour.y};
+      Block block{glm::vec3{blockPosition}};
+      block.type = world.getBlock(blockPosition - glm::ivec3{0, 1, 0});
+      if (block.type != BlockType::Air)
+        surroundingBlocks.push_back(std::move(block));
+    }
+  }
+  return surroundingBlocks;
+}
+
+void oldStep(const WorldView &world, Body &body) {
+  body.velocity.x = body.walk.x;
+  body.velocity.z = body.walk.z;
+  body.collider.collisionBox.min += body.velocity * DT;
+  body.collider.collisionBox.max += body.velocity * DT;
+
+  for (Block &block : getBlocksAround(world, body.position)) {
+    if (body.collider.checkCollision(block.collider.collisionBox)) {
+      Collision3D collision =
+          body.collider.resolveCollision(block.collider.collisionBox);
+      if (collision.direction.x != 0.f)
+        body.velocity.x = 0.f;
+      if (collision.direction.z != 0.f)
+        body.velocity.z = 0.f;
+    }
+  }
+  body.position += body.velocity * DT;
+
+  body.velocity.y -= GRAVITY * DT;
+  body.position += body.velocity * DT;
+  body.collider.collisionBox = boxAt(body.position);
+
+  Block blockBeneath = getBlockBeneath(world, body.position);
+  if (blockBeneath.type != BlockType::Air) {
+    body.position.y = blockBeneath.collider.collisionBox.max.y;
+    body.velocity = glm::vec3{0.f};
+  }
+}
+
+// What MovementController::move does now
+void sweepStep(const WorldView &world, Body &body) {
+  body.velocity.x = body.walk.x;
+  body.velocity.z = body.walk.z;
+  body.velocity.y -= GRAVITY * DT;
+
+  SweepResult sweep =
+      sweepBox(world, boxAt(body.position), body.velocity * DT);
+  body.position += sweep.displacement;
+  for (int axis = 0; axis < 3; axis++)
+    if (sweep.blocked[axis])
+      body.velocity[axis] = 0.f;
+}
+
+int surfaceHeight(const WorldView &world, int x, int z) {
+  int y = 63;
+  while (y >= 0 && world.getBlock({x, y, z}) == BlockType::Air)
+    y--;
+  return y + 1;
+}
+
+// Whether the box at position overlaps a solid block by more than depth
+bool isInsideTerrain(const WorldView &world, const glm::vec3 &position,
+                     float depth) {
+  CollisionBox3D box = boxAt(position);
+  bool inside = false;
+  world.forEachBlockInAABB(box.min + depth, box.max - depth,
+                           [&](const glm::ivec3 &, BlockType type) {
+                             inside = inside || type != BlockType::Air;
+                           });
+  return inside;
+}
+
+// Bodies walking over the terrain, or dropped from fallHeight above it at
+// fallSpeed blocks per step
+vector<Body> makeBodies(const WorldView &world, mt19937 &random,
+                        float fallHeight, float fallSpeed) {
+  uniform_real_distribution<float> coordinate{-50.f, 50.f};
+  uniform_real_distribution<float> angle{0.f, 6.2831853f};
+  vector<Body> bodies;
+  for (int i = 0; i < 1000; i++) {
+    glm::vec3 position{coordinate(random), 0.f, coordinate(random)};
+    position.y = surfaceHeight(world, static_cast<int>(floor(position.x)),
+                               static_cast<int>(floor(position.z)));
+    // The box reaches into the neighbouring columns, which may be higher
+    while (isInsideTerrain(world, position, 0.f))
+      position.y += 1.f;
+    position.y += fallHeight;
+    float direction = angle(random);
+    glm::vec3 walk{sin(direction) * 10.f, 0.f, cos(direction) * 10.f};
+    Body body{position, {0.f, -fallSpeed / DT, 0.f}, walk, {}};
+    body.collider.collisionBox = boxAt(position);
+    bodies.push_back(body);
+  }
+  return bodies;
+}
+
+template <typename Step>
+void run(const char *name, const WorldView &world,
+         const vector<Body> &start, Step &&step) {
+  constexpr uint32_t ITERATIONS = 5;
+  vector<Body> bodies;
+  double nanoseconds = timeNanoseconds(ITERATIONS, [&] {
+    bodies = start;
+    for (int i = 0; i < STEPS; i++)
+      for (Body &body : bodies)
+        step(world, body);
+  });
+
+  int inside = 0;
+  for (const Body &body : bodies)
+    inside += isInsideTerrain(world, body.position, 0.01f);
+  cout << "  " << name << nanoseconds / (STEPS * start.size())
+       << " ns per step, " << inside << " of " << start.size()
+       << " end inside the terrain" << endl;
+}
+
+} // namespace
+
+// A second of steps for 1000 bodies on generated terrain
+int main() {
+  unordered_map<int, Chunk> chunks = generateTerrain({-2, 0, -2}, {1, 1, 1});
+  WorldView world{chunks};
+
+  mt19937 random{49};
+  vector<Body> walking = makeBodies(world, random, 0.f, 0.f);
+  // 40 blocks per step, more than a chunk
+  vector<Body> falling = makeBodies(world, random, 200.f, 40.f);
+
+  cout << "collision_bench: 1000 bodies, " << STEPS << " steps" << endl;
+  cout << " walking" << endl;
+  run("getBlocksAround ", world, walking, oldStep);
+  run("sweepBox        ", world, walking, sweepStep);
+  cout << " falling 40 blocks per step" << endl;
+  run("getBlocksAround ", world, falling, oldStep);
+  run("sweepBox        ", world, falling, sweepStep);
+  return 0;
+}
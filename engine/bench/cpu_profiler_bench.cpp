@@ -0,0 +1,25 @@
+#include "core/cpu_profiler.hpp"
+#include "timer.hpp"
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+using namespace engine;
+
+// Cost of an empty PROFILE_SCOPE, long enough for the ring to wrap many times
+int main() {
+  constexpr uint32_t ITERATIONS = CpuProfiler::EVENTS_PER_THREAD * 64;
+
+  double clock = timeNanoseconds(ITERATIONS, [] {
+    volatile int64_t now = CpuProfiler::now();
+    (void)now;
+  });
+  double scope =
+      timeNanoseconds(ITERATIONS, [] { PROFILE_SCOPE("empty scope"); });
+
+  cout << "cpu_profiler_bench: " << ITERATIONS << " scopes" << endl;
+  cout << "  CpuProfiler::now " << clock << " ns" << endl;
+  cout << "  PROFILE_SCOPE    " << scope << " ns, two clock reads included"
+       << endl;
+  return 0;
+}
@@ -0,0 +1,56 @@
+#include "core/box_list.hpp"
+#include "core/camera.hpp"
+#include "core/frustum.hpp"
+#include "timer.hpp"
+#include <cstdint>
+#include <glm/ext/vector_float3.hpp>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+using namespace std;
+using namespace engine;
+
+// Culls a 128 x 128 field of chunk boxes, four layers high, from a camera in
+// its middle
+int main() {
+  constexpr int FIELD_SIZE = 128;
+  constexpr int LAYERS = 4;
+  constexpr uint32_t BOX_COUNT = FIELD_SIZE * FIELD_SIZE * LAYERS;
+  constexpr uint32_t ITERATIONS = 200;
+
+  BoxList boxes{BOX_COUNT};
+  uint32_t index = 0;
+  for (int y = 0; y < LAYERS; y++) {
+    for (int z = 0; z < FIELD_SIZE; z++) {
+      for (int x = 0; x < FIELD_SIZE; x++) {
+        glm::vec3 min =
+            glm::vec3{x - FIELD_SIZE / 2, y, z - FIELD_SIZE / 2} * 32.f;
+        boxes.set(index++, min, min + 32.f);
+      }
+    }
+  }
+
+  Camera camera;
+  camera.setPerspectiveProjection(glm::radians(60.f), 1.5f, 0.1f, 1000.f);
+  camera.setView({0.f, 64.f, 0.f}, {0.3f, 0.8f, 0.f});
+  Frustum frustum =
+      Frustum::fromMatrix(camera.getProjection() * camera.getView());
+
+  vector<uint8_t> visible(BOX_COUNT);
+  double scalar = timeNanoseconds(ITERATIONS, [&] {
+    frustum.testBoxesScalar(boxes, BOX_COUNT, visible.data());
+  });
+  double simd = timeNanoseconds(ITERATIONS, [&] {
+    frustum.testBoxes(boxes, BOX_COUNT, visible.data());
+  });
+  uint32_t visibleCount = accumulate(visible.begin(), visible.end(), 0u);
+
+  cout << "frustum_bench: " << BOX_COUNT << " boxes, " << visibleCount
+       << " visible" << endl;
+  cout << "  testBoxesScalar " << scalar / 1000.0 << " us, "
+       << scalar / BOX_COUNT << " ns per box" << endl;
+  cout << "  testBoxes       " << simd / 1000.0 << " us, "
+       << simd / BOX_COUNT << " ns per box, " << scalar / simd << "x" << endl;
+  return 0;
+}
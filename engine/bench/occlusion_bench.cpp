@@ -0,0 +1,96 @@
+#include "core/camera.hpp"
+#include "core/occlusion_culler.hpp"
+#include "timer.hpp"
+#include <cstdint>
+#include <glm/ext/vector_float3.hpp>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace engine;
+
+namespace {
+
+struct Box {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// Cells of buried columns like Chunk::calculateOccluders makes them, for the
+// 16 chunks nearest to the camera
+vector<Box> makeOccluders(mt19937 &random) {
+  uniform_int_distribution<int> height{16, 32};
+  vector<Box> occluders;
+  for (int chunkZ = 0; chunkZ < 4; chunkZ++) {
+    for (int chunkX = -2; chunkX < 2; chunkX++) {
+      for (int cellZ = 0; cellZ < 32; cellZ += 8) {
+        for (int cellX = 0; cellX < 32; cellX += 8) {
+          glm::vec3 min{chunkX * 32 + cellX, 0, chunkZ * 32 + cellZ};
+          occluders.push_back(
+              {min, min + glm::vec3{8, static_cast<float>(height(random)), 8}});
+        }
+      }
+    }
+  }
+  return occluders;
+}
+
+} // namespace
+
+// Same buffer size and occluder count as App::cullDrawCalls, tested with
+// chunk boxes behind them
+int main() {
+  constexpr uint32_t ITERATIONS = 200;
+  constexpr int OCCLUDEE_COUNT = 10000;
+
+  mt19937 random{33};
+  vector<Box> occluders = makeOccluders(random);
+  vector<Box> occludees;
+  uniform_real_distribution<float> x{-400.f, 400.f};
+  uniform_real_distribution<float> y{-64.f, 0.f};
+  uniform_real_distribution<float> z{40.f, 400.f};
+  for (int i = 0; i < OCCLUDEE_COUNT; i++) {
+    glm::vec3 min{x(random), y(random), z(random)};
+    occludees.push_back({min, min + 32.f});
+  }
+
+  Camera camera;
+  camera.setPerspectiveProjection(glm::radians(60.f), 1.5f, 0.1f, 1000.f);
+  camera.setView({0.f, 34.f, -8.f}, {0.2f, 0.f, 0.f});
+  OcclusionCuller3D culler{240, 160};
+  glm::mat4 projectionView = camera.getProjection() * camera.getView();
+
+  double rasterizeScalar = timeNanoseconds(ITERATIONS, [&] {
+    culler.clear(projectionView);
+    for (const Box &box : occluders)
+      culler.addOccluderScalar(box.min, box.max);
+  });
+  double rasterize = timeNanoseconds(ITERATIONS, [&] {
+    culler.clear(projectionView);
+    for (const Box &box : occluders)
+      culler.addOccluder(box.min, box.max);
+  });
+
+  int occluded = 0;
+  double testScalar = timeNanoseconds(ITERATIONS, [&] {
+    occluded = 0;
+    for (const Box &box : occludees)
+      occluded += culler.isOccludedScalar(box.min, box.max);
+  });
+  double test = timeNanoseconds(ITERATIONS, [&] {
+    occluded = 0;
+    for (const Box &box : occludees)
+      occluded += culler.isOccluded(box.min, box.max);
+  });
+
+  cout << "occlusion_bench: " << occluders.size() << " occluders, "
+       << occluded << " of " << OCCLUDEE_COUNT << " boxes occluded" << endl;
+  cout << "  addOccluderScalar " << rasterizeScalar / 1000.0 << " us" << endl;
+  cout << "  addOccluder       " << rasterize / 1000.0 << " us, "
+       << rasterizeScalar / rasterize << "x" << endl;
+  cout << "  isOccludedScalar  " << testScalar / 1000.0 << " us" << endl;
+  cout << "  isOccluded        " << test / 1000.0 << " us, "
+       << testScalar / test << "x" << endl;
+  return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "chunk.hpp"
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <unordered_map>
+
+namespace engine {
+
+// Chunks firstChunk to lastChunk included on every axis, generated like the
+// game's terrain
+inline std::unordered_map<int, Chunk>
+generateTerrain(const glm::ivec3 &firstChunk, const glm::ivec3 &lastChunk) {
+  ChunkGenerator generator;
+  std::unordered_map<int, Chunk> chunks;
+  for (int cy = firstChunk.y; cy <= lastChunk.y; cy++) {
+    for (int cz = firstChunk.z; cz <= lastChunk.z; cz++) {
+      for (int cx = firstChunk.x; cx <= lastChunk.x; cx++) {
+        chunks.insert({getChunkKey({cx, cy, cz}),
+                       generator.generate(glm::vec3{cx, cy, cz} * 32.f)});
+      }
+    }
+  }
+  return chunks;
+}
+
+} // namespace engine
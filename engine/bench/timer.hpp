@@ -0,0 +1,17 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+namespace engine {
+
+// Mean wall time of a single call of f over iterations calls, in nanoseconds
+template <typename F> double timeNanoseconds(uint32_t iterations, F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++)
+    f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+} // namespace engine
@@ -0,0 +1,59 @@
+#include "chunk.hpp"
+#include "terrain.hpp"
+#include "timer.hpp"
+#include "voxel_raycast.hpp"
+#include "world_view.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <glm/ext/vector_float3.hpp>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace engine;
+
+// Rays from above generated terrain down into it at every angle, like
+// picking or line of sight checks from the player
+int main() {
+  constexpr uint32_t ITERATIONS = 10;
+  constexpr int RAY_COUNT = 100000;
+
+  unordered_map<int, Chunk> chunks = generateTerrain({-3, 0, -3}, {2, 1, 2});
+
+  mt19937 random{50};
+  uniform_real_distribution<float> coordinate{-64.f, 64.f};
+  uniform_real_distribution<float> height{40.f, 64.f};
+  uniform_real_distribution<float> component{-1.f, 1.f};
+  vector<Ray> rays;
+  for (int i = 0; i < RAY_COUNT; i++) {
+    glm::vec3 origin{coordinate(random), height(random), coordinate(random)};
+    glm::vec3 direction{component(random), component(random) - 0.5f,
+                        component(random)};
+    rays.push_back({origin, direction, 64.f});
+  }
+  vector<RayHit> hits(RAY_COUNT);
+
+  WorldView world{chunks};
+  double serial = timeNanoseconds(ITERATIONS, [&] {
+    raycast(world, rays.data(), rays.size(), hits.data());
+  });
+  int hitCount = 0;
+  for (const RayHit &hit : hits)
+    hitCount += hit.hit;
+
+  unsigned threadCount = max(thread::hardware_concurrency(), 1u);
+  double threaded = timeNanoseconds(ITERATIONS, [&] {
+    raycast(chunks, rays.data(), rays.size(), hits.data(), threadCount);
+  });
+
+  cout << "voxel_raycast_bench: " << RAY_COUNT << " rays, " << hitCount
+       << " hit the terrain" << endl;
+  cout << "  one WorldView      " << RAY_COUNT / serial * 1e3
+       << " million rays/s" << endl;
+  cout << "  split on " << threadCount << " threads "
+       << RAY_COUNT / threaded * 1e3 << " million rays/s" << endl;
+  return 0;
+}
@@ -1,17 +1,26 @@
 #include "app.hpp"
+#include "block.hpp"
 #include "chunk.hpp"
 #include "collision.hpp"
 #include "core/buffer.hpp"
+#include "core/cpu_profiler.hpp"
+#include "core/frustum.hpp"
 #include "core/game_object.hpp"
+#include "core/gpu_culler.hpp"
+#include "core/gpu_profiler.hpp"
 #include "core/model.hpp"
 #include "core/occlusion_culler.hpp"
 #include "core/swapchain.hpp"
+#include "input_recording.hpp"
 #include "movement_controller.hpp"
 #include "player.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <glm/common.hpp>
 #include <glm/detail/qualifier.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
@@ -20,9 +29,12 @@
 #include <glm/fwd.hpp>
 #include <glm/geometric.hpp>
 #include <glm/trigonometric.hpp>
+#include <iostream>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -34,10 +46,84 @@ using namespace std;
 
 namespace engine {
 
-int RENDER_DISTANCE = 6;
 const int MAX_DRAW_CALLS = 10000;
 const int WIDTH = 1200;
 const int HEIGHT = 800;
+const size_t MAX_OCCLUDER_CHUNKS = 16;
+const float PLAYER_EYE_HEIGHT = 1.6f;
+// Zero keeps the GPU timings out of the console
+const chrono::milliseconds GPU_PROFILER_LOG_INTERVAL{0};
+// Chunks outside the view frustum count as this much farther away
+const float OFF_SCREEN_WEIGHT = 2.f;
+// A resident chunk is only replaced by one scoring this much better, so
+// chunks at a similar distance don't keep replacing each other
+const float RESIDENCY_HYSTERESIS = 1.5f;
+// Frames between two reads of the device local heap budget
+const uint32_t HEAP_BUDGET_INTERVAL = 30;
+
+namespace {
+
+VkDeviceSize getMeshBytes(size_t vertexCount, size_t indexCount) {
+  return vertexCount * sizeof(Model::Vertex) + indexCount * sizeof(uint32_t);
+}
+
+// Lower is more worth keeping on the GPU
+float getResidencyScore(const Chunk &chunk, const Frustum &frustum,
+                        const glm::vec3 &cameraPosition) {
+  glm::vec3 min = chunk.transform.position;
+  glm::vec3 max = min + glm::vec3{32.f};
+  float score = glm::distance(cameraPosition, (min + max) / 2.f);
+  if (!frustum.intersects(min, max))
+    score *= OFF_SCREEN_WEIGHT;
+  return score;
+}
+
+void printHeapBudgets(MemoryAllocator &allocator) {
+  vector<HeapBudget> heapBudgets = allocator.getHeapBudgets();
+  for (size_t i = 0; i < heapBudgets.size(); i++) {
+    const HeapBudget &heap = heapBudgets[i];
+    cout << "Heap " << i << (heap.deviceLocal ? " (device)" : " (host)")
+         << ": " << heap.usage / (1024 * 1024) << " of "
+         << heap.budget / (1024 * 1024) << "MB budget in use, "
+         << heap.allocated / (1024 * 1024) << "MB by the engine" << endl;
+  }
+  if (!allocator.supportsMemoryBudget())
+    cout << "No VK_EXT_memory_budget, heap usage only counts the engine"
+         << endl;
+}
+
+void printTimingReport(const vector<InputFrame> &frames,
+                       const vector<double> &frameTimes,
+                       const string &reportPath) {
+  if (frameTimes.empty())
+    return;
+
+  if (!reportPath.empty()) {
+    ofstream report(reportPath);
+    if (!report)
+      throw runtime_error("Failed to open " + reportPath + "!");
+    report << "frame,dt_ms,frame_ms\n";
+    for (size_t i = 0; i < frameTimes.size(); i++)
+      report << i << "," << frames[i].deltaTime * 1000.f << ","
+             << frameTimes[i] << "\n";
+  }
+
+  vector<double> sorted = frameTimes;
+  sort(sorted.begin(), sorted.end());
+  double sum = 0.0;
+  for (double frameTime : sorted)
+    sum += frameTime;
+
+  auto percentile = [&](size_t percent) {
+    return sorted[min(sorted.size() - 1, sorted.size() * percent / 100)];
+  };
+  cout << "Replayed " << sorted.size() << " frames: avg "
+       << sum / sorted.size() << "ms, p50 " << percentile(50) << "ms, p95 "
+       << percentile(95) << "ms, p99 " << percentile(99) << "ms, max "
+       << sorted.back() << "ms" << endl;
+}
+
+} // namespace
 
 struct GlobalUbo {
   glm::mat4 projectionView{1.f};
@@ -46,7 +132,7 @@ struct GlobalUbo {
   alignas(16) glm::vec4 lightColor{1.f};
 };
 
-App::App() {
+App::App(const AppOptions &options) : options{options} {
   descriptorPool = DescriptorPool::Builder(device)
                        .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
                        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
@@ -55,32 +141,26 @@ App::App() {
                                     SwapChain::MAX_FRAMES_IN_FLIGHT)
                        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                     SwapChain::MAX_FRAMES_IN_FLIGHT)
-                       .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                    SwapChain::MAX_FRAMES_IN_FLIGHT)
                        .build();
 }
 
 void App::run() {
+  PROFILE_THREAD("main");
   worldModel = make_unique<Model>(device);
 
   vector<shared_ptr<Buffer>> drawCallBuffers(SwapChain::MAX_FRAMES_IN_FLIGHT);
   for (int i = 0; i < static_cast<int>(drawCallBuffers.size()); i++) {
     drawCallBuffers[i] = make_unique<Buffer>(
         device, sizeof(VkDrawIndexedIndirectCommand), MAX_DRAW_CALLS,
-        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     drawCallBuffers[i]->map();
   }
 
-  vector<shared_ptr<Buffer>> objectDataBuffers(SwapChain::MAX_FRAMES_IN_FLIGHT);
-  for (int i = 0; i < static_cast<int>(objectDataBuffers.size()); i++) {
-    objectDataBuffers[i] =
-        make_unique<Buffer>(device, sizeof(ObjectData), MAX_DRAW_CALLS,
-                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    objectDataBuffers[i]->map();
-  }
+  SlotBuffer drawDataStore{device, sizeof(ChunkDrawData), MAX_DRAW_CALLS};
+  SlotBuffer boundsStore{device, sizeof(DrawBounds), MAX_DRAW_CALLS};
 
   vector<unique_ptr<Buffer>> uboBuffers(SwapChain::MAX_FRAMES_IN_FLIGHT);
   for (int i = 0; i < static_cast<int>(uboBuffers.size()); i++) {
@@ -90,16 +170,12 @@ void App::run() {
     uboBuffers[i]->map();
   }
 
-  VkImageView textureImageView;
-  VkSampler textureSampler;
-
-  device.generateImage("textures/gras.jpeg", textureImageView, textureSampler);
-
-  VkImageView topTextureImageView;
-  VkSampler topTextureSampler;
-
-  device.generateImage("textures/gras_top.jpg", topTextureImageView,
-                       topTextureSampler);
+  // One layer per block face texture, so new blocks need no new bindings
+  VkImageView blockTextureView;
+  VkSampler blockTextureSampler;
+  device.generateImageArray(
+      {BLOCK_TEXTURE_FILES.begin(), BLOCK_TEXTURE_FILES.end()},
+      blockTextureView, blockTextureSampler);
 
   auto descriptorSetLayout =
       DescriptorSetLayout::Builder(device)
@@ -109,30 +185,40 @@ void App::run() {
                       VK_SHADER_STAGE_VERTEX_BIT)
           .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                       VK_SHADER_STAGE_FRAGMENT_BIT)
-          .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                      VK_SHADER_STAGE_FRAGMENT_BIT)
           .build();
 
   vector<VkDescriptorSet> descriptorSets(SwapChain::MAX_FRAMES_IN_FLIGHT);
   for (int i = 0; i < static_cast<int>(descriptorSets.size()); i++) {
     auto bufferInfo = uboBuffers[i]->descriptorInfo();
-    auto ODBInfo = objectDataBuffers[i]->descriptorInfo();
+    auto drawDataInfo = drawDataStore.getBuffer()->descriptorInfo();
     auto imageInfo =
-        VkDescriptorImageInfo{textureSampler, textureImageView,
-                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-    auto topImageInfo =
-        VkDescriptorImageInfo{topTextureSampler, topTextureImageView,
+        VkDescriptorImageInfo{blockTextureSampler, blockTextureView,
                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
     DescriptorWriter(*descriptorSetLayout, *descriptorPool)
         .writeBuffer(0, &bufferInfo)
-        .writeBuffer(1, &ODBInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+        .writeBuffer(1, &drawDataInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
         .writeImage(2, &imageInfo)
-        .writeImage(3, &topImageInfo)
         .build(descriptorSets[i]);
   }
 
   RenderSystem renderSystem{device, window,
                             descriptorSetLayout->getDescriptorSetLayout()};
+  GpuProfiler &gpuProfiler = renderSystem.getGpuProfiler();
+  gpuProfiler.setLogInterval(GPU_PROFILER_LOG_INTERVAL);
+
+  // Without drawIndirectCount the whole dense list is drawn unculled
+  unique_ptr<GpuCuller> gpuCuller;
+  if (device.supportsDrawIndirectCount())
+    gpuCuller = make_unique<GpuCuller>(device, MAX_DRAW_CALLS, drawCallBuffers,
+                                       *boundsStore.getBuffer(),
+                                       renderSystem.getExtent());
+
+  VkDeviceSize terrainCapacity =
+      getMeshBytes(Model::MAX_VERTEX_COUNT, Model::MAX_INDEX_COUNT);
+  terrainBudgetLimit = options.terrainBudget == 0
+                           ? terrainCapacity
+                           : min(options.terrainBudget, terrainCapacity);
+  terrainBudget = terrainBudgetLimit;
 
   Camera camera{};
   camera.setPerspectiveProjection(glm::radians(90.f),
@@ -144,26 +230,45 @@ void App::run() {
   player.transform.position = {0.f, 80.f, 0.f};
   player.transform.scale = {0.8f, 2.f, 0.8f};
 
-  ChunkLoader chunkLoader{device, chunkQueue, chunkUnloadQueue, queueMutex};
-  chunkLoader.startChunkThread(player, chunks);
+  unique_ptr<InputRecorder> inputRecorder;
+  if (!options.recordPath.empty())
+    inputRecorder = make_unique<InputRecorder>(options.recordPath);
+
+  unique_ptr<InputReplay> inputReplay;
+  uint32_t frameLimit = options.frameLimit;
+  vector<InputFrame> replayedFrames;
+  vector<double> replayFrameTimes;
+  if (!options.replayPath.empty()) {
+    inputReplay = make_unique<InputReplay>(options.replayPath);
+    uint32_t frameCount = static_cast<uint32_t>(inputReplay->getFrameCount());
+    if (frameLimit == 0 || frameLimit > frameCount)
+      frameLimit = frameCount;
+  }
 
-  glm::vec3 colliderMin =
-      player.transform.position - glm::vec3{player.transform.scale.x / 2.f, 0,
-                                            player.transform.scale.z / 2.f};
-  glm::vec3 colliderMax =
-      player.transform.position + glm::vec3{player.transform.scale.x / 2.f,
-                                            player.transform.scale.y,
-                                            player.transform.scale.z / 2.f};
-  player.collider = BoxCollider(colliderMin, colliderMax);
+  // Replays stream chunks on this thread, so no run depends on how far the
+  // chunk thread got
+  ChunkLoader chunkLoader{chunkQueue, chunkUnloadQueue, queueMutex};
+  if (inputReplay == nullptr)
+    chunkLoader.startChunkThread(player, chunks);
+
+  CollisionBox3D playerBox = player.getCollisionBox();
+  player.collider = BoxCollider(playerBox.min, playerBox.max);
 
   auto currentTime = chrono::high_resolution_clock::now();
+  auto startTime = currentTime;
+
+  while (!window.shouldClose() &&
+         (frameLimit == 0 || frameCounter < frameLimit)) {
+    PROFILE_SCOPE("frame");
 
-  while (!window.shouldClose()) {
     /* GLFW Poll Events */
 
-    glfwPollEvents();
-    if (glfwGetKey(window.getGLFWwindow(), GLFW_KEY_ESCAPE))
-      window.close();
+    if (!options.headless) {
+      PROFILE_SCOPE("input");
+      glfwPollEvents();
+      if (glfwGetKey(window.getGLFWwindow(), GLFW_KEY_ESCAPE))
+        window.close();
+    }
 
     /* Delta Time */
 
@@ -173,49 +278,54 @@ void App::run() {
             .count();
     currentTime = newTime;
 
+    /* Input */
+
+    // Recorded steps replace the wall clock
+    InputFrame inputFrame{deltaTime, {}};
+    if (inputReplay != nullptr) {
+      inputReplay->next(inputFrame);
+      replayedFrames.push_back(inputFrame);
+    } else if (!options.headless) {
+      inputFrame.input = movementController.pollInput(window.getGLFWwindow());
+    }
+    if (inputRecorder != nullptr)
+      inputRecorder->record(inputFrame);
+    deltaTime = inputFrame.deltaTime;
+
     /* Movement */
 
-    movementController.move(window.getGLFWwindow(), player, chunks, deltaTime);
-    player.rigidBody.update(player.transform.position, deltaTime);
-    camera.follow(player.transform.position, player.transform.rotation);
+    {
+      PROFILE_SCOPE("movement");
+      movementController.move(inputFrame.input, player, chunks, queueMutex,
+                              deltaTime);
+      camera.follow(player.transform.position, player.transform.rotation,
+                    {0.f, PLAYER_EYE_HEIGHT, 0.f});
+    }
 
     /* Chunk Loading */
 
-    chunkLoader.unloadOutOfRangeChunks(player, chunks, freeChunks);
+    {
+      PROFILE_SCOPE("chunk unloading");
+      chunkLoader.unloadOutOfRangeChunks(player, chunks, freeChunks);
+    }
+
+    if (inputReplay != nullptr) {
+      PROFILE_SCOPE("chunk streaming");
+      chunkLoader.queueMissingChunks(player, chunks);
+    }
 
     /* Gravity */
 
     if (chunks.size() > 7) {
+      PROFILE_SCOPE("gravity");
       player.rigidBody.applyGravity(deltaTime);
-      player.rigidBody.update(player.transform.position, deltaTime);
-      player.collider.collisionBox.min =
-          player.transform.position - glm::vec3{player.transform.scale.x / 2.f,
-                                                0,
-                                                player.transform.scale.z / 2.f};
-      player.collider.collisionBox.max =
-          player.transform.position + glm::vec3{player.transform.scale.x / 2.f,
-                                                player.transform.scale.y,
-                                                player.transform.scale.z / 2.f};
-    }
-
-    /* Collision Detection World */
-
-    {
-      lock_guard<mutex> lock(queueMutex);
-      Block blockBeneathPlayer = player.getBlockBeneath(chunks);
-      if (blockBeneathPlayer.type != BlockType::Air) {
-        player.transform.position.y =
-            blockBeneathPlayer.collider.collisionBox.max.y;
-        player.canJump = true;
-        player.rigidBody.resetVelocity();
-      }
     }
 
     /* Rendering */
 
-    queue<Chunk *> pushQueue;
     while (!chunkQueue.empty()) {
       {
+        PROFILE_SCOPE("chunk insertion");
         lock_guard<mutex> lock(queueMutex);
 
         int chunkIndex =
@@ -226,285 +336,492 @@ void App::run() {
 
         if (chunks.at(chunkIndex).blocks.size() != 1 ||
             chunks.at(chunkIndex).blocks[0].type != BlockType::Air)
-          pushQueue.push(&chunks.at(chunkIndex));
+          pushQueue.push(chunkIndex);
       }
     }
 
-    if (auto commandBuffer = renderSystem.beginFrame()) {
+    VkCommandBuffer commandBuffer;
+    {
+      PROFILE_SCOPE("acquire");
+      commandBuffer = renderSystem.beginFrame();
+    }
+
+    if (commandBuffer != nullptr) {
+      PROFILE_SCOPE("render");
       int frameIndex = renderSystem.getFrameIndex();
+      if (!options.capturePath.empty() && frameCounter + 1 == frameLimit)
+        renderSystem.captureFrame(options.capturePath);
 
-      loadWorldModel(pushQueue, objectDataBuffers, drawCallBuffers);
+      {
+        PROFILE_SCOPE("loadWorldModel");
+        loadWorldModel(frameIndex, camera.getProjection() * camera.getView(),
+                       player.transform.position, drawDataStore, boundsStore);
+        // Chunks then get their draw calls on the same frame every run
+        if (inputReplay != nullptr)
+          uploadService.wait(uploadService.lastSubmittedValue());
+      }
+      // Chunk copies run on the transfer queue, outside the frame's
+      // command buffer
+      for (double milliseconds : uploadService.takeTimings())
+        gpuProfiler.addSample("transfer uploads", milliseconds);
 
-      GlobalUbo ubo{};
-      ubo.projectionView = camera.getProjection() * camera.getView();
-      uboBuffers[frameIndex]->writeToBuffer(&ubo);
-      uboBuffers[frameIndex]->flush();
+      {
+        PROFILE_SCOPE("command recording");
+        gpuProfiler.beginScope(commandBuffer, "uploads");
+        drawDataStore.flush(commandBuffer, frameIndex);
+        boundsStore.flush(commandBuffer, frameIndex);
+        gpuProfiler.endScope(commandBuffer);
+
+        GlobalUbo ubo{};
+        ubo.projectionView = camera.getProjection() * camera.getView();
+        uboBuffers[frameIndex]->writeToBuffer(&ubo);
+        uboBuffers[frameIndex]->flush();
+
+        uint32_t drawCount = drawList.size();
+        if (gpuCuller)
+          updateDrawCalls(frameIndex, drawCallBuffers);
+        else
+          drawCount = cullDrawCalls(frameIndex, ubo.projectionView,
+                                    player.transform.position, drawCallBuffers);
+
+        FrameInfo frameInfo{frameIndex,
+                            commandBuffer,
+                            camera,
+                            descriptorSets[frameIndex],
+                            drawCallBuffers[frameIndex],
+                            drawDataStore.getBuffer()};
+
+        if (gpuCuller) {
+          gpuCuller->beginFrame(frameIndex, ubo.projectionView,
+                                renderSystem.getExtent());
+          gpuProfiler.beginScope(commandBuffer, "culling");
+          gpuCuller->cull(commandBuffer, frameIndex, drawList.size(),
+                          GpuCuller::Early);
+          gpuProfiler.endScope(commandBuffer);
+          frameInfo.drawCallBuffer =
+              gpuCuller->getDrawCallBuffer(frameIndex, GpuCuller::Early);
+          frameInfo.drawCountBuffer =
+              gpuCuller->getDrawCountBuffer(frameIndex, GpuCuller::Early);
+        }
 
-      FrameInfo frameInfo{frameIndex,
-                          commandBuffer,
-                          camera,
-                          descriptorSets[frameIndex],
-                          drawCallBuffers[frameIndex],
-                          objectDataBuffers[frameIndex]};
+        gpuProfiler.beginScope(commandBuffer, "world draw");
+        renderSystem.recordCommandBuffer(commandBuffer);
+        renderSystem.renderWorld(frameInfo, worldModel, drawCount);
+        renderSystem.endRenderPass(commandBuffer);
+        gpuProfiler.endScope(commandBuffer);
+
+        if (gpuCuller) {
+          gpuProfiler.beginScope(commandBuffer, "culling");
+          gpuCuller->buildDepthPyramid(commandBuffer, frameIndex,
+                                       renderSystem.getCurrentDepthImage(),
+                                       renderSystem.getCurrentDepthImageView());
+          gpuCuller->cull(commandBuffer, frameIndex, drawList.size(),
+                          GpuCuller::Late);
+          gpuProfiler.endScope(commandBuffer);
+          frameInfo.drawCallBuffer =
+              gpuCuller->getDrawCallBuffer(frameIndex, GpuCuller::Late);
+          frameInfo.drawCountBuffer =
+              gpuCuller->getDrawCountBuffer(frameIndex, GpuCuller::Late);
+
+          gpuProfiler.beginScope(commandBuffer, "world draw");
+          renderSystem.resumeRenderPass(commandBuffer);
+          renderSystem.renderWorld(frameInfo, worldModel, drawList.size());
+          renderSystem.endRenderPass(commandBuffer);
+          gpuProfiler.endScope(commandBuffer);
+        }
+      }
 
-      renderSystem.recordCommandBuffer(commandBuffer);
-      renderSystem.renderWorld(frameInfo, worldModel, drawCallCounter);
-      renderSystem.endRenderPass(commandBuffer);
-      renderSystem.endFrame();
+      PROFILE_SCOPE("submit");
+      renderSystem.endFrame({uploadService.getSemaphore(), publishedUploadValue,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT});
     }
 
     chrono::duration<double> frameTime =
         chrono::high_resolution_clock::now() - currentTime;
     // cout << "Frame Time: " << frameTime.count() * 1000 << "ms" << endl;
     // cout << "\rFps: " << 1.0 / frameTime.count() << flush;
+    if (inputReplay != nullptr)
+      replayFrameTimes.push_back(
+          chrono::duration<double, milli>(
+              chrono::high_resolution_clock::now() - newTime)
+              .count());
     frameCounter++;
   }
 
-  chunkLoader.running = false;
-  chunkThread.join();
+  chrono::duration<double> runTime =
+      chrono::high_resolution_clock::now() - startTime;
+  printTimingReport(replayedFrames, replayFrameTimes, options.reportPath);
+  if (frameLimit != 0) {
+    cout << "Rendered " << frameCounter << " frames in " << runTime.count()
+         << "s, " << runTime.count() * 1000 / frameCounter << "ms per frame"
+         << endl;
+    cout << "Terrain uses " << terrainBytes / (1024 * 1024) << " of "
+         << terrainBudget / (1024 * 1024) << "MB budget, "
+         << evictedChunks.size() << " chunks evicted" << endl;
+    printHeapBudgets(device.getMemoryAllocator());
+  }
+
+  if (!options.cpuTracePath.empty())
+    CpuProfiler::writeTrace(options.cpuTracePath);
+
+  vkDeviceWaitIdle(device.device());
+
+  chunkLoader.stop();
 }
 
-void App::loadWorldModel(queue<Chunk *> &pushQueue,
-                         vector<shared_ptr<Buffer>> objectDataBuffers,
-                         vector<shared_ptr<Buffer>> drawCallBuffers) {
+void App::loadWorldModel(int frameIndex, const glm::mat4 &projectionView,
+                         const glm::vec3 &cameraPosition,
+                         SlotBuffer &drawDataStore, SlotBuffer &boundsStore) {
+  releaseChunks(frameIndex);
+  publishUploads(drawDataStore, boundsStore);
+  stagingRing.release(uploadService.completedValue());
+
+  Frustum frustum = Frustum::fromMatrix(projectionView);
+  updateTerrainResidency(frustum, cameraPosition);
+
   if (pushQueue.empty())
     return;
 
-  VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+  // All upload command buffers are busy, try again next frame
+  VkCommandBuffer commandBuffer = uploadService.begin();
+  if (commandBuffer == VK_NULL_HANDLE)
+    return;
+
+  size_t firstUpload = pendingUploads.size();
   while (!pushQueue.empty()) {
-    Chunk *chunk = pushQueue.front();
-
-    size_t vertexBlockSize;
-    if (chunk->getMesh().first.size() * sizeof(Model::Vertex) <
-        ChunkSize::Tiny) {
-      vertexBlockSize = ChunkSize::Tiny;
-    } else if (chunk->getMesh().first.size() * sizeof(Model::Vertex) <
-               ChunkSize::Small) {
-      vertexBlockSize = ChunkSize::Small;
-    } else if (chunk->getMesh().first.size() * sizeof(Model::Vertex) <
-               ChunkSize::Medium) {
-      vertexBlockSize = ChunkSize::Medium;
-    } else if (chunk->getMesh().first.size() * sizeof(Model::Vertex) <
-               ChunkSize::Large) {
-      vertexBlockSize = ChunkSize::Large;
-    } else if (chunk->getMesh().first.size() * sizeof(Model::Vertex) <
-               ChunkSize::Huge) {
-      vertexBlockSize = ChunkSize::Huge;
-    } else {
-      vertexBlockSize = ChunkSize::Max;
+    auto chunkIt = chunks.find(pushQueue.front());
+    if (chunkIt == chunks.end()) {
+      pushQueue.pop();
+      continue;
+    }
+
+    Chunk *chunk = &chunkIt->second;
+    const auto &mesh = chunk->getMesh();
+    if (mesh.second.empty() || chunk->bufferMemory.isResident()) {
+      pushQueue.pop();
+      continue;
     }
 
-    size_t indexBlockSize;
-    if (chunk->getMesh().second.size() * sizeof(uint32_t) < ChunkSize::Tiny) {
-      indexBlockSize = ChunkSize::Tiny;
-    } else if (chunk->getMesh().second.size() * sizeof(uint32_t) <
-               ChunkSize::Small) {
-      indexBlockSize = ChunkSize::Small;
-    } else if (chunk->getMesh().second.size() * sizeof(uint32_t) <
-               ChunkSize::Medium) {
-      indexBlockSize = ChunkSize::Medium;
-    } else if (chunk->getMesh().second.size() * sizeof(uint32_t) <
-               ChunkSize::Large) {
-      indexBlockSize = ChunkSize::Large;
-    } else if (chunk->getMesh().second.size() * sizeof(uint32_t) <
-               ChunkSize::Huge) {
-      indexBlockSize = ChunkSize::Huge;
-    } else {
-      indexBlockSize = ChunkSize::Max;
+    VkDeviceSize vertexDataSize = mesh.first.size() * sizeof(Model::Vertex);
+    VkDeviceSize indexDataSize = mesh.second.size() * sizeof(uint32_t);
+    if (!makeTerrainRoom(vertexDataSize + indexDataSize,
+                         getResidencyScore(*chunk, frustum, cameraPosition))) {
+      evictedChunks.insert(chunkIt->first);
+      pushQueue.pop();
+      continue;
     }
 
-    if (freeChunks.empty()) {
-      auto *objectDataBuffer = (ObjectData *)objectDataBuffers[0]->mappedData();
-      auto *drawCallBuffer =
-          (VkDrawIndexedIndirectCommand *)drawCallBuffers[0]->mappedData();
-      objectDataBuffer[drawCallCounter] = {chunk->transform.mat4(),
-                                           chunk->transform.normalMatrix()};
-
-      VkDrawIndexedIndirectCommand indirectCommand{};
-      indirectCommand.indexCount = chunk->getMesh().second.size();
-      indirectCommand.instanceCount = 1;
-      indirectCommand.firstIndex = firstIndex;
-      indirectCommand.vertexOffset = vertexOffset;
-      indirectCommand.firstInstance = drawCallCounter;
-      drawCallBuffer[drawCallCounter] = indirectCommand;
-
-      objectDataBuffer = (ObjectData *)objectDataBuffers[1]->mappedData();
-      drawCallBuffer =
-          (VkDrawIndexedIndirectCommand *)drawCallBuffers[1]->mappedData();
-      objectDataBuffer[drawCallCounter] = {chunk->transform.mat4(),
-                                           chunk->transform.normalMatrix()};
-
-      drawCallBuffer[drawCallCounter] = indirectCommand;
-
-      worldModel->writeMeshDataToBuffer(chunk->getMesh(), vertexBufferOffset,
-                                        indexBufferOffset);
-
-      BufferBlock bufferBlock;
-      bufferBlock.drawCallIndex = drawCallCounter;
-      bufferBlock.vertexOffset = vertexOffset;
-      bufferBlock.vertexCount = chunk->getMesh().first.size();
-      bufferBlock.firstIndex = firstIndex;
-      bufferBlock.indexCount = chunk->getMesh().second.size();
-      bufferBlock.vertexBufferOffset = vertexBufferOffset;
-      bufferBlock.indexBufferOffset = indexBufferOffset;
-      bufferBlock.vertexBlockSize = vertexBlockSize;
-      bufferBlock.indexBlockSize = indexBlockSize;
-      chunk->bufferMemory = bufferBlock;
-
-      VkBufferCopy copyRegion = {};
-      copyRegion.srcOffset = vertexBufferOffset;
-      copyRegion.dstOffset = vertexBufferOffset;
-      copyRegion.size = chunk->getMesh().first.size() * sizeof(Model::Vertex);
-      vkCmdCopyBuffer(commandBuffer, worldModel->stagingBuffer->getBuffer(),
-                      worldModel->ringBuffer->getBuffer(), 1, &copyRegion);
-
-      copyRegion.srcOffset =
-          indexBufferOffset + 10000000 * sizeof(Model::Vertex);
-      copyRegion.dstOffset =
-          indexBufferOffset + 10000000 * sizeof(Model::Vertex);
-      copyRegion.size = chunk->getMesh().second.size() * sizeof(uint32_t);
-      vkCmdCopyBuffer(commandBuffer, worldModel->stagingBuffer->getBuffer(),
-                      worldModel->ringBuffer->getBuffer(), 1, &copyRegion);
-
-      drawCallCounter++;
-      firstIndex += indexBlockSize;
-      indexBufferOffset += indexBlockSize * sizeof(uint32_t);
-      vertexOffset += vertexBlockSize;
-      vertexBufferOffset += vertexBlockSize * sizeof(Model::Vertex);
+    VkDeviceSize stagingOffset;
+    if (!stagingRing.allocate(vertexDataSize + indexDataSize, stagingOffset)) {
+      if (vertexDataSize + indexDataSize <= stagingRing.getSize())
+        break;
+
+      cerr << "Chunk mesh does not fit into the staging ring, skipping chunk"
+           << endl;
       pushQueue.pop();
       continue;
-    } else {
-      auto it = freeChunks.begin();
-      bool found = false;
-
-      while (it != freeChunks.end()) {
-        BufferBlock &freeChunk = *it;
-
-        if (freeChunk.vertexBlockSize == vertexBlockSize &&
-            freeChunk.indexBlockSize == indexBlockSize) {
-
-          auto *objectDataBuffer =
-              (ObjectData *)objectDataBuffers[0]->mappedData();
-          objectDataBuffer[freeChunk.drawCallIndex] = {
-              chunk->transform.mat4(), chunk->transform.normalMatrix()};
-          auto *drawCallBuffer =
-              (VkDrawIndexedIndirectCommand *)drawCallBuffers[0]->mappedData();
-          VkDrawIndexedIndirectCommand indirectCommand{};
-          indirectCommand.indexCount = chunk->getMesh().second.size();
-          indirectCommand.instanceCount = 1;
-          indirectCommand.firstIndex = freeChunk.firstIndex;
-          indirectCommand.vertexOffset = freeChunk.vertexOffset;
-          indirectCommand.firstInstance = freeChunk.drawCallIndex;
-          drawCallBuffer[freeChunk.drawCallIndex] = indirectCommand;
-
-          objectDataBuffer = (ObjectData *)objectDataBuffers[1]->mappedData();
-          drawCallBuffer =
-              (VkDrawIndexedIndirectCommand *)drawCallBuffers[1]->mappedData();
-          objectDataBuffer[freeChunk.drawCallIndex] = {
-              chunk->transform.mat4(), chunk->transform.normalMatrix()};
-          drawCallBuffer[freeChunk.drawCallIndex] = indirectCommand;
-
-          worldModel->writeMeshDataToBuffer(chunk->getMesh(),
-                                            freeChunk.vertexBufferOffset,
-                                            freeChunk.indexBufferOffset);
-
-          chunk->bufferMemory = freeChunk;
-
-          VkBufferCopy copyRegion = {};
-          copyRegion.srcOffset = copyRegion.dstOffset =
-              freeChunk.vertexBufferOffset;
-          copyRegion.size =
-              chunk->getMesh().first.size() * sizeof(Model::Vertex);
-          vkCmdCopyBuffer(commandBuffer, worldModel->stagingBuffer->getBuffer(),
-                          worldModel->ringBuffer->getBuffer(), 1, &copyRegion);
-
-          copyRegion.srcOffset = copyRegion.dstOffset =
-              freeChunk.indexBufferOffset + 10000000 * sizeof(Model::Vertex);
-          copyRegion.size = chunk->getMesh().second.size() * sizeof(uint32_t);
-          vkCmdCopyBuffer(commandBuffer, worldModel->stagingBuffer->getBuffer(),
-                          worldModel->ringBuffer->getBuffer(), 1, &copyRegion);
-
-          pushQueue.pop();
-          freeChunks.erase(it);
-          found = true;
-          break;
-        } else {
-          auto drawCallBuffer =
-              (VkDrawIndexedIndirectCommand *)drawCallBuffers[0]->mappedData();
-          drawCallBuffer[freeChunk.drawCallIndex] = {0, 0, 0, 0, 0};
-
-          drawCallBuffer =
-              (VkDrawIndexedIndirectCommand *)drawCallBuffers[1]->mappedData();
-          drawCallBuffer[freeChunk.drawCallIndex] = {0, 0, 0, 0, 0};
-
-          ++it;
-        }
-      }
+    }
+    pushQueue.pop();
+
+    BufferBlock bufferBlock;
+    if (!vertexAllocator.allocate(mesh.first.size(),
+                                  bufferBlock.vertexAllocation) ||
+        !indexAllocator.allocate(mesh.second.size(),
+                                 bufferBlock.indexAllocation)) {
+      // Fragmented, or ranges of evicted chunks are still in flight
+      vertexAllocator.free(bufferBlock.vertexAllocation);
+      evictedChunks.insert(chunkIt->first);
+      continue;
+    }
+
+    if (!drawList.allocateSlot(bufferBlock.drawCallIndex)) {
+      vertexAllocator.free(bufferBlock.vertexAllocation);
+      indexAllocator.free(bufferBlock.indexAllocation);
+      cerr << "Draw call limit reached, skipping chunk" << endl;
+      continue;
+    }
+
+    bufferBlock.vertexOffset = bufferBlock.vertexAllocation.offset;
+    bufferBlock.vertexCount = mesh.first.size();
+    bufferBlock.firstIndex = bufferBlock.indexAllocation.offset;
+    bufferBlock.indexCount = mesh.second.size();
+    bufferBlock.vertexBufferOffset =
+        bufferBlock.vertexAllocation.offset * sizeof(Model::Vertex);
+    bufferBlock.indexBufferOffset =
+        bufferBlock.indexAllocation.offset * sizeof(uint32_t);
+    chunk->bufferMemory = bufferBlock;
+    terrainBytes += vertexDataSize + indexDataSize;
+
+    stagingRing.write(mesh.first.data(), vertexDataSize, stagingOffset);
+    stagingRing.write(mesh.second.data(), indexDataSize,
+                      stagingOffset + vertexDataSize);
+
+    VkBufferCopy copyRegions[2] = {};
+    copyRegions[0].srcOffset = stagingOffset;
+    copyRegions[0].dstOffset = bufferBlock.vertexBufferOffset;
+    copyRegions[0].size = vertexDataSize;
+    copyRegions[1].srcOffset = stagingOffset + vertexDataSize;
+    copyRegions[1].dstOffset =
+        bufferBlock.indexBufferOffset + Model::INDEX_REGION_OFFSET;
+    copyRegions[1].size = indexDataSize;
+    vkCmdCopyBuffer(commandBuffer, stagingRing.getBuffer(),
+                    worldModel->ringBuffer->getBuffer(), 2, copyRegions);
+
+    const CollisionBox3D &chunkBounds = chunk->boundingBox.collisionBox;
+    pendingUploads.push_back(
+        {bufferBlock,
+         {glm::ivec3{chunk->transform.position}, 0},
+         {glm::vec4{chunkBounds.min, 1.f}, glm::vec4{chunkBounds.max, 1.f}},
+         0});
+  }
+
+  uint64_t uploadValue = uploadService.submit();
+  stagingRing.submit(uploadValue);
+  for (size_t i = firstUpload; i < pendingUploads.size(); i++)
+    pendingUploads[i].uploadValue = uploadValue;
+}
+
+void App::publishUploads(SlotBuffer &drawDataStore, SlotBuffer &boundsStore) {
+  if (pendingUploads.empty())
+    return;
+
+  // Chunks only get a draw call once their copy has landed, the frame
+  // submit then waits on that (already signalled) timeline value
+  uint64_t completedValue = uploadService.completedValue();
+  auto it = pendingUploads.begin();
+  while (it != pendingUploads.end()) {
+    if (it->uploadValue > completedValue) {
+      it++;
+      continue;
+    }
+
+    const BufferBlock &bufferBlock = it->bufferBlock;
+
+    VkDrawIndexedIndirectCommand indirectCommand{};
+    indirectCommand.indexCount = bufferBlock.indexCount;
+    indirectCommand.instanceCount = 1;
+    indirectCommand.firstIndex = bufferBlock.firstIndex;
+    indirectCommand.vertexOffset = bufferBlock.vertexOffset;
 
-      if (!found) {
-        auto *objectDataBuffer =
-            (ObjectData *)objectDataBuffers[0]->mappedData();
-        auto *drawCallBuffer =
-            (VkDrawIndexedIndirectCommand *)drawCallBuffers[0]->mappedData();
-        objectDataBuffer[drawCallCounter] = {chunk->transform.mat4(),
-                                             chunk->transform.normalMatrix()};
-
-        VkDrawIndexedIndirectCommand indirectCommand{};
-        indirectCommand.indexCount = chunk->getMesh().second.size();
-        indirectCommand.instanceCount = 1;
-        indirectCommand.firstIndex = firstIndex;
-        indirectCommand.vertexOffset = vertexOffset;
-        indirectCommand.firstInstance = drawCallCounter;
-        drawCallBuffer[drawCallCounter] = indirectCommand;
-
-        objectDataBuffer = (ObjectData *)objectDataBuffers[1]->mappedData();
-        drawCallBuffer =
-            (VkDrawIndexedIndirectCommand *)drawCallBuffers[1]->mappedData();
-        objectDataBuffer[drawCallCounter] = {chunk->transform.mat4(),
-                                             chunk->transform.normalMatrix()};
-
-        drawCallBuffer[drawCallCounter] = indirectCommand;
-
-        worldModel->writeMeshDataToBuffer(chunk->getMesh(), vertexBufferOffset,
-                                          indexBufferOffset);
-
-        BufferBlock bufferBlock;
-        bufferBlock.drawCallIndex = drawCallCounter;
-        bufferBlock.vertexOffset = vertexOffset;
-        bufferBlock.vertexCount = chunk->getMesh().first.size();
-        bufferBlock.firstIndex = firstIndex;
-        bufferBlock.indexCount = chunk->getMesh().second.size();
-        bufferBlock.vertexBufferOffset = vertexBufferOffset;
-        bufferBlock.indexBufferOffset = indexBufferOffset;
-        bufferBlock.vertexBlockSize = vertexBlockSize;
-        bufferBlock.indexBlockSize = indexBlockSize;
-        chunk->bufferMemory = bufferBlock;
-
-        VkBufferCopy copyRegion = {};
-        copyRegion.srcOffset = vertexBufferOffset;
-        copyRegion.dstOffset = vertexBufferOffset;
-        copyRegion.size = chunk->getMesh().first.size() * sizeof(Model::Vertex);
-        vkCmdCopyBuffer(commandBuffer, worldModel->stagingBuffer->getBuffer(),
-                        worldModel->ringBuffer->getBuffer(), 1, &copyRegion);
-
-        copyRegion.srcOffset =
-            indexBufferOffset + 10000000 * sizeof(Model::Vertex);
-        copyRegion.dstOffset =
-            indexBufferOffset + 10000000 * sizeof(Model::Vertex);
-        copyRegion.size = chunk->getMesh().second.size() * sizeof(uint32_t);
-        vkCmdCopyBuffer(commandBuffer, worldModel->stagingBuffer->getBuffer(),
-                        worldModel->ringBuffer->getBuffer(), 1, &copyRegion);
-
-        drawCallCounter++;
-        firstIndex += indexBlockSize;
-        indexBufferOffset += indexBlockSize * sizeof(uint32_t);
-        vertexOffset += vertexBlockSize;
-        vertexBufferOffset += vertexBlockSize * sizeof(Model::Vertex);
-        pushQueue.pop();
+    drawDataStore.write(bufferBlock.drawCallIndex, &it->drawData);
+    boundsStore.write(bufferBlock.drawCallIndex, &it->bounds);
+    drawBoxes.set(bufferBlock.drawCallIndex, glm::vec3{it->bounds.min},
+                  glm::vec3{it->bounds.max});
+    drawList.add(bufferBlock.drawCallIndex, indirectCommand);
+
+    publishedUploadValue = max(publishedUploadValue, it->uploadValue);
+    it = pendingUploads.erase(it);
+  }
+}
+
+void App::releaseChunks(int frameIndex) {
+  // Chunks retired the last time this frame slot was recorded are no longer
+  // referenced by any frame in flight, so their ranges and object data slot
+  // can be reused.
+  for (BufferBlock &retiredChunk : retiredChunks[frameIndex])
+    freeBufferBlock(retiredChunk);
+  retiredChunks[frameIndex].clear();
+
+  if (!cancelledUploads.empty()) {
+    uint64_t completedValue = uploadService.completedValue();
+    auto it = cancelledUploads.begin();
+    while (it != cancelledUploads.end()) {
+      if (it->first <= completedValue) {
+        freeBufferBlock(it->second);
+        it = cancelledUploads.erase(it);
+      } else {
+        it++;
       }
     }
   }
-  device.endSingleTimeCommands(commandBuffer);
+
+  for (BufferBlock &freeChunk : freeChunks) {
+    if (!freeChunk.isResident())
+      continue;
+
+    // Never drawn, but its copy may still be writing into the ring buffer
+    auto pending = find_if(pendingUploads.begin(), pendingUploads.end(),
+                           [&](const PendingUpload &pendingUpload) {
+                             return pendingUpload.bufferBlock.drawCallIndex ==
+                                    freeChunk.drawCallIndex;
+                           });
+    if (pending != pendingUploads.end()) {
+      cancelledUploads.push_back({pending->uploadValue, freeChunk});
+      pendingUploads.erase(pending);
+      continue;
+    }
+
+    drawList.remove(freeChunk.drawCallIndex);
+    retiredChunks[frameIndex].push_back(freeChunk);
+  }
+  freeChunks.clear();
+}
+
+void App::freeBufferBlock(BufferBlock &bufferBlock) {
+  vertexAllocator.free(bufferBlock.vertexAllocation);
+  indexAllocator.free(bufferBlock.indexAllocation);
+  drawList.freeSlot(bufferBlock.drawCallIndex);
+}
+
+void App::updateTerrainResidency(const Frustum &frustum,
+                                 const glm::vec3 &cameraPosition) {
+  terrainBytes = 0;
+  evictionOrder.clear();
+  nextEviction = 0;
+  for (const auto &[chunkIndex, chunk] : chunks) {
+    if (!chunk.bufferMemory.isResident())
+      continue;
+    terrainBytes += getMeshBytes(chunk.bufferMemory.vertexCount,
+                                 chunk.bufferMemory.indexCount);
+    evictionOrder.push_back(
+        {getResidencyScore(chunk, frustum, cameraPosition), chunkIndex});
+  }
+  sort(evictionOrder.begin(), evictionOrder.end(), greater<>());
+
+  if (framesToBudgetUpdate-- == 0) {
+    updateTerrainBudget();
+    framesToBudgetUpdate = HEAP_BUDGET_INTERVAL - 1;
+  }
+
+  while (terrainBytes > terrainBudget && nextEviction < evictionOrder.size())
+    evictChunk(evictionOrder[nextEviction++].second);
+
+  if (evictedChunks.empty())
+    return;
+
+  vector<pair<float, int>> candidates;
+  auto it = evictedChunks.begin();
+  while (it != evictedChunks.end()) {
+    auto chunkIt = chunks.find(*it);
+    if (chunkIt == chunks.end()) {
+      it = evictedChunks.erase(it);
+      continue;
+    }
+    candidates.push_back(
+        {getResidencyScore(chunkIt->second, frustum, cameraPosition), *it});
+    it++;
+  }
+  sort(candidates.begin(), candidates.end());
+
+  // Best first, until one neither fits nor beats a resident chunk. The
+  // upload makes the actual room.
+  VkDeviceSize queuedBytes = 0;
+  size_t replaced = nextEviction;
+  for (const auto &[score, chunkIndex] : candidates) {
+    const auto &mesh = chunks.at(chunkIndex).getMesh();
+    VkDeviceSize meshBytes =
+        getMeshBytes(mesh.first.size(), mesh.second.size());
+    bool fits = terrainBytes + queuedBytes + meshBytes <= terrainBudget;
+    bool replaces =
+        replaced < evictionOrder.size() &&
+        evictionOrder[replaced].first > score * RESIDENCY_HYSTERESIS;
+    if (!fits && !replaces)
+      break;
+    if (!fits)
+      replaced++;
+
+    queuedBytes += meshBytes;
+    pushQueue.push(chunkIndex);
+    evictedChunks.erase(chunkIndex);
+  }
+}
+
+void App::updateTerrainBudget() {
+  // The terrain buffers live on the largest device local heap
+  vector<HeapBudget> heapBudgets = device.getMemoryAllocator().getHeapBudgets();
+  const HeapBudget *heap = nullptr;
+  for (const HeapBudget &candidate : heapBudgets)
+    if (candidate.deviceLocal &&
+        (heap == nullptr || candidate.size > heap->size))
+      heap = &candidate;
+  if (heap == nullptr) {
+    terrainBudget = terrainBudgetLimit;
+    return;
+  }
+
+  // Whatever else is on the heap stays, the terrain gets the rest
+  VkDeviceSize otherUsage = heap->usage - min(heap->usage, terrainBytes);
+  VkDeviceSize room = heap->budget - min(heap->budget, otherUsage);
+  terrainBudget = min(terrainBudgetLimit, room);
+}
+
+bool App::makeTerrainRoom(VkDeviceSize size, float score) {
+  while (terrainBytes + size > terrainBudget &&
+         nextEviction < evictionOrder.size() &&
+         evictionOrder[nextEviction].first > score * RESIDENCY_HYSTERESIS)
+    evictChunk(evictionOrder[nextEviction++].second);
+  return terrainBytes + size <= terrainBudget;
+}
+
+void App::evictChunk(int chunkIndex) {
+  // The mesh stays on the CPU, so the chunk can come back without a remesh
+  Chunk &chunk = chunks.at(chunkIndex);
+  terrainBytes -= getMeshBytes(chunk.bufferMemory.vertexCount,
+                               chunk.bufferMemory.indexCount);
+  freeChunks.push_back(chunk.bufferMemory);
+  chunk.bufferMemory = {};
+  evictedChunks.insert(chunkIndex);
+}
+
+void App::updateDrawCalls(int frameIndex,
+                          vector<shared_ptr<Buffer>> &drawCallBuffers) {
+  // Each frame in flight has its own copy of the dense list, only refresh
+  // the one we are about to record if the list changed since
+  if (drawListVersions[frameIndex] == drawList.getVersion())
+    return;
+
+  if (drawList.size() > 0)
+    drawCallBuffers[frameIndex]->writeToBuffer(
+        (void *)drawList.data(),
+        drawList.size() * sizeof(VkDrawIndexedIndirectCommand));
+  drawListVersions[frameIndex] = drawList.getVersion();
+}
+
+uint32_t App::cullDrawCalls(int frameIndex, const glm::mat4 &projectionView,
+                            const glm::vec3 &cameraPosition,
+                            vector<shared_ptr<Buffer>> &drawCallBuffers) {
+  Frustum frustum = Frustum::fromMatrix(projectionView);
+  frustum.testBoxes(drawBoxes, drawList.getSlotCount(), drawVisibility.data());
+
+  // The closest drawn chunks cover the most of the screen and make the best
+  // occluders
+  occluderChunks.clear();
+  for (const auto &[chunkKey, chunk] : chunks) {
+    const CollisionBox3D &bounds = chunk.boundingBox.collisionBox;
+    if (chunk.occluders.empty() || !chunk.bufferMemory.isResident() ||
+        !drawList.contains(chunk.bufferMemory.drawCallIndex) ||
+        !drawVisibility[chunk.bufferMemory.drawCallIndex])
+      continue;
+
+    occluderChunks.push_back(
+        {glm::length(bounds.center() - cameraPosition), &chunk});
+  }
+
+  size_t occluderCount = min(occluderChunks.size(), MAX_OCCLUDER_CHUNKS);
+  partial_sort(occluderChunks.begin(), occluderChunks.begin() + occluderCount,
+               occluderChunks.end(), [](const auto &a, const auto &b) {
+                 return a.first < b.first;
+               });
+
+  occlusionCuller.clear(projectionView);
+  for (size_t i = 0; i < occluderCount; i++)
+    for (const CollisionBox3D &occluder : occluderChunks[i].second->occluders)
+      occlusionCuller.addOccluder(occluder.min, occluder.max);
+
+  auto *drawCalls =
+      (VkDrawIndexedIndirectCommand *)drawCallBuffers[frameIndex]->mappedData();
+  uint32_t drawCount = 0;
+  for (uint32_t i = 0; i < drawList.size(); i++) {
+    const VkDrawIndexedIndirectCommand &command = drawList.data()[i];
+    if (!drawVisibility[command.firstInstance] ||
+        occlusionCuller.isOccluded(drawBoxes.getMin(command.firstInstance),
+                                   drawBoxes.getMax(command.firstInstance)))
+      continue;
+
+    drawCalls[drawCount++] = command;
+  }
+
+  return drawCount;
 }
 
 } // namespace engine
@@ -1,48 +1,137 @@
 #pragma once
 #include "chunk.hpp"
+#include "core/box_list.hpp"
 #include "core/descriptors.hpp"
+#include "core/draw_list.hpp"
+#include "core/frustum.hpp"
 #include "core/game_object.hpp"
+#include "core/model.hpp"
 #include "core/object_data.hpp"
+#include "core/occlusion_culler.hpp"
 #include "core/render_system.hpp"
+#include "core/slot_buffer.hpp"
+#include "core/staging_ring.hpp"
 #include "core/swapchain.hpp"
+#include "core/tlsf_allocator.hpp"
+#include "core/upload_service.hpp"
+#include <array>
 #include <cstdint>
 #include <memory>
 #include <queue>
+#include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <vector>
 
 namespace engine {
 
-extern int RENDER_DISTANCE;
 extern const int MAX_DRAW_CALLS;
 extern const int WIDTH;
 extern const int HEIGHT;
 
+struct AppOptions {
+  // Renders into offscreen images, without a window or input
+  bool headless = false;
+  // Stops after this many frames, 0 runs until the window is closed
+  uint32_t frameLimit = 0;
+  // Binary PPM of the last frame, needs headless and a frame limit
+  std::string capturePath;
+  // Writes every frame's input and delta time
+  std::string recordPath;
+  // Plays a recording back instead of live input and wall clock time
+  std::string replayPath;
+  // Per frame CSV of a replay
+  std::string reportPath;
+  // Chrome trace of the CPU profiler scopes, written on exit
+  std::string cpuTracePath;
+  // Most bytes of chunk meshes kept in the terrain buffers, 0 allows all of
+  // them. The free room on the device local heap can lower it further.
+  VkDeviceSize terrainBudget = 0;
+};
+
 class App {
 public:
-  App();
+  App(const AppOptions &options = {});
 
   void run();
 
 private:
-  Window window{WIDTH, HEIGHT, "Vulkan Application"};
+  AppOptions options;
+  Window window{WIDTH, HEIGHT, "Vulkan Application", options.headless};
   Device device{window};
 
   unique_ptr<DescriptorPool> descriptorPool;
+  StagingRing stagingRing{device, StagingRing::SIZE_PER_FRAME *
+                                      SwapChain::MAX_FRAMES_IN_FLIGHT};
+  UploadService uploadService{device};
+
+  struct PendingUpload {
+    BufferBlock bufferBlock;
+    ChunkDrawData drawData;
+    DrawBounds bounds;
+    uint64_t uploadValue;
+  };
+
+  void loadWorldModel(int frameIndex, const glm::mat4 &projectionView,
+                      const glm::vec3 &cameraPosition,
+                      SlotBuffer &drawDataStore, SlotBuffer &boundsStore);
+  void publishUploads(SlotBuffer &drawDataStore, SlotBuffer &boundsStore);
+  void releaseChunks(int frameIndex);
+  void updateDrawCalls(int frameIndex,
+                       vector<shared_ptr<Buffer>> &drawCallBuffers);
+  void freeBufferBlock(BufferBlock &bufferBlock);
+  // Recounts the resident chunks, evicts the worst ones while over budget
+  // and queues deferred chunks that earned their place again
+  void updateTerrainResidency(const Frustum &frustum,
+                              const glm::vec3 &cameraPosition);
+  // Limits terrainBudget to the room the device local heap's budget leaves
+  // next to everything that isn't terrain
+  void updateTerrainBudget();
+  // Evicts chunks scoring clearly worse than score until size fits
+  bool makeTerrainRoom(VkDeviceSize size, float score);
+  void evictChunk(int chunkIndex);
+  // CPU fallback for devices without GPU culling, returns the draw count
+  uint32_t cullDrawCalls(int frameIndex, const glm::mat4 &projectionView,
+                         const glm::vec3 &cameraPosition,
+                         vector<shared_ptr<Buffer>> &drawCallBuffers);
+
+  ChunkGenerator chunkGenerator;
 
-  void loadWorldModel(queue<Chunk *> &pushQueue,
-                      vector<shared_ptr<Buffer>> objectDataBuffers,
-                      vector<shared_ptr<Buffer>> drawCallBuffers);
-
-  ChunkGenerator chunkGenerator{device};
-
-  thread chunkThread;
   mutex queueMutex;
 
   unordered_map<int, Chunk> chunks;
   vector<BufferBlock> freeChunks;
+  array<vector<BufferBlock>, SwapChain::MAX_FRAMES_IN_FLIGHT> retiredChunks;
+
+  DrawList drawList{static_cast<uint32_t>(MAX_DRAW_CALLS)};
+  array<uint64_t, SwapChain::MAX_FRAMES_IN_FLIGHT> drawListVersions{};
+  BoxList drawBoxes{static_cast<uint32_t>(MAX_DRAW_CALLS)};
+  vector<uint8_t> drawVisibility = vector<uint8_t>(MAX_DRAW_CALLS);
+
+  OcclusionCuller3D occlusionCuller{240, 160};
+  vector<pair<float, const Chunk *>> occluderChunks;
+
+  queue<int> pushQueue;
+  vector<PendingUpload> pendingUploads;
+  vector<pair<uint64_t, BufferBlock>> cancelledUploads;
+  uint64_t publishedUploadValue = 0;
+
+  TlsfAllocator vertexAllocator{Model::MAX_VERTEX_COUNT};
+  TlsfAllocator indexAllocator{Model::MAX_INDEX_COUNT};
+
+  // From --terrain-budget, capped by the terrain buffers
+  VkDeviceSize terrainBudgetLimit = 0;
+  // The limit or the heap's room, whichever is less
+  VkDeviceSize terrainBudget = 0;
+  uint32_t framesToBudgetUpdate = 0;
+  VkDeviceSize terrainBytes = 0;
+  // Resident chunks by score, worst first, rebuilt every frame
+  vector<pair<float, int>> evictionOrder;
+  size_t nextEviction = 0;
+  // Meshed chunks without a range in the terrain buffers
+  unordered_set<int> evictedChunks;
   queue<Chunk> chunkQueue;
   queue<int> chunkUnloadQueue;
 
@@ -56,11 +145,6 @@ private:
   std::vector<GameObject> gameObjects{};
   bool wakingUp = true;
 
-  uint32_t drawCallCounter = 0;
-  uint32_t vertexBufferOffset = 0;
-  uint32_t indexBufferOffset = 0;
-  uint32_t firstIndex = 0;
-  uint32_t vertexOffset = 0;
   uint32_t frameCounter = 0;
 
   uint32_t modelIndex = 0;
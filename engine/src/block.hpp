@@ -1,6 +1,7 @@
 #pragma once
 #include "collision.hpp"
 #include "core/game_object.hpp"
+#include <array>
 #include <cstdint>
 #include <sys/types.h>
 
@@ -18,6 +19,22 @@ struct BlockType {
   }
 };
 
+// Layers of the block texture array, in the order of BLOCK_TEXTURE_FILES
+enum TextureLayer : uint32_t { GrassSide = 0, GrassTop = 1 };
+
+inline constexpr std::array<const char *, 2> BLOCK_TEXTURE_FILES{
+    "textures/gras.jpeg", "textures/gras_top.jpg"};
+
+struct BlockTextures {
+  uint32_t top;
+  uint32_t bottom;
+  uint32_t side;
+};
+
+// Indexed by BlockType::type, air is never meshed
+inline constexpr std::array<BlockTextures, 2> BLOCK_TEXTURES{
+    {{GrassSide, GrassSide, GrassSide}, {GrassTop, GrassSide, GrassSide}}};
+
 class Block : public GameObject {
 public:
   Block(glm::vec3 position) : GameObject() {
@@ -1,27 +1,22 @@
+#pragma once
+#include "core/tlsf_allocator.hpp"
 #include <cstddef>
 #include <cstdint>
 #include <ostream>
 namespace engine {
 
-struct ChunkSize {
-  static constexpr size_t Tiny = 1024;
-  static constexpr size_t Small = 2048;
-  static constexpr size_t Medium = 4096;
-  static constexpr size_t Large = 8192;
-  static constexpr size_t Huge = 16384;
-  static constexpr size_t Max = 24576;
-};
-
 struct BufferBlock {
-  uint32_t drawCallIndex;
-  uint32_t vertexOffset;
-  size_t vertexCount;
-  uint32_t firstIndex;
-  size_t indexCount;
-  uint32_t vertexBufferOffset;
-  uint32_t indexBufferOffset;
-  size_t vertexBlockSize;
-  size_t indexBlockSize;
+  uint32_t drawCallIndex = 0;
+  uint32_t vertexOffset = 0;
+  size_t vertexCount = 0;
+  uint32_t firstIndex = 0;
+  size_t indexCount = 0;
+  uint32_t vertexBufferOffset = 0;
+  uint32_t indexBufferOffset = 0;
+  TlsfAllocator::Allocation vertexAllocation;
+  TlsfAllocator::Allocation indexAllocation;
+
+  bool isResident() const { return vertexAllocation.isValid(); }
 };
 
 inline std::ostream &operator<<(std::ostream &os,
@@ -1,11 +1,12 @@
 #include "chunk.hpp"
-#include "app.hpp"
 #include "block.hpp"
 #include "collision.hpp"
-#include "core/device.hpp"
+#include "core/cpu_profiler.hpp"
 #include "core/game_object.hpp"
 #include "core/model.hpp"
+#include <algorithm>
 #include <bits/fs_fwd.h>
+#include <cstddef>
 #include <functional>
 #include <glm/common.hpp>
 #include <glm/ext/vector_float2.hpp>
@@ -23,15 +24,57 @@ using namespace std;
 
 namespace engine {
 
-Chunk::Chunk(Device &device, std::vector<BlockType> blocks, glm::vec3 &position)
-    : GameObject(), blocks{blocks}, device{device} {
+int RENDER_DISTANCE = 6;
+
+Chunk::Chunk(std::vector<BlockType> blocks, glm::vec3 &position)
+    : GameObject(), blocks{blocks} {
   transform.position = position;
   boundingBox = BoxCollider(transform.position, transform.position + 32.f);
 
-  if (blocks.size() != 1)
+  if (blocks.size() != 1) {
     calculateMesh();
+    calculateOccluders();
+  }
 };
 
+// Splits the chunk into cells of columns and keeps, per cell, the box from
+// the chunk floor up to the lowest air block. Everything inside is solid, so
+// the boxes can only ever hide what really is hidden.
+void Chunk::calculateOccluders() {
+  constexpr int CELL_SIZE = 8;
+
+  occluders.clear();
+  std::vector<int> cellHeights;
+  for (int cellZ = 0; cellZ < 32; cellZ += CELL_SIZE) {
+    for (int cellX = 0; cellX < 32; cellX += CELL_SIZE) {
+      int height = 32;
+      for (int z = cellZ; z < cellZ + CELL_SIZE && height > 0; z++) {
+        for (int x = cellX; x < cellX + CELL_SIZE && height > 0; x++) {
+          int y = 0;
+          while (y < height && getBlock(x, y, z) != BlockType::Air)
+            y++;
+          height = y;
+        }
+      }
+      cellHeights.push_back(height);
+
+      if (height > 0)
+        occluders.push_back(
+            {transform.position + glm::vec3(cellX, 0, cellZ),
+             transform.position +
+                 glm::vec3(cellX + CELL_SIZE, height, cellZ + CELL_SIZE)});
+    }
+  }
+
+  // Fully buried chunks only need a single box
+  if (occluders.size() == cellHeights.size() &&
+      std::all_of(cellHeights.begin(), cellHeights.end(),
+                  [&](int height) { return height == cellHeights[0]; })) {
+    occluders = {{transform.position,
+                  transform.position + glm::vec3(32, cellHeights[0], 32)}};
+  }
+}
+
 void Chunk::calculateMesh() {
   std::vector<Model::Vertex> vertices;
   std::vector<uint32_t> indices;
@@ -42,6 +85,7 @@ void Chunk::calculateMesh() {
         BlockType block = getBlock(x, y, z);
         if (block == BlockType::Air)
           continue;
+        size_t firstVertex = vertices.size();
 
         BlockType top = getBlock(x, y + 1, z);
         BlockType bottom = getBlock(x, y - 1, z);
@@ -337,6 +381,15 @@ void Chunk::calculateMesh() {
           indices.push_back(vertices.size() - 2);
           indices.push_back(vertices.size() - 1);
         }
+
+        // Faces pick their layer by direction
+        const BlockTextures &textures = BLOCK_TEXTURES[block.type];
+        for (size_t i = firstVertex; i < vertices.size(); i++) {
+          float normalY = vertices[i].normal.y;
+          vertices[i].textureLayer = normalY > 0.f   ? textures.top
+                                     : normalY < 0.f ? textures.bottom
+                                                     : textures.side;
+        }
       }
     }
   }
@@ -366,7 +419,7 @@ Chunk ChunkGenerator::generate(glm::vec3 position) {
   if (isEmpty)
     blocks.resize(1);
 
-  Chunk chunk{device, blocks, position};
+  Chunk chunk{blocks, position};
 
   return chunk;
 };
@@ -394,33 +447,45 @@ void ChunkLoader::startChunkThread(
                             std::ref(chunks));
 }
 
+void ChunkLoader::stop() {
+  running = false;
+  if (chunkThread.joinable())
+    chunkThread.join();
+}
+
 void ChunkLoader::loadChunks(const GameObject &player,
                              const std::unordered_map<int, Chunk> &chunks) {
-  glm::vec3 playerChunk;
+  PROFILE_THREAD("chunk loader");
 
-  while (running) {
-    {
-      std::lock_guard<std::mutex> lock(chunkMutex);
-      playerChunk = {floor(player.transform.position / 32.f)};
-    }
+  while (running)
+    queueMissingChunks(player, chunks);
+}
 
-    for (int y = 0; y < RENDER_DISTANCE * 2; y++) {
-      for (int z = 0; z < RENDER_DISTANCE * 2; z++) {
-        for (int x = 0; x < RENDER_DISTANCE * 2; x++) {
-          int xPos = (playerChunk.x + (x - RENDER_DISTANCE)) * 32.f;
-          int zPos = (playerChunk.z + (z - RENDER_DISTANCE)) * 32.f;
-          int yPos = y * 32.f;
+void ChunkLoader::queueMissingChunks(
+    const GameObject &player, const std::unordered_map<int, Chunk> &chunks) {
+  glm::vec3 playerChunk;
+  {
+    std::lock_guard<std::mutex> lock(chunkMutex);
+    playerChunk = {floor(player.transform.position / 32.f)};
+  }
 
-          glm::vec3 chunkPosition{xPos, yPos, zPos};
+  for (int y = 0; y < RENDER_DISTANCE * 2; y++) {
+    for (int z = 0; z < RENDER_DISTANCE * 2; z++) {
+      for (int x = 0; x < RENDER_DISTANCE * 2; x++) {
+        int xPos = (playerChunk.x + (x - RENDER_DISTANCE)) * 32.f;
+        int zPos = (playerChunk.z + (z - RENDER_DISTANCE)) * 32.f;
+        int yPos = y * 32.f;
 
-          if (isLoaded(chunkPosition, chunks))
-            continue;
+        glm::vec3 chunkPosition{xPos, yPos, zPos};
 
-          Chunk chunk = chunkGenerator.generate(chunkPosition);
-          {
-            std::lock_guard<std::mutex> lock(chunkMutex);
-            chunkQueue.push(std::move(chunk));
-          }
+        if (isLoaded(chunkPosition, chunks))
+          continue;
+
+        PROFILE_SCOPE("generate chunk");
+        Chunk chunk = chunkGenerator.generate(chunkPosition);
+        {
+          std::lock_guard<std::mutex> lock(chunkMutex);
+          chunkQueue.push(std::move(chunk));
         }
       }
     }
@@ -458,23 +523,10 @@ void ChunkLoader::unloadOutOfRangeChunks(const GameObject &player,
 
 bool ChunkLoader::isLoaded(const glm::vec3 &chunkPosition,
                            const std::unordered_map<int, Chunk> &chunks) {
-  int chunkIndex = getChunkIndex(chunkPosition);
-
-  try {
-    chunks.at(chunkIndex);
-    return true;
-  } catch (const std::out_of_range) {
-    return false;
-  }
+  return chunks.contains(getChunkIndex(chunkPosition));
 }
 
 int ChunkLoader::getChunkIndex(const glm::vec3 &chunkPosition) {
-  const int CHUNK_GRID_SIZE = RENDER_DISTANCE * 2;
-
-  int x = static_cast<int>(chunkPosition.x);
-  int y = static_cast<int>(chunkPosition.y);
-  int z = static_cast<int>(chunkPosition.z);
-
-  return x + (z * CHUNK_GRID_SIZE) + (y * CHUNK_GRID_SIZE * CHUNK_GRID_SIZE);
+  return getChunkKey(glm::ivec3{glm::floor(chunkPosition / 32.f)});
 }
 } // namespace engine
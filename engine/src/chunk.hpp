@@ -3,12 +3,12 @@
 #include "buffer_block.hpp"
 #include "collision.hpp"
 #include "core/camera.hpp"
-#include "core/device.hpp"
 #include "core/game_object.hpp"
 #include "core/model.hpp"
 #include <atomic>
 #include <cstdint>
 #include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int3.hpp>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -18,6 +18,19 @@
 using namespace std;
 
 namespace engine {
+// Chunks loaded around the player on x and z, on either side
+extern int RENDER_DISTANCE;
+
+// Key of the chunk at chunk coordinates (world position / 32). Coordinates
+// wrap every 2048 chunks on x and z and 1024 on y, far more than a loaded
+// world spans.
+inline int getChunkKey(const glm::ivec3 &chunk) {
+  uint32_t key = (static_cast<uint32_t>(chunk.x) & 0x7FF) |
+                 (static_cast<uint32_t>(chunk.z) & 0x7FF) << 11 |
+                 (static_cast<uint32_t>(chunk.y) & 0x3FF) << 22;
+  return static_cast<int>(key);
+}
+
 struct Position {
   int x;
   int y;
@@ -25,8 +38,8 @@ struct Position {
 
 class Chunk : public GameObject {
 public:
-  Chunk(Device &device, std::vector<BlockType> blocks, glm::vec3 &position);
-  Chunk(Device &device) : GameObject(), device{device} {
+  Chunk(std::vector<BlockType> blocks, glm::vec3 &position);
+  Chunk() : GameObject() {
     blocks.resize(32 * 32 * 32, BlockType{0});
   };
 
@@ -35,10 +48,12 @@ public:
     GameObject::operator=(std::move(other));
     chunkMesh = other.chunkMesh;
     blocks = other.blocks;
+    occluders = other.occluders;
     return *this;
   }
 
   void calculateMesh();
+  void calculateOccluders();
 
   BlockType getBlock(int x, int y, int z) const {
     if (x < 0 || x >= 32 || y < 0 || y >= 32 || z < 0 || z >= 32)
@@ -56,22 +71,20 @@ public:
 
   std::vector<BlockType> blocks;
   BoxCollider boundingBox;
+  // Boxes of solid blocks for software occlusion culling
+  std::vector<CollisionBox3D> occluders;
   BufferBlock bufferMemory;
 
 private:
-  Device &device;
-
   std::pair<std::vector<Model::Vertex>, std::vector<uint32_t>> chunkMesh;
   friend class ChunkLoader;
 };
 
 class ChunkGenerator {
 public:
-  ChunkGenerator(Device &device) : device{device} {};
   Chunk generate(glm::vec3 position);
 
 private:
-  Device &device;
   static int getBlockType(int x, int y, int z);
   static float perlinNoise(int x, int z);
   friend class Chunk;
@@ -79,13 +92,19 @@ private:
 
 class ChunkLoader {
 public:
-  ChunkLoader(Device &device, std::queue<Chunk> &chunkQueue,
+  ChunkLoader(std::queue<Chunk> &chunkQueue,
               std::queue<int> &chunkUnloaderQueue, std::mutex &chunkMutex)
-      : device{device}, chunkMutex{chunkMutex}, chunkGenerator{device},
-        chunkQueue{chunkQueue}, chunkUnloaderQueue{chunkUnloaderQueue} {};
+      : chunkMutex{chunkMutex}, chunkQueue{chunkQueue},
+        chunkUnloaderQueue{chunkUnloaderQueue} {};
+  ~ChunkLoader() { stop(); }
 
   void startChunkThread(GameObject &player,
                         const std::unordered_map<int, Chunk> &chunks);
+  void stop();
+  // One pass over the render distance, what the chunk thread repeats. Run
+  // on the main thread it makes streaming independent of thread timing.
+  void queueMissingChunks(const GameObject &player,
+                          const std::unordered_map<int, Chunk> &chunks);
   void unloadOutOfRangeChunks(const GameObject &player,
                               std::unordered_map<int, Chunk> &chunks,
                               vector<BufferBlock> &freeChunks);
@@ -94,7 +113,6 @@ public:
   atomic<bool> running = true;
 
 private:
-  Device &device;
   std::thread chunkThread;
   std::mutex &chunkMutex;
 
@@ -1,12 +1,39 @@
 #include "collision.hpp"
+#include "block.hpp"
 #include "core/game_object.hpp"
+#include "world_view.hpp"
 #include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/ext/vector_int3.hpp>
 #include <glm/fwd.hpp>
 
 using namespace std;
 
 namespace engine {
 
+namespace {
+
+// Faces closer than this count as touching, so rounding after a clamp can't
+// let a box slip into the block that stopped it
+constexpr float SKIN = 1e-3f;
+
+// Whether a solid block lies in the given layer along axis, within the
+// block range [first, last] on the other two axes
+bool isLayerSolid(const WorldView &world, int axis, int layer,
+                  glm::ivec3 first, glm::ivec3 last) {
+  first[axis] = layer;
+  last[axis] = layer;
+  for (int y = first.y; y <= last.y; y++)
+    for (int z = first.z; z <= last.z; z++)
+      for (int x = first.x; x <= last.x; x++)
+        if (world.getBlock({x, y, z}) != BlockType::Air)
+          return true;
+  return false;
+}
+
+} // namespace
+
 BoxCollider::BoxCollider(const Transform &transform) : transform{transform} {
   collisionBox.min = transform.position - transform.scale;
   collisionBox.max = transform.position + transform.scale;
@@ -63,4 +90,49 @@ Collision3D BoxCollider::resolveCollision(const CollisionBox3D &other) {
   return collision;
 }
 
+SweepResult sweepBox(const WorldView &world, const CollisionBox3D &box,
+                     const glm::vec3 &displacement) {
+  SweepResult result;
+  CollisionBox3D moved = box;
+
+  for (int axis : {1, 0, 2}) {
+    float distance = displacement[axis];
+    if (distance == 0.f)
+      continue;
+
+    glm::ivec3 first{glm::floor(moved.min + SKIN)};
+    glm::ivec3 last = glm::ivec3{glm::ceil(moved.max - SKIN)} - 1;
+
+    if (distance > 0.f) {
+      float leading = moved.max[axis];
+      int end = static_cast<int>(ceil(leading + distance)) - 1;
+      for (int layer = static_cast<int>(ceil(leading - SKIN)); layer <= end;
+           layer++) {
+        if (isLayerSolid(world, axis, layer, first, last)) {
+          distance = max(layer - leading, 0.f);
+          result.blocked[axis] = true;
+          break;
+        }
+      }
+    } else {
+      float leading = moved.min[axis];
+      int end = static_cast<int>(floor(leading + distance));
+      for (int layer = static_cast<int>(floor(leading + SKIN)) - 1;
+           layer >= end; layer--) {
+        if (isLayerSolid(world, axis, layer, first, last)) {
+          distance = min(layer + 1 - leading, 0.f);
+          result.blocked[axis] = true;
+          break;
+        }
+      }
+    }
+
+    moved.min[axis] += distance;
+    moved.max[axis] += distance;
+    result.displacement[axis] = distance;
+  }
+
+  return result;
+}
+
 } // namespace engine
@@ -3,6 +3,8 @@
 #include <glm/glm.hpp>
 
 namespace engine {
+class WorldView;
+
 struct CollisionBox3D {
   glm::vec3 min;
   glm::vec3 max;
@@ -42,4 +44,19 @@ public:
   CollisionBox3D collisionBox;
 };
 
+struct SweepResult {
+  glm::vec3 displacement{0.f};
+  // Per axis, whether a solid block cut the movement short
+  glm::bvec3 blocked{false};
+};
+
+// Moves the box through the solid blocks of the world one axis at a time,
+// y first. Each axis steps through the grid a block layer at a time, so no
+// block is skipped however far the box moves. Faces within 1e-3 of a block
+// count as touching it, so a box overlapping a block by less than that is
+// stopped by it like a touching one. Deeper overlaps don't stop the box, so
+// it can move out of them.
+SweepResult sweepBox(const WorldView &world, const CollisionBox3D &box,
+                     const glm::vec3 &displacement);
+
 } // namespace engine
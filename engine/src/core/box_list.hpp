@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <glm/ext/vector_float3.hpp>
+#include <vector>
+
+namespace engine {
+
+// Axis aligned boxes stored as one array per component, so batches of boxes
+// can be loaded straight into SIMD registers. The arrays are padded to a
+// multiple of 4 and the padding always holds empty boxes at the origin.
+class BoxList {
+public:
+  static constexpr uint32_t BATCH_SIZE = 4;
+
+  BoxList(uint32_t capacity)
+      : capacity{(capacity + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE} {
+    for (std::vector<float> *component : {&minX, &minY, &minZ, &maxX, &maxY,
+                                          &maxZ})
+      component->resize(this->capacity, 0.f);
+  }
+
+  void set(uint32_t index, const glm::vec3 &min, const glm::vec3 &max) {
+    minX[index] = min.x;
+    minY[index] = min.y;
+    minZ[index] = min.z;
+    maxX[index] = max.x;
+    maxY[index] = max.y;
+    maxZ[index] = max.z;
+  }
+
+  glm::vec3 getMin(uint32_t index) const {
+    return {minX[index], minY[index], minZ[index]};
+  }
+  glm::vec3 getMax(uint32_t index) const {
+    return {maxX[index], maxY[index], maxZ[index]};
+  }
+  uint32_t getCapacity() const { return capacity; }
+
+  std::vector<float> minX, minY, minZ;
+  std::vector<float> maxX, maxY, maxZ;
+
+private:
+  uint32_t capacity;
+};
+
+} // namespace engine
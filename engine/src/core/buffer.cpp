@@ -20,12 +20,12 @@ VkDeviceSize Buffer::getAlignment(VkDeviceSize instanceSize,
 Buffer::Buffer(Device &device, VkDeviceSize instanceSize,
                uint32_t instanceCount, VkBufferUsageFlags usageFlags,
                VkMemoryPropertyFlags memoryPropertyFlags,
-               VkDeviceSize minOffsetAlignment)
+               VkDeviceSize minOffsetAlignment, VkSharingMode sharingMode)
     : device{device} {
   alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
   bufferSize = alignmentSize * instanceCount;
   device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer,
-                      bufferMemory);
+                      bufferMemory, sharingMode);
 }
 
 Buffer::~Buffer() { cleanUp(); }
@@ -33,22 +33,24 @@ Buffer::~Buffer() { cleanUp(); }
 void Buffer::cleanUp() {
   unmap();
   vkDestroyBuffer(device.device(), buffer, nullptr);
-  vkFreeMemory(device.device(), bufferMemory, nullptr);
+  device.freeMemory(bufferMemory);
+  buffer = VK_NULL_HANDLE;
 }
 
 VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-  assert(buffer && bufferMemory && "Buffer has to be created before mapping!");
-  return vkMapMemory(device.device(), bufferMemory, offset, size, 0,
-                     &mappedMemory);
-}
+  assert(buffer && bufferMemory.isValid() &&
+         "Buffer has to be created before mapping!");
+
+  // Host visible memory is persistently mapped by the allocator
+  if (!bufferMemory.mappedData)
+    return VK_ERROR_MEMORY_MAP_FAILED;
 
-void Buffer::unmap() {
-  if (mappedMemory) {
-    vkUnmapMemory(device.device(), bufferMemory);
-    mappedMemory = nullptr;
-  };
+  mappedMemory = static_cast<char *>(bufferMemory.mappedData) + offset;
+  return VK_SUCCESS;
 }
 
+void Buffer::unmap() { mappedMemory = nullptr; }
+
 void Buffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset) {
   assert(mappedMemory && "Cannot write to unmapped memory!");
 
@@ -61,101 +63,8 @@ void Buffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset) {
   }
 }
 
-void Buffer::getDepthBufferData(VkCommandBuffer &commandBuffer,
-                                const VkImage &srcImage,
-                                const VkExtent2D &extent,
-                                std::vector<float> &depthData,
-                                VkDeviceSize offset) {
-  assert(mappedMemory && "Cannot write to unmapped memory!");
-
-  VkImageCreateInfo imageInfo = {};
-  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-  imageInfo.imageType = VK_IMAGE_TYPE_2D;
-  imageInfo.extent.depth = 1.f;
-  imageInfo.extent.width = extent.width / 4;
-  imageInfo.extent.height = extent.height / 4;
-  imageInfo.usage =
-      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-  imageInfo.format = VK_FORMAT_D32_SFLOAT;
-  imageInfo.mipLevels = 1;
-  imageInfo.arrayLayers = 1;
-  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-  VkImage dstDepthImage;
-  VkDeviceMemory depthImageMemory;
-  device.createImageWithInfo(imageInfo,
-                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
-                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                             dstDepthImage, depthImageMemory);
-
-  VkImageBlit blit = {};
-  blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-  blit.srcSubresource.mipLevel = 0;
-  blit.srcSubresource.baseArrayLayer = 0;
-  blit.srcSubresource.layerCount = 1;
-  blit.srcOffsets[1] = {static_cast<int32_t>(extent.width),
-                        static_cast<int32_t>(extent.height), 1};
-
-  blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-  blit.dstSubresource.mipLevel = 0;
-  blit.dstSubresource.baseArrayLayer = 0;
-  blit.dstSubresource.layerCount = 1;
-  blit.dstOffsets[1] = {static_cast<int32_t>(extent.width / 4.f),
-                        static_cast<int32_t>(extent.height / 4.f), 1};
-
-  VkCommandBufferBeginInfo beginInfo = {};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-  vkResetCommandBuffer(commandBuffer, 0);
-  vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-  device.transitionDepthImage(commandBuffer, srcImage,
-                              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
-  device.transitionDepthImage(commandBuffer, dstDepthImage,
-                              VK_IMAGE_LAYOUT_UNDEFINED,
-                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-  vkCmdBlitImage(commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                 dstDepthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
-                 VK_FILTER_NEAREST);
-
-  VkBufferImageCopy region = {};
-  region.bufferOffset = offset;
-  region.bufferRowLength = 0;
-  region.bufferImageHeight = 0;
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-  region.imageSubresource.mipLevel = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = 1;
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {extent.width / 4, extent.height / 4, 1};
-
-  device.copyImageToBuffer(commandBuffer, buffer, dstDepthImage, region);
-
-  std::memcpy(depthData.data(), mappedMemory, depthData.size() * sizeof(float));
-
-  device.transitionDepthImage(commandBuffer, srcImage,
-                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-
-  device.submitCommands(commandBuffer);
-
-  vkDestroyImage(device.device(), dstDepthImage, nullptr);
-  vkFreeMemory(device.device(), depthImageMemory, nullptr);
-}
-
 void Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.size = size;
-  mappedRange.offset = offset;
-  mappedRange.memory = bufferMemory;
-  vkFlushMappedMemoryRanges(device.device(), 1, &mappedRange);
+  device.getMemoryAllocator().flush(bufferMemory, size, offset);
 }
 
 VkDescriptorBufferInfo Buffer::descriptorInfo() {
@@ -11,7 +11,8 @@ public:
   Buffer(Device &device, VkDeviceSize instanceSize, uint32_t instanceCount,
          VkBufferUsageFlags usageFlags,
          VkMemoryPropertyFlags memoryPropertyFlags,
-         VkDeviceSize minOffsetAlignment = 0);
+         VkDeviceSize minOffsetAlignment = 0,
+         VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
   ~Buffer();
   void cleanUp();
 
@@ -27,15 +28,11 @@ public:
   VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
   void writeToBuffer(void *data, VkDeviceSize size = VK_WHOLE_SIZE,
                      VkDeviceSize offset = 0);
-  void getDepthBufferData(VkCommandBuffer &commandBuffer, const VkImage &image,
-                          const VkExtent2D &extent,
-                          std::vector<float> &depthData,
-                          VkDeviceSize offset = 0);
   void flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
 private:
   VkBuffer buffer = VK_NULL_HANDLE;
-  VkDeviceMemory bufferMemory = VK_NULL_HANDLE;
+  MemoryAllocation bufferMemory;
   void *mappedMemory = nullptr;
 
   Device &device;
@@ -20,8 +20,6 @@ public:
     setView(position + offset, rotation);
   }
 
-  bool canSee(const glm::vec3 &position) const;
-
 private:
   glm::mat4 projectionMatrix{1.f};
   glm::mat4 viewMatrix{1.f};
@@ -0,0 +1,120 @@
+#include "cpu_profiler.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace engine {
+
+namespace {
+
+struct Event {
+  const char *name;
+  int64_t start;
+  int64_t duration;
+};
+
+// Only its own thread writes, the mutex is contended while writing a trace
+struct ThreadBuffer {
+  mutex lock;
+  uint32_t threadId;
+  string name;
+  vector<Event> events;
+  uint64_t count = 0;
+};
+
+mutex registryMutex;
+// Buffers outlive their threads so a trace still has their events
+vector<shared_ptr<ThreadBuffer>> threadBuffers;
+
+ThreadBuffer &getThreadBuffer() {
+  thread_local shared_ptr<ThreadBuffer> buffer = [] {
+    auto buffer = make_shared<ThreadBuffer>();
+    buffer->events.resize(CpuProfiler::EVENTS_PER_THREAD);
+
+    lock_guard<mutex> lock(registryMutex);
+    buffer->threadId = static_cast<uint32_t>(threadBuffers.size());
+    buffer->name = "thread " + to_string(buffer->threadId);
+    threadBuffers.push_back(buffer);
+    return buffer;
+  }();
+  return *buffer;
+}
+
+void writeEscaped(ofstream &file, const string &text) {
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      file << '\\';
+    file << c;
+  }
+}
+
+} // namespace
+
+void CpuProfiler::record(const char *name, int64_t start, int64_t end) {
+  ThreadBuffer &buffer = getThreadBuffer();
+  lock_guard<mutex> lock(buffer.lock);
+  buffer.events[buffer.count % EVENTS_PER_THREAD] = {name, start, end - start};
+  buffer.count++;
+}
+
+void CpuProfiler::setThreadName(const string &name) {
+  ThreadBuffer &buffer = getThreadBuffer();
+  lock_guard<mutex> lock(buffer.lock);
+  buffer.name = name;
+}
+
+void CpuProfiler::writeTrace(const string &path) {
+  ofstream file(path);
+  if (!file)
+    throw runtime_error("Failed to open trace file " + path + "!");
+
+  vector<shared_ptr<ThreadBuffer>> buffers;
+  {
+    lock_guard<mutex> lock(registryMutex);
+    buffers = threadBuffers;
+  }
+
+  // Timestamps are in microseconds, relative to the earliest kept event
+  vector<Event> events;
+  vector<uint32_t> eventThreads;
+  int64_t origin = INT64_MAX;
+  file << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto &buffer : buffers) {
+    lock_guard<mutex> lock(buffer->lock);
+    file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+         << "\"pid\":1,\"tid\":" << buffer->threadId
+         << ",\"args\":{\"name\":\"";
+    writeEscaped(file, buffer->name);
+    file << "\"}}";
+    first = false;
+
+    uint64_t kept = min<uint64_t>(buffer->count, EVENTS_PER_THREAD);
+    for (uint64_t i = buffer->count - kept; i < buffer->count; i++) {
+      const Event &event = buffer->events[i % EVENTS_PER_THREAD];
+      events.push_back(event);
+      eventThreads.push_back(buffer->threadId);
+      origin = min(origin, event.start);
+    }
+  }
+
+  file.precision(3);
+  file << fixed;
+  for (size_t i = 0; i < events.size(); i++) {
+    file << ",\n{\"name\":\"";
+    writeEscaped(file, events[i].name);
+    file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << eventThreads[i]
+         << ",\"ts\":" << (events[i].start - origin) / 1000.0
+         << ",\"dur\":" << events[i].duration / 1000.0 << "}";
+  }
+  file << "\n]}\n";
+}
+
+} // namespace engine
@@ -0,0 +1,59 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scopes are recorded into a ring buffer per thread and written out in the
+// Chrome trace format, which chrome://tracing and Perfetto open. Builds with
+// NDEBUG, like make release, compile every macro away.
+#ifdef NDEBUG
+#define PROFILE_SCOPE(name)
+#define PROFILE_THREAD(name)
+#else
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// The name has to outlive the trace, so it should be a string literal
+#define PROFILE_SCOPE(name)                                                    \
+  engine::CpuScope PROFILE_CONCAT(profileScope, __LINE__) { name }
+#define PROFILE_THREAD(name) engine::CpuProfiler::setThreadName(name)
+#endif
+
+namespace engine {
+
+class CpuProfiler {
+public:
+#ifdef NDEBUG
+  static constexpr bool ENABLED = false;
+#else
+  static constexpr bool ENABLED = true;
+#endif
+  // Older events of a thread are overwritten once its ring is full
+  static constexpr uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static void record(const char *name, int64_t start, int64_t end);
+  static void setThreadName(const std::string &name);
+
+  // Safe while other threads keep recording
+  static void writeTrace(const std::string &path);
+};
+
+class CpuScope {
+public:
+  explicit CpuScope(const char *name) : name{name}, start{CpuProfiler::now()} {}
+  ~CpuScope() { CpuProfiler::record(name, start, CpuProfiler::now()); }
+
+  CpuScope(const CpuScope &) = delete;
+  CpuScope &operator=(const CpuScope &) = delete;
+
+private:
+  const char *name;
+  int64_t start;
+};
+
+} // namespace engine
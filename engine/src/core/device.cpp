@@ -1,7 +1,9 @@
 #include "device.hpp"
-#include "../include/stb_image.h"
 #include "model.hpp"
+#include "texture_cache.hpp"
+#include "upload_batch.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -58,16 +60,24 @@ Device::Device(Window &window) : window{window} {
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  memoryAllocator = make_unique<MemoryAllocator>(physicalDevice, device_,
+                                                 memoryBudgetSupported);
+  pipelineCache =
+      make_unique<PipelineCache>(device_, properties, PIPELINE_CACHE_PATH);
 }
 
 Device::~Device() {
+  pipelineCache.reset();
+  memoryAllocator.reset();
+  vkDestroyCommandPool(device_, transferCommandPool, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
   if (enableValidationLayers)
     destroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 
-  vkDestroySurfaceKHR(instance, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE)
+    vkDestroySurfaceKHR(instance, surface_, nullptr);
   vkDestroyInstance(instance, nullptr);
 }
 
@@ -122,7 +132,10 @@ void Device::setupDebugMessenger() {
     throw runtime_error("Failed to set up debug messenger!");
 }
 
-void Device::createSurface() { window.createSurface(instance, &surface_); }
+void Device::createSurface() {
+  if (!window.isHeadless())
+    window.createSurface(instance, &surface_);
+}
 
 void Device::pickPhysicalDevice() {
   uint32_t deviceCount = 0;
@@ -149,10 +162,12 @@ void Device::pickPhysicalDevice() {
 
 void Device::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  queueFamilyIndices = indices;
 
   vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   set<uint32_t> uniqueQueueFamilies = {indices.presentFamily.value(),
-                                       indices.graphicsFamily.value()};
+                                       indices.graphicsFamily.value(),
+                                       indices.transferFamily.value()};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -173,23 +188,72 @@ void Device::createLogicalDevice() {
   vulkan13Features.sType =
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
 
+  VkPhysicalDeviceVulkan12Features supportedVulkan12Features = {};
+  supportedVulkan12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 supportedFeatures = {};
+  supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  supportedFeatures.pNext = &supportedVulkan12Features;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+  drawIndirectCountSupported = supportedVulkan12Features.drawIndirectCount;
+  hostQueryResetSupported = supportedVulkan12Features.hostQueryReset;
+
+  // Block compressed textures fall back to RGBA8 without it
+  VkFormatProperties bc1Properties;
+  vkGetPhysicalDeviceFormatProperties(
+      physicalDevice, VK_FORMAT_BC1_RGB_SRGB_BLOCK, &bc1Properties);
+  textureCompressionBCSupported =
+      supportedFeatures.features.textureCompressionBC &&
+      (bc1Properties.optimalTilingFeatures &
+       VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+  deviceFeatures.textureCompressionBC = textureCompressionBCSupported;
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+  vulkan12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+  vulkan12Features.drawIndirectCount = drawIndirectCountSupported;
+  vulkan12Features.hostQueryReset = hostQueryResetSupported;
+  vulkan12Features.pNext = &vulkan13Features;
+
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   createInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
-  createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  vector<const char *> extensions = getDeviceExtensions();
+  // Optional, heap budgets fall back to the allocator's own accounting
+  memoryBudgetSupported = isDeviceExtensionAvailable(
+      physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (memoryBudgetSupported)
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.pNext = &vulkan13Features;
+  createInfo.pNext = &vulkan12Features;
 
   if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device_) !=
       VK_SUCCESS)
     throw runtime_error("Failed to create logical device!");
 
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           nullptr);
+  vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           queueFamilies.data());
+  timestampValidBits =
+      queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+  // Transfer queues can't reset queries, so theirs are reset on the host
+  if (hostQueryResetSupported)
+    transferTimestampValidBits =
+        queueFamilies[indices.transferFamily.value()].timestampValidBits;
+
   vkGetDeviceQueue(device_, indices.graphicsFamily.value(), 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily.value(), 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily.value(), 0,
+                   &transferQueue_);
 }
 
 void Device::createCommandPool() {
@@ -204,6 +268,11 @@ void Device::createCommandPool() {
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) !=
       VK_SUCCESS)
     throw runtime_error("Failed to create command pool!");
+
+  poolInfo.queueFamilyIndex = indices.transferFamily.value();
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr,
+                          &transferCommandPool) != VK_SUCCESS)
+    throw runtime_error("Failed to create transfer command pool!");
 }
 
 VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -255,6 +324,7 @@ void Device::submitCommands(VkCommandBuffer &commandBuffer) {
     throw runtime_error("Failed to submit command buffer!");
 
   vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
+  vkDestroyFence(device_, fence, nullptr);
 }
 
 bool Device::checkValidationLayerSupport() {
@@ -295,11 +365,13 @@ void Device::populateDebugMessenger(
 }
 
 vector<const char *> Device::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  vector<const char *> extensions(glfwExtensions,
-                                  glfwExtensions + glfwExtensionCount);
+  vector<const char *> extensions;
+  if (!window.isHeadless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers)
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -311,13 +383,23 @@ vector<const char *> Device::getRequiredExtensions() {
   return extensions;
 }
 
+vector<const char *> Device::getDeviceExtensions() {
+  vector<const char *> extensions = deviceExtensions;
+  if (window.isHeadless())
+    erase_if(extensions, [](const char *extension) {
+      return strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+    });
+  return extensions;
+}
+
 bool Device::isDeviceSuitable(VkPhysicalDevice device) {
   QueueFamilyIndices indices = findQueueFamilies(device);
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequat = false;
-  if (extensionsSupported) {
+  // Offscreen frames need no presentation support
+  bool swapChainAdequat = window.isHeadless();
+  if (extensionsSupported && !window.isHeadless()) {
     SwapchainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequat = !swapChainSupport.formats.empty() &&
                        !swapChainSupport.presentModes.empty();
@@ -342,22 +424,38 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 &&
-        queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-      indices.graphicsFamily = i;
-
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-
-    if (queueFamily.queueCount > 0 && presentSupport)
-      indices.presentFamily = i;
+    if (!indices.isComplete()) {
+      if (queueFamily.queueCount > 0 &&
+          queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        indices.graphicsFamily = i;
+
+      // Headless frames are never presented, graphics stands in
+      VkBool32 presentSupport = false;
+      if (surface_ != VK_NULL_HANDLE)
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_,
+                                             &presentSupport);
+      else
+        presentSupport = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+
+      if (queueFamily.queueCount > 0 && presentSupport)
+        indices.presentFamily = i;
+    }
 
-    if (indices.isComplete())
-      break;
+    // Prefer a pure copy engine, it runs next to the graphics queue
+    if (queueFamily.queueCount > 0 &&
+        queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+        !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+      bool isComputeFamily = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+      if (!indices.transferFamily.has_value() || !isComputeFamily)
+        indices.transferFamily = i;
+    }
 
     i++;
   }
 
+  if (!indices.transferFamily.has_value())
+    indices.transferFamily = indices.graphicsFamily;
+
   return indices;
 }
 
@@ -370,8 +468,8 @@ bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
                                        availableExtensions.data());
 
-  set<std::string> requiredExtensions(deviceExtensions.begin(),
-                                      deviceExtensions.end());
+  vector<const char *> extensions = getDeviceExtensions();
+  set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
   for (const auto &extension : availableExtensions) {
     requiredExtensions.erase(extension.extensionName);
@@ -380,6 +478,23 @@ bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool Device::isDeviceExtensionAvailable(VkPhysicalDevice device,
+                                        const char *name) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+
+  vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, name) == 0)
+      return true;
+  }
+  return false;
+}
+
 SwapchainSupportDetails Device::querySwapChainSupport(VkPhysicalDevice device) {
   SwapchainSupportDetails details;
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface_,
@@ -427,67 +542,59 @@ VkFormat Device::findSupportedFormat(const vector<VkFormat> &candidates,
 
 void Device::createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                  VkMemoryPropertyFlags properties,
-                                 VkImage &image, VkDeviceMemory &imageMemory) {
+                                 VkImage &image,
+                                 MemoryAllocation &imageMemory) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS)
     throw runtime_error("Failed to create Image!");
 
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex =
-      findMemoryType(memRequirements.memoryTypeBits, properties);
+  imageMemory = memoryAllocator->allocate(
+      memRequirements, properties,
+      imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) !=
-      VK_SUCCESS)
-    throw runtime_error("Failed to allocate image memory!");
-
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS)
+  if (vkBindImageMemory(device_, image, imageMemory.memory,
+                        imageMemory.offset) != VK_SUCCESS)
     throw runtime_error("Failed to bind image memory!");
 }
 
-uint32_t Device::findMemoryType(uint32_t typeFilter,
-                                VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) &&
-        (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-      return i;
-  }
-
-  throw runtime_error("Failed to find suitable memory type!");
-}
-
 void Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                           VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                          VkDeviceMemory &bufferMemory) {
+                          MemoryAllocation &bufferMemory,
+                          VkSharingMode sharingMode) {
   VkBufferCreateInfo bufferInfo = {};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+  // Concurrent buffers are shared between the graphics and transfer queue so
+  // uploads need no ownership transfer
+  uint32_t queueFamilies[] = {queueFamilyIndices.graphicsFamily.value(),
+                              queueFamilyIndices.transferFamily.value()};
+  if (sharingMode == VK_SHARING_MODE_CONCURRENT &&
+      hasDedicatedTransferQueue()) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices = queueFamilies;
+  }
+
   if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
     throw runtime_error("Failed to create buffer!");
 
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex =
-      findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferMemory = memoryAllocator->allocate(memRequirements, properties, true);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) !=
-      VK_SUCCESS)
-    throw runtime_error("Failed to allocate buffer memory!");
+  if (vkBindBufferMemory(device_, buffer, bufferMemory.memory,
+                         bufferMemory.offset) != VK_SUCCESS)
+    throw runtime_error("Failed to bind buffer memory!");
+}
 
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+void Device::freeMemory(MemoryAllocation &memory) {
+  memoryAllocator->free(memory);
 }
 
 void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
@@ -524,197 +631,104 @@ void Device::copyModel(VkBuffer srcBuffer, VkBuffer vertexBuffer,
   endSingleTimeCommands(commandBuffer);
 }
 
-void Device::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
-                               uint32_t height) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferImageCopy region = {};
-  region.bufferOffset = 0;
-  region.bufferRowLength = 0;
-  region.bufferImageHeight = 0;
-
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = 1;
+void Device::generateImageArray(const vector<string> &filenames,
+                                VkImageView &imageView, VkSampler &sampler) {
+  if (filenames.empty())
+    throw runtime_error("Cannot create an image array without layers!");
 
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {width, height, 1};
-
-  vkCmdCopyBufferToImage(commandBuffer, buffer, image,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-  endSingleTimeCommands(commandBuffer);
-}
-
-void Device::copyImageToBuffer(VkCommandBuffer &commandBuffer,
-                               VkBuffer dstBuffer, VkImage image,
-                               VkBufferImageCopy region) {
-  transitionDepthImage(commandBuffer, image,
-                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
-  vkCmdCopyImageToBuffer(commandBuffer, image,
-                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer, 1,
-                         &region);
-}
-
-void Device::transitionImageLayout(VkImage image, VkImageLayout oldLayout,
-                                   VkImageLayout newLayout) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkImageMemoryBarrier barrier = {};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = oldLayout;
-  barrier.newLayout = newLayout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = image;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 1;
-
-  VkPipelineStageFlags sourceStage;
-  VkPipelineStageFlags destinationStage;
-
-  if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-      newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-             newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  } else {
-    throw std::invalid_argument("unsupported layout transition!");
-  }
-
-  vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0,
-                       nullptr, 0, nullptr, 1, &barrier);
-
-  endSingleTimeCommands(commandBuffer);
-}
-
-void Device::transitionDepthImage(VkCommandBuffer commandBuffer, VkImage image,
-                                  VkImageLayout oldLayout,
-                                  VkImageLayout newLayout) {
-  if (oldLayout == newLayout)
-    return;
-
-  VkAccessFlags srcAccessMask = 0;
-  VkAccessFlags dstAccessMask = 0;
-
-  VkPipelineStageFlags srcStage = 0;
-  VkPipelineStageFlags dstStage = 0;
-
-  if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
-    srcStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else if (oldLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-    srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-    srcStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
-    srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-    dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-    srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else {
-    throw invalid_argument("Unsupported layout transition!");
+  // Every layer is scaled to the largest source
+  uint32_t textureWidth = 0, textureHeight = 0;
+  for (const string &filename : filenames) {
+    uint32_t width, height;
+    TextureCache::getSourceSize(filename, width, height);
+    textureWidth = max(textureWidth, width);
+    textureHeight = max(textureHeight, height);
   }
 
-  VkImageMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = oldLayout;
-  barrier.newLayout = newLayout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = image;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 1;
-
-  barrier.srcAccessMask = srcAccessMask;
-  barrier.dstAccessMask = dstAccessMask;
-
-  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0,
-                       nullptr, 1, &barrier);
-}
-
-void Device::generateImage(const char *filename, VkImageView &imageView,
-                           VkSampler &sampler) {
-  int textureWidth, textureHeight, textureChannels;
-  stbi_uc *textureData = stbi_load(filename, &textureWidth, &textureHeight,
-                                   &textureChannels, STBI_rgb_alpha);
-  VkDeviceSize textureSize = textureWidth * textureHeight * 4;
-
-  if (!textureData) {
-    cerr << "Failed to load texture image: " << stbi_failure_reason() << endl;
-    throw runtime_error("Failed to load texture image");
-  }
-
-  Buffer textureStagingBuffer{*this, textureSize, 1,
-                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-  textureStagingBuffer.map();
-  textureStagingBuffer.writeToBuffer((void *)textureData);
-
-  stbi_image_free(textureData);
+  TextureCache textureCache;
+  vector<TextureImage> layers;
+  for (const string &filename : filenames)
+    layers.push_back(textureCache.load(filename, textureWidth, textureHeight,
+                                       textureCompressionBCSupported));
+
+  VkFormat format = layers.front().format;
+  uint32_t layerCount = static_cast<uint32_t>(layers.size());
+  uint32_t mipLevels = static_cast<uint32_t>(layers.front().levels.size());
+
+  VkDeviceSize stagingSize = 0;
+  for (const TextureImage &layer : layers)
+    for (const TextureImage::Level &level : layer.levels)
+      stagingSize += level.data.size();
+
+  // Transfers and both transitions go out as one submission
+  UploadBatch uploadBatch{*this};
+  VkBuffer stagingBuffer;
+  VkDeviceSize stagingOffset;
+  char *stagingData = static_cast<char *>(
+      uploadBatch.stage(stagingSize, stagingBuffer, stagingOffset));
+
+  // Level sizes are whole blocks, so every offset stays block aligned
+  vector<VkBufferImageCopy> regions;
+  VkDeviceSize offset = 0;
+  for (uint32_t layer = 0; layer < layerCount; layer++)
+    for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++) {
+      TextureImage::Level &level = layers[layer].levels[mipLevel];
+      memcpy(stagingData + offset, level.data.data(), level.data.size());
+
+      VkBufferImageCopy region = {};
+      region.bufferOffset = stagingOffset + offset;
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.mipLevel = mipLevel;
+      region.imageSubresource.baseArrayLayer = layer;
+      region.imageSubresource.layerCount = 1;
+      region.imageExtent = {level.width, level.height, 1};
+      regions.push_back(region);
+
+      offset += level.data.size();
+    }
 
   VkImage image;
-  VkDeviceMemory textureImageMemory;
+  MemoryAllocation textureImageMemory;
 
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   imageInfo.imageType = VK_IMAGE_TYPE_2D;
-  imageInfo.extent.width = static_cast<uint32_t>(textureWidth);
-  imageInfo.extent.height = static_cast<uint32_t>(textureHeight);
+  imageInfo.extent.width = textureWidth;
+  imageInfo.extent.height = textureHeight;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
-  imageInfo.arrayLayers = 1;
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = layerCount;
   imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
   imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
   imageInfo.usage =
       VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
   imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+  imageInfo.format = format;
 
   createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image,
                       textureImageMemory);
-  transitionImageLayout(image, VK_IMAGE_LAYOUT_UNDEFINED,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  copyBufferToImage(textureStagingBuffer.getBuffer(), image,
-                    static_cast<uint32_t>(textureWidth),
-                    static_cast<uint32_t>(textureHeight));
-  transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  uploadBatch.transitionImageLayout(image, VK_IMAGE_LAYOUT_UNDEFINED,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    layerCount, mipLevels);
+  uploadBatch.copyBufferToImage(stagingBuffer, image, regions);
+  uploadBatch.transitionImageLayout(image,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                    layerCount, mipLevels);
+  // The view and sampler are created while the upload runs
+  uploadBatch.submit();
 
   VkImageViewCreateInfo viewInfo = {};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   viewInfo.image = image;
-  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-  viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+  viewInfo.format = format;
   viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
-  viewInfo.subresourceRange.layerCount = 1;
+  viewInfo.subresourceRange.layerCount = layerCount;
 
   if (vkCreateImageView(device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS)
     throw std::runtime_error("Failed to create image views!");
@@ -735,7 +749,7 @@ void Device::generateImage(const char *filename, VkImageView &imageView,
   samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
   samplerInfo.mipLodBias = 0.0f;
   samplerInfo.minLod = 0.0f;
-  samplerInfo.maxLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
   if (vkCreateSampler(device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
     throw std::runtime_error("Failed to create texture sampler!");
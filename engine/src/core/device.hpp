@@ -1,8 +1,12 @@
 #ifndef DEVICE_HPP
 #define DEVICE_HPP
+#include "memory_allocator.hpp"
+#include "pipeline_cache.hpp"
 #include "window.hpp"
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 #include <vulkan/vk_platform.h>
 #include <vulkan/vulkan.h>
@@ -13,6 +17,8 @@ namespace engine {
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // Transfer only family if the device has one, else the graphics family
+  std::optional<uint32_t> transferFamily;
   bool isComplete() {
     return graphicsFamily.has_value() && presentFamily.has_value();
   }
@@ -26,6 +32,8 @@ struct SwapchainSupportDetails {
 
 class Device {
 public:
+  static constexpr const char *PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
   Device(Window &window);
   ~Device();
 
@@ -34,11 +42,31 @@ public:
   Device(const Device &&) = delete;
   Device &operator=(const Device &&) = delete;
 
+  // Null for headless windows, frames then go to offscreen images
   VkSurfaceKHR surface() { return surface_; }
+  bool isHeadless() { return surface_ == VK_NULL_HANDLE; }
   VkDevice device() { return device_; }
   VkCommandPool getCommandPool() { return commandPool; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
+  VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+  bool supportsDrawIndirectCount() { return drawIndirectCountSupported; }
+  bool supportsTextureCompressionBC() {
+    return textureCompressionBCSupported;
+  }
+  // 0 if the graphics queue cannot write timestamps
+  uint32_t getTimestampValidBits() { return timestampValidBits; }
+  // 0 if the transfer queue cannot write timestamps or queries cannot be
+  // reset on the host
+  uint32_t getTransferTimestampValidBits() {
+    return transferTimestampValidBits;
+  }
+  float getTimestampPeriod() { return properties.limits.timestampPeriod; }
+  bool hasDedicatedTransferQueue() {
+    return queueFamilyIndices.transferFamily !=
+           queueFamilyIndices.graphicsFamily;
+  }
 
   SwapchainSupportDetails getSwapChainSupport() {
     return querySwapChainSupport(physicalDevice);
@@ -52,15 +80,23 @@ public:
                                VkImageTiling tiling,
                                VkFormatFeatureFlags features);
 
+  MemoryAllocator &getMemoryAllocator() { return *memoryAllocator; }
+  VkPipelineCache getPipelineCache() { return pipelineCache->getCache(); }
+
   void createImageWithInfo(const VkImageCreateInfo &imageInfo,
                            VkMemoryPropertyFlags properties, VkImage &image,
-                           VkDeviceMemory &imageMemory);
+                           MemoryAllocation &imageMemory);
 
   void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                     VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                    VkDeviceMemory &bufferMemory);
-  void generateImage(const char *filename, VkImageView &imageView,
-                     VkSampler &sampler);
+                    MemoryAllocation &bufferMemory,
+                    VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
+  void freeMemory(MemoryAllocation &memory);
+  // One 2D array layer per file with a full mip chain. Files may differ in
+  // size, every layer is scaled to the largest width and height among them.
+  // Block compressed through the texture cache where the device supports it.
+  void generateImageArray(const std::vector<std::string> &filenames,
+                          VkImageView &imageView, VkSampler &sampler);
 
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size,
                   VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
@@ -68,15 +104,6 @@ public:
                  VkBuffer indexBuffer, VkDeviceSize vertexSize,
                  VkDeviceSize indexSize);
 
-  void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
-                         uint32_t height);
-  void copyImageToBuffer(VkCommandBuffer &commandBuffer, VkBuffer dstBuffer,
-                         VkImage image, VkBufferImageCopy region);
-  void transitionImageLayout(VkImage image, VkImageLayout oldLayout,
-                             VkImageLayout newLayout);
-  void transitionDepthImage(VkCommandBuffer commandBuffer, VkImage image,
-                            VkImageLayout oldLayout, VkImageLayout newLayout);
-
   VkCommandBuffer allocateCommandBuffer(VkCommandBufferLevel level);
   VkCommandBuffer beginSingleTimeCommands();
   void submitCommands(VkCommandBuffer &commandBuffer);
@@ -97,6 +124,8 @@ private:
   void createCommandPool();
 
   std::vector<const char *> getRequiredExtensions();
+  // Without the swap chain extension when headless
+  std::vector<const char *> getDeviceExtensions();
 
   bool checkValidationLayerSupport();
   void populateDebugMessenger(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
@@ -104,22 +133,31 @@ private:
   bool isDeviceSuitable(VkPhysicalDevice device);
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char *name);
   SwapchainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
-  uint32_t findMemoryType(uint32_t typeFilter,
-                          VkMemoryPropertyFlags properties);
-
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   Window &window;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   VkPhysicalDeviceProperties properties;
   VkCommandPool commandPool;
+  VkCommandPool transferCommandPool;
+  QueueFamilyIndices queueFamilyIndices;
+  bool drawIndirectCountSupported = false;
+  bool textureCompressionBCSupported = false;
+  bool memoryBudgetSupported = false;
+  bool hostQueryResetSupported = false;
+  uint32_t timestampValidBits = 0;
+  uint32_t transferTimestampValidBits = 0;
+  std::unique_ptr<MemoryAllocator> memoryAllocator;
+  std::unique_ptr<PipelineCache> pipelineCache;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
 
   const std::vector<const char *> validationLayers = {
       "VK_LAYER_KHRONOS_validation"};
@@ -0,0 +1,64 @@
+#include "draw_list.hpp"
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+DrawList::DrawList(uint32_t capacity) : capacity{capacity} {
+  commands.reserve(capacity);
+  denseToSlot.reserve(capacity);
+}
+
+bool DrawList::allocateSlot(uint32_t &slot) {
+  if (!freeSlots.empty()) {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+    return true;
+  }
+
+  if (slotToDense.size() >= capacity)
+    return false;
+
+  slot = static_cast<uint32_t>(slotToDense.size());
+  slotToDense.push_back(INVALID_INDEX);
+  return true;
+}
+
+void DrawList::freeSlot(uint32_t slot) {
+  assert(slot < slotToDense.size() && "Slot was never allocated!");
+  assert(!contains(slot) && "Slot has to be removed before it is freed!");
+  freeSlots.push_back(slot);
+}
+
+void DrawList::add(uint32_t slot, VkDrawIndexedIndirectCommand command) {
+  assert(slot < slotToDense.size() && "Slot was never allocated!");
+  assert(!contains(slot) && "Slot already has a draw!");
+
+  command.firstInstance = slot;
+  slotToDense[slot] = static_cast<uint32_t>(commands.size());
+  commands.push_back(command);
+  denseToSlot.push_back(slot);
+  version++;
+}
+
+void DrawList::remove(uint32_t slot) {
+  if (!contains(slot))
+    return;
+
+  uint32_t index = slotToDense[slot];
+  uint32_t last = static_cast<uint32_t>(commands.size() - 1);
+  if (index != last) {
+    commands[index] = commands[last];
+    denseToSlot[index] = denseToSlot[last];
+    slotToDense[denseToSlot[index]] = index;
+  }
+
+  commands.pop_back();
+  denseToSlot.pop_back();
+  slotToDense[slot] = INVALID_INDEX;
+  version++;
+}
+
+} // namespace engine
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// Dense list of indexed indirect draws. Every draw owns a stable slot that
+// indexes its ChunkDrawData (passed as firstInstance), while the commands
+// themselves stay packed: removing a draw moves the last command into the
+// hole, so [0, size()) never contains empty entries.
+class DrawList {
+public:
+  static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+  DrawList(uint32_t capacity);
+
+  bool allocateSlot(uint32_t &slot);
+  void freeSlot(uint32_t slot);
+
+  void add(uint32_t slot, VkDrawIndexedIndirectCommand command);
+  void remove(uint32_t slot);
+  bool contains(uint32_t slot) const {
+    return slot < slotToDense.size() && slotToDense[slot] != INVALID_INDEX;
+  }
+
+  uint32_t size() const { return static_cast<uint32_t>(commands.size()); }
+  uint32_t getCapacity() const { return capacity; }
+  // Every slot ever handed out lies below this
+  uint32_t getSlotCount() const {
+    return static_cast<uint32_t>(slotToDense.size());
+  }
+  const VkDrawIndexedIndirectCommand *data() const { return commands.data(); }
+  // Bumped on every change, lets per frame copies tell if they are stale
+  uint64_t getVersion() const { return version; }
+
+private:
+  uint32_t capacity;
+  uint64_t version = 0;
+
+  std::vector<VkDrawIndexedIndirectCommand> commands;
+  std::vector<uint32_t> denseToSlot;
+  std::vector<uint32_t> slotToDense;
+  std::vector<uint32_t> freeSlots;
+};
+
+} // namespace engine
@@ -12,6 +12,9 @@ struct FrameInfo {
   Camera camera;
   VkDescriptorSet &descriptorSet;
   std::shared_ptr<Buffer> drawCallBuffer;
-  std::shared_ptr<Buffer> objectDataBuffer;
+  std::shared_ptr<Buffer> drawDataBuffer;
+  // Set when the draw calls were culled on the GPU, drawCallBuffer then
+  // holds the compacted list and this buffer its length
+  std::shared_ptr<Buffer> drawCountBuffer = nullptr;
 };
 } // namespace engine
@@ -0,0 +1,60 @@
+#include "frustum.hpp"
+#include "box_list.hpp"
+#include <cassert>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace engine {
+
+void Frustum::testBoxesScalar(const BoxList &boxes, uint32_t count,
+                              uint8_t *visible) const {
+  assert(count <= boxes.getCapacity() && "Box count exceeds the list!");
+  for (uint32_t i = 0; i < count; i++)
+    visible[i] = intersects(boxes.getMin(i), boxes.getMax(i));
+}
+
+void Frustum::testBoxes(const BoxList &boxes, uint32_t count,
+                        uint8_t *visible) const {
+#ifdef __SSE2__
+  assert(count <= boxes.getCapacity() && "Box count exceeds the list!");
+
+  // The corner furthest along a normal only depends on the normal's signs,
+  // so each plane reads one fixed array per axis
+  const float *positiveX[6], *positiveY[6], *positiveZ[6];
+  for (int p = 0; p < 6; p++) {
+    positiveX[p] = planes[p].x >= 0.f ? boxes.maxX.data() : boxes.minX.data();
+    positiveY[p] = planes[p].y >= 0.f ? boxes.maxY.data() : boxes.minY.data();
+    positiveZ[p] = planes[p].z >= 0.f ? boxes.maxZ.data() : boxes.minZ.data();
+  }
+
+  // The list is padded, a batch may read past count but never past capacity
+  const __m128 zero = _mm_setzero_ps();
+  for (uint32_t i = 0; i < count; i += BoxList::BATCH_SIZE) {
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      // Summed in the same order as intersects so both agree on the edge
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x),
+                                           _mm_loadu_ps(positiveX[p] + i)),
+                                _mm_mul_ps(_mm_set1_ps(planes[p].y),
+                                           _mm_loadu_ps(positiveY[p] + i))),
+                     _mm_mul_ps(_mm_set1_ps(planes[p].z),
+                                _mm_loadu_ps(positiveZ[p] + i))),
+          _mm_set1_ps(planes[p].w));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (uint32_t lane = 0; lane < BoxList::BATCH_SIZE && i + lane < count;
+         lane++)
+      visible[i + lane] = (mask >> lane) & 1;
+  }
+#else
+  testBoxesScalar(boxes, count, visible);
+#endif
+}
+
+} // namespace engine
@@ -0,0 +1,60 @@
+#pragma once
+#include "box_list.hpp"
+#include <array>
+#include <cstdint>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_float4.hpp>
+#include <glm/geometric.hpp>
+
+namespace engine {
+
+// View frustum as six inward facing planes (xyz = normal, w = distance),
+// extracted from a projection * view matrix with a [0, 1] depth range.
+struct Frustum {
+  enum Plane { Left, Right, Bottom, Top, Near, Far };
+
+  std::array<glm::vec4, 6> planes;
+
+  static Frustum fromMatrix(const glm::mat4 &projectionView) {
+    auto row = [&](int i) {
+      return glm::vec4{projectionView[0][i], projectionView[1][i],
+                       projectionView[2][i], projectionView[3][i]};
+    };
+
+    Frustum frustum;
+    frustum.planes[Left] = row(3) + row(0);
+    frustum.planes[Right] = row(3) - row(0);
+    frustum.planes[Bottom] = row(3) + row(1);
+    frustum.planes[Top] = row(3) - row(1);
+    frustum.planes[Near] = row(2);
+    frustum.planes[Far] = row(3) - row(2);
+
+    for (glm::vec4 &plane : frustum.planes)
+      plane /= glm::length(glm::vec3{plane});
+
+    return frustum;
+  }
+
+  // Tests the box corner furthest along each plane normal, conservative for
+  // boxes near frustum corners
+  bool intersects(const glm::vec3 &min, const glm::vec3 &max) const {
+    for (const glm::vec4 &plane : planes) {
+      glm::vec3 positive{plane.x >= 0.f ? max.x : min.x,
+                         plane.y >= 0.f ? max.y : min.y,
+                         plane.z >= 0.f ? max.z : min.z};
+      if (glm::dot(glm::vec3{plane}, positive) + plane.w < 0.f)
+        return false;
+    }
+    return true;
+  }
+
+  // Same test as intersects for the first count boxes, 4 at a time where
+  // SSE2 is available. Writes 1 for every visible box and 0 otherwise.
+  void testBoxes(const BoxList &boxes, uint32_t count, uint8_t *visible) const;
+  // Reference for testBoxes, one box at a time
+  void testBoxesScalar(const BoxList &boxes, uint32_t count,
+                       uint8_t *visible) const;
+};
+
+} // namespace engine
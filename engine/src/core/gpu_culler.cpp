@@ -0,0 +1,218 @@
+#include "gpu_culler.hpp"
+#include "swapchain.hpp"
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+GpuCuller::GpuCuller(Device &device, uint32_t maxDrawCount,
+                     const vector<shared_ptr<Buffer>> &drawCallBuffers,
+                     Buffer &boundsBuffer,
+                     VkExtent2D depthExtent)
+    : device{device} {
+  depthPyramid = make_unique<HiZPyramid>(device, depthExtent);
+
+  descriptorSetLayout =
+      DescriptorSetLayout::Builder(device)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .build();
+
+  uint32_t setCount = SwapChain::MAX_FRAMES_IN_FLIGHT * PhaseCount;
+  descriptorPool =
+      DescriptorPool::Builder(device)
+          .setMaxSets(setCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * setCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+          .build();
+
+  createPipelineLayout();
+  pipeline = make_unique<ComputePipeline>(device, "src/shaders/cull.comp.spv",
+                                          pipelineLayout);
+
+  visibilityBuffer = make_unique<Buffer>(
+      device, sizeof(uint32_t), maxDrawCount,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  clearVisibility();
+
+  cullDataBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+  culledDrawCallBuffers.resize(setCount);
+  drawCountBuffers.resize(setCount);
+  descriptorSets.resize(setCount);
+  for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+    cullDataBuffers[i] = make_unique<Buffer>(
+        device, sizeof(CullData), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    cullDataBuffers[i]->map();
+
+    for (int phase = 0; phase < PhaseCount; phase++) {
+      size_t index = bufferIndex(i, static_cast<Phase>(phase));
+      culledDrawCallBuffers[index] = make_shared<Buffer>(
+          device, sizeof(VkDrawIndexedIndirectCommand), maxDrawCount,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      drawCountBuffers[index] = make_shared<Buffer>(
+          device, sizeof(uint32_t), 1,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+      auto drawCallInfo = drawCallBuffers[i]->descriptorInfo();
+      auto boundsInfo = boundsBuffer.descriptorInfo();
+      auto culledDrawCallInfo = culledDrawCallBuffers[index]->descriptorInfo();
+      auto drawCountInfo = drawCountBuffers[index]->descriptorInfo();
+      auto visibilityInfo = visibilityBuffer->descriptorInfo();
+      auto cullDataInfo = cullDataBuffers[i]->descriptorInfo();
+      auto depthPyramidInfo = depthPyramid->descriptorInfo();
+      DescriptorWriter(*descriptorSetLayout, *descriptorPool)
+          .writeBuffer(0, &drawCallInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+          .writeBuffer(1, &boundsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+          .writeBuffer(2, &culledDrawCallInfo,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+          .writeBuffer(3, &drawCountInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+          .writeBuffer(4, &visibilityInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+          .writeBuffer(5, &cullDataInfo)
+          .writeImage(6, &depthPyramidInfo)
+          .build(descriptorSets[index]);
+    }
+  }
+}
+
+GpuCuller::~GpuCuller() {
+  vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+}
+
+void GpuCuller::createPipelineLayout() {
+  VkDescriptorSetLayout setLayout =
+      descriptorSetLayout->getDescriptorSetLayout();
+
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(PushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS)
+    throw runtime_error("Failed to create culling pipeline layout!");
+}
+
+// Nothing counts as visible at first, every draw goes through the late phase
+void GpuCuller::clearVisibility() {
+  VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+  vkCmdFillBuffer(commandBuffer, visibilityBuffer->getBuffer(), 0,
+                  VK_WHOLE_SIZE, 0);
+  device.endSingleTimeCommands(commandBuffer);
+}
+
+void GpuCuller::writeDepthPyramidDescriptors() {
+  auto depthPyramidInfo = depthPyramid->descriptorInfo();
+  for (VkDescriptorSet &descriptorSet : descriptorSets)
+    DescriptorWriter(*descriptorSetLayout, *descriptorPool)
+        .writeImage(6, &depthPyramidInfo)
+        .overwrite(descriptorSet);
+}
+
+void GpuCuller::beginFrame(int frameIndex, const glm::mat4 &projectionView,
+                           VkExtent2D depthExtent) {
+  VkExtent2D pyramidDepthExtent = depthPyramid->getDepthExtent();
+  if (pyramidDepthExtent.width != depthExtent.width ||
+      pyramidDepthExtent.height != depthExtent.height) {
+    // Every frame in flight references the old pyramid
+    vkDeviceWaitIdle(device.device());
+    depthPyramid.reset();
+    depthPyramid = make_unique<HiZPyramid>(device, depthExtent);
+    writeDepthPyramidDescriptors();
+  }
+
+  Frustum frustum = Frustum::fromMatrix(projectionView);
+
+  CullData cullData{};
+  cullData.projectionView = projectionView;
+  for (int i = 0; i < 6; i++)
+    cullData.planes[i] = frustum.planes[i];
+  cullData.pyramidSize = {depthPyramid->getExtent().width,
+                          depthPyramid->getExtent().height};
+  cullData.pyramidLevelCount = depthPyramid->getLevelCount();
+  cullDataBuffers[frameIndex]->writeToBuffer(&cullData);
+}
+
+void GpuCuller::cull(VkCommandBuffer commandBuffer, int frameIndex,
+                     uint32_t drawCount, Phase phase) {
+  size_t index = bufferIndex(frameIndex, phase);
+
+  vkCmdFillBuffer(commandBuffer, drawCountBuffers[index]->getBuffer(), 0,
+                  sizeof(uint32_t), 0);
+
+  // Also orders the visibility flags written by the previous late phase
+  VkMemoryBarrier clearBarrier = {};
+  clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  clearBarrier.srcAccessMask =
+      VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  clearBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0,
+      nullptr);
+
+  if (drawCount > 0) {
+    pipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &descriptorSets[index], 0,
+                            nullptr);
+
+    PushConstants push{drawCount, static_cast<uint32_t>(phase)};
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &push);
+
+    vkCmdDispatch(commandBuffer,
+                  (drawCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+  }
+
+  VkMemoryBarrier cullBarrier = {};
+  cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &cullBarrier,
+                       0, nullptr, 0, nullptr);
+}
+
+void GpuCuller::buildDepthPyramid(VkCommandBuffer commandBuffer,
+                                  int frameIndex, VkImage depthImage,
+                                  VkImageView depthImageView) {
+  depthPyramid->build(commandBuffer, frameIndex, depthImage, depthImageView);
+}
+
+} // namespace engine
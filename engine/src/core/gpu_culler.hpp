@@ -0,0 +1,89 @@
+#pragma once
+#include "buffer.hpp"
+#include "descriptors.hpp"
+#include "device.hpp"
+#include "frustum.hpp"
+#include "hiz_pyramid.hpp"
+#include "pipeline.hpp"
+#include <cstdint>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float2.hpp>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// Culls the dense draw list on the GPU in two phases. The early phase draws
+// whatever survived last frame, its depth is reduced into a Hi-Z pyramid and
+// the late phase tests every draw against that pyramid, drawing only what
+// the early phase missed. Surviving commands are compacted into a per frame
+// buffer together with a draw count for vkCmdDrawIndexedIndirectCount.
+class GpuCuller {
+public:
+  enum Phase { Early, Late, PhaseCount };
+
+  GpuCuller(Device &device, uint32_t maxDrawCount,
+            const std::vector<std::shared_ptr<Buffer>> &drawCallBuffers,
+            Buffer &boundsBuffer,
+            VkExtent2D depthExtent);
+  ~GpuCuller();
+
+  GpuCuller(const GpuCuller &) = delete;
+  GpuCuller &operator=(const GpuCuller &) = delete;
+
+  // Recreates the depth pyramid when the swap chain was resized
+  void beginFrame(int frameIndex, const glm::mat4 &projectionView,
+                  VkExtent2D depthExtent);
+  // Both have to be recorded outside of a render pass
+  void cull(VkCommandBuffer commandBuffer, int frameIndex, uint32_t drawCount,
+            Phase phase);
+  void buildDepthPyramid(VkCommandBuffer commandBuffer, int frameIndex,
+                         VkImage depthImage, VkImageView depthImageView);
+
+  std::shared_ptr<Buffer> getDrawCallBuffer(int frameIndex, Phase phase) {
+    return culledDrawCallBuffers[bufferIndex(frameIndex, phase)];
+  }
+  std::shared_ptr<Buffer> getDrawCountBuffer(int frameIndex, Phase phase) {
+    return drawCountBuffers[bufferIndex(frameIndex, phase)];
+  }
+
+private:
+  struct CullData {
+    glm::mat4 projectionView;
+    glm::vec4 planes[6];
+    glm::vec2 pyramidSize;
+    uint32_t pyramidLevelCount;
+  };
+
+  struct PushConstants {
+    uint32_t drawCount;
+    uint32_t phase;
+  };
+
+  static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+  Device &device;
+
+  std::unique_ptr<HiZPyramid> depthPyramid;
+
+  std::unique_ptr<DescriptorSetLayout> descriptorSetLayout;
+  std::unique_ptr<DescriptorPool> descriptorPool;
+  std::vector<VkDescriptorSet> descriptorSets;
+  VkPipelineLayout pipelineLayout;
+  std::unique_ptr<ComputePipeline> pipeline;
+
+  std::unique_ptr<Buffer> visibilityBuffer;
+  std::vector<std::unique_ptr<Buffer>> cullDataBuffers;
+  std::vector<std::shared_ptr<Buffer>> culledDrawCallBuffers;
+  std::vector<std::shared_ptr<Buffer>> drawCountBuffers;
+
+  void createPipelineLayout();
+  void clearVisibility();
+  void writeDepthPyramidDescriptors();
+  static size_t bufferIndex(int frameIndex, Phase phase) {
+    return frameIndex * PhaseCount + phase;
+  }
+};
+
+} // namespace engine
@@ -0,0 +1,181 @@
+#include "gpu_profiler.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+GpuProfiler::GpuProfiler(Device &device, uint32_t frameCount)
+    : device{device}, frames(frameCount) {
+  uint32_t validBits = device.getTimestampValidBits();
+  timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+  timestampPeriod = device.getTimestampPeriod();
+  if (validBits == 0)
+    return;
+
+  VkQueryPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = frameCount * MAX_SCOPES * 2;
+
+  if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &queryPool) !=
+      VK_SUCCESS)
+    throw runtime_error("Failed to create timestamp query pool!");
+
+  // Queries start out undefined, every frame resets its range before use
+  lastLog = chrono::steady_clock::now();
+}
+
+GpuProfiler::~GpuProfiler() {
+  if (isSupported())
+    vkDestroyQueryPool(device.device(), queryPool, nullptr);
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer,
+                             uint32_t frameIndex) {
+  if (!isSupported())
+    return;
+
+  currentFrame = frameIndex;
+  collect(frameIndex);
+  vkCmdResetQueryPool(commandBuffer, queryPool,
+                      frameIndex * MAX_SCOPES * 2, MAX_SCOPES * 2);
+
+  if (logInterval.count() > 0 &&
+      chrono::steady_clock::now() - lastLog >= logInterval) {
+    lastLog = chrono::steady_clock::now();
+    log();
+  }
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char *name) {
+  if (!isSupported())
+    return;
+
+  FrameQueries &frame = frames[currentFrame];
+  // Scopes past the limit are dropped rather than overrunning the range
+  if (frame.queryCount + 2 > MAX_SCOPES * 2) {
+    frame.openScopes.push_back(UINT32_MAX);
+    return;
+  }
+
+  uint32_t query = currentFrame * MAX_SCOPES * 2 + frame.queryCount;
+  frame.queryCount += 2;
+  frame.openScopes.push_back(static_cast<uint32_t>(frame.scopes.size()));
+  frame.scopes.push_back({name, query});
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      queryPool, query);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer) {
+  if (!isSupported())
+    return;
+
+  FrameQueries &frame = frames[currentFrame];
+  assert(!frame.openScopes.empty() && "No GPU scope is open!");
+  uint32_t scope = frame.openScopes.back();
+  frame.openScopes.pop_back();
+  if (scope == UINT32_MAX)
+    return;
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      queryPool, frame.scopes[scope].query + 1);
+}
+
+void GpuProfiler::addSample(const string &name, double milliseconds) {
+  History &history = histories[name];
+  if (history.samples.size() < HISTORY_SIZE) {
+    history.samples.push_back(milliseconds);
+    return;
+  }
+  history.samples[history.next] = milliseconds;
+  history.next = (history.next + 1) % HISTORY_SIZE;
+}
+
+double GpuProfiler::toMilliseconds(uint64_t begin, uint64_t end) const {
+  uint64_t ticks = (end - begin) & timestampMask;
+  return static_cast<double>(ticks) * timestampPeriod / 1e6;
+}
+
+bool GpuProfiler::getStats(const string &name, Stats &stats) const {
+  auto history = histories.find(name);
+  if (history == histories.end() || history->second.samples.empty())
+    return false;
+
+  vector<double> sorted = history->second.samples;
+  sort(sorted.begin(), sorted.end());
+
+  double sum = 0.0;
+  for (double sample : sorted)
+    sum += sample;
+
+  stats.sampleCount = sorted.size();
+  stats.average = sum / sorted.size();
+  stats.median = sorted[sorted.size() / 2];
+  stats.p95 = sorted[min(sorted.size() - 1, sorted.size() * 95 / 100)];
+  stats.max = sorted.back();
+  return true;
+}
+
+vector<string> GpuProfiler::getScopeNames() const {
+  vector<string> names;
+  for (const auto &[name, history] : histories)
+    names.push_back(name);
+  return names;
+}
+
+// The frame's fence was waited for before its command buffer is reused, so
+// every scope that was closed has its results
+void GpuProfiler::collect(uint32_t frameIndex) {
+  FrameQueries &frame = frames[frameIndex];
+  if (frame.queryCount > 0) {
+    // Value and availability per query
+    vector<uint64_t> results(frame.queryCount * 2);
+    vkGetQueryPoolResults(
+        device.device(), queryPool, frameIndex * MAX_SCOPES * 2,
+        frame.queryCount, results.size() * sizeof(uint64_t), results.data(),
+        2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    // Scopes sharing a name, like both culling passes, add up to one sample
+    map<string, double> frameTimes;
+    for (const Scope &scope : frame.scopes) {
+      size_t index = (scope.query - frameIndex * MAX_SCOPES * 2) * 2;
+      if (results[index + 1] == 0 || results[index + 3] == 0)
+        continue;
+      frameTimes[scope.name] +=
+          toMilliseconds(results[index], results[index + 2]);
+    }
+    for (const auto &[name, milliseconds] : frameTimes)
+      addSample(name, milliseconds);
+  }
+
+  assert(frame.openScopes.empty() && "GPU scope was left open!");
+  frame.scopes.clear();
+  frame.openScopes.clear();
+  frame.queryCount = 0;
+}
+
+void GpuProfiler::log() {
+  for (const auto &[name, history] : histories) {
+    Stats stats;
+    if (!getStats(name, stats))
+      continue;
+    cout << fixed << setprecision(3) << "GPU " << name << ": avg "
+         << stats.average << "ms, p50 " << stats.median << "ms, p95 "
+         << stats.p95 << "ms, max " << stats.max << "ms" << endl;
+  }
+}
+
+} // namespace engine
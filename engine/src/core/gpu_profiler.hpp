@@ -0,0 +1,91 @@
+#pragma once
+#include "device.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// Brackets named scopes of a frame's command buffer with timestamps. Every
+// frame in flight has its own range of queries, which beginFrame() reads
+// once the frame's fence was waited for, so reading never stalls.
+class GpuProfiler {
+public:
+  static constexpr uint32_t MAX_SCOPES = 16;
+  // Samples per scope the statistics are computed over
+  static constexpr size_t HISTORY_SIZE = 240;
+
+  struct Stats {
+    double average;
+    double median;
+    double p95;
+    double max;
+    size_t sampleCount;
+  };
+
+  GpuProfiler(Device &device, uint32_t frameCount);
+  ~GpuProfiler();
+
+  GpuProfiler(const GpuProfiler &) = delete;
+  GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+  // Without timestamp support every call is a no-op
+  bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+
+  // Collects what this frame index recorded last time and resets its queries
+  void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+  // Scopes nest, each end closes the innermost open one
+  void beginScope(VkCommandBuffer commandBuffer, const char *name);
+  void endScope(VkCommandBuffer commandBuffer);
+
+  // For GPU work outside the frame's command buffer that is timed elsewhere
+  void addSample(const std::string &name, double milliseconds);
+  double toMilliseconds(uint64_t begin, uint64_t end) const;
+
+  // In milliseconds, false if the scope has no samples yet
+  bool getStats(const std::string &name, Stats &stats) const;
+  std::vector<std::string> getScopeNames() const;
+
+  // Prints every scope at most once per interval, zero disables the log
+  void setLogInterval(std::chrono::milliseconds interval) {
+    logInterval = interval;
+  }
+
+private:
+  struct Scope {
+    const char *name;
+    uint32_t query;
+  };
+
+  struct FrameQueries {
+    std::vector<Scope> scopes;
+    std::vector<uint32_t> openScopes;
+    uint32_t queryCount = 0;
+  };
+
+  struct History {
+    std::vector<double> samples;
+    size_t next = 0;
+  };
+
+  Device &device;
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  uint64_t timestampMask;
+  double timestampPeriod;
+
+  std::vector<FrameQueries> frames;
+  uint32_t currentFrame = 0;
+  std::map<std::string, History> histories;
+
+  std::chrono::milliseconds logInterval{0};
+  std::chrono::steady_clock::time_point lastLog;
+
+  void collect(uint32_t frameIndex);
+  void log();
+};
+
+} // namespace engine
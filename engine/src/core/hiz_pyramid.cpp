@@ -0,0 +1,273 @@
+#include "hiz_pyramid.hpp"
+#include "swapchain.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+HiZPyramid::HiZPyramid(Device &device, VkExtent2D depthExtent)
+    : device{device}, depthExtent{depthExtent} {
+  extent = {max(depthExtent.width / 2, 1u), max(depthExtent.height / 2, 1u)};
+
+  levelCount = 1;
+  while (max(extent.width, extent.height) >> levelCount > 0)
+    levelCount++;
+
+  createImage();
+  createSampler();
+  createDescriptorSets();
+  createPipelineLayout();
+  pipeline = make_unique<ComputePipeline>(
+      device, "src/shaders/hiz_build.comp.spv", pipelineLayout);
+}
+
+HiZPyramid::~HiZPyramid() {
+  vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+  vkDestroySampler(device.device(), sampler, nullptr);
+  for (VkImageView levelView : levelViews)
+    vkDestroyImageView(device.device(), levelView, nullptr);
+  vkDestroyImageView(device.device(), imageView, nullptr);
+  vkDestroyImage(device.device(), image, nullptr);
+  device.freeMemory(imageMemory);
+}
+
+VkExtent2D HiZPyramid::getLevelExtent(uint32_t level) const {
+  return {max(extent.width >> level, 1u), max(extent.height >> level, 1u)};
+}
+
+void HiZPyramid::createImage() {
+  VkImageCreateInfo imageInfo = {};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = extent.width;
+  imageInfo.extent.height = extent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = levelCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             image, imageMemory);
+
+  VkImageViewCreateInfo viewInfo = {};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R32_SFLOAT;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = levelCount;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device.device(), &viewInfo, nullptr, &imageView) !=
+      VK_SUCCESS)
+    throw runtime_error("Failed to create depth pyramid image view!");
+
+  levelViews.resize(levelCount);
+  for (uint32_t level = 0; level < levelCount; level++) {
+    viewInfo.subresourceRange.baseMipLevel = level;
+    viewInfo.subresourceRange.levelCount = 1;
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr,
+                          &levelViews[level]) != VK_SUCCESS)
+      throw runtime_error("Failed to create depth pyramid image view!");
+  }
+
+  // The pyramid stays in GENERAL, it is written as a storage image and read
+  // with texelFetch
+  VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = levelCount;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  device.endSingleTimeCommands(commandBuffer);
+}
+
+void HiZPyramid::createSampler() {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 1.0f;
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = static_cast<float>(levelCount);
+
+  if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) !=
+      VK_SUCCESS)
+    throw runtime_error("Failed to create depth pyramid sampler!");
+}
+
+void HiZPyramid::createDescriptorSets() {
+  descriptorSetLayout =
+      DescriptorSetLayout::Builder(device)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .build();
+
+  uint32_t setCount = SwapChain::MAX_FRAMES_IN_FLIGHT + levelCount - 1;
+  descriptorPool =
+      DescriptorPool::Builder(device)
+          .setMaxSets(setCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount)
+          .build();
+
+  // The depth image view is filled in by build
+  depthDescriptorSets.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (VkDescriptorSet &depthDescriptorSet : depthDescriptorSets)
+    if (!descriptorPool->allocateDescriptor(
+            descriptorSetLayout->getDescriptorSetLayout(), depthDescriptorSet))
+      throw runtime_error("Failed to allocate depth pyramid descriptor set!");
+
+  levelDescriptorSets.resize(levelCount - 1);
+  for (uint32_t level = 1; level < levelCount; level++) {
+    VkDescriptorImageInfo srcInfo{sampler, levelViews[level - 1],
+                                  VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo dstInfo{VK_NULL_HANDLE, levelViews[level],
+                                  VK_IMAGE_LAYOUT_GENERAL};
+    if (!DescriptorWriter(*descriptorSetLayout, *descriptorPool)
+             .writeImage(0, &srcInfo)
+             .writeImage(1, &dstInfo)
+             .build(levelDescriptorSets[level - 1]))
+      throw runtime_error("Failed to allocate depth pyramid descriptor set!");
+  }
+}
+
+void HiZPyramid::createPipelineLayout() {
+  VkDescriptorSetLayout setLayout =
+      descriptorSetLayout->getDescriptorSetLayout();
+
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(PushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS)
+    throw runtime_error("Failed to create depth pyramid pipeline layout!");
+}
+
+VkDescriptorImageInfo HiZPyramid::descriptorInfo() {
+  return VkDescriptorImageInfo{sampler, imageView, VK_IMAGE_LAYOUT_GENERAL};
+}
+
+void HiZPyramid::build(VkCommandBuffer commandBuffer, int frameIndex,
+                       VkImage depthImage, VkImageView depthImageView) {
+  VkDescriptorImageInfo depthInfo{
+      sampler, depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  VkDescriptorImageInfo dstInfo{VK_NULL_HANDLE, levelViews[0],
+                                VK_IMAGE_LAYOUT_GENERAL};
+  DescriptorWriter(*descriptorSetLayout, *descriptorPool)
+      .writeImage(0, &depthInfo)
+      .writeImage(1, &dstInfo)
+      .overwrite(depthDescriptorSets[frameIndex]);
+
+  VkImageMemoryBarrier depthBarrier = {};
+  depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  depthBarrier.image = depthImage;
+  depthBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  depthBarrier.subresourceRange.baseMipLevel = 0;
+  depthBarrier.subresourceRange.levelCount = 1;
+  depthBarrier.subresourceRange.baseArrayLayer = 0;
+  depthBarrier.subresourceRange.layerCount = 1;
+  depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  // The pyramid was last read by the culling pass of an earlier frame
+  VkMemoryBarrier pyramidBarrier = {};
+  pyramidBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  pyramidBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &pyramidBarrier, 0, nullptr, 1, &depthBarrier);
+
+  pipeline->bind(commandBuffer);
+
+  VkExtent2D srcExtent = depthExtent;
+  for (uint32_t level = 0; level < levelCount; level++) {
+    VkDescriptorSet descriptorSet = level == 0
+                                        ? depthDescriptorSets[frameIndex]
+                                        : levelDescriptorSets[level - 1];
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+    VkExtent2D dstExtent = getLevelExtent(level);
+    PushConstants push{{srcExtent.width, srcExtent.height},
+                       {dstExtent.width, dstExtent.height}};
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+                       &push);
+
+    vkCmdDispatch(commandBuffer,
+                  (dstExtent.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                  (dstExtent.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+    VkMemoryBarrier levelBarrier = {};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &levelBarrier, 0, nullptr, 0, nullptr);
+
+    srcExtent = dstExtent;
+  }
+}
+
+} // namespace engine
@@ -0,0 +1,70 @@
+#pragma once
+#include "descriptors.hpp"
+#include "device.hpp"
+#include "memory_allocator.hpp"
+#include "pipeline.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// Mip chain of the scene depth where every texel holds the furthest depth
+// of the texels below it. Level 0 is half the depth resolution and the last
+// level is 1x1, so any screen rectangle is covered by at most 2x2 texels of
+// a single level.
+class HiZPyramid {
+public:
+  HiZPyramid(Device &device, VkExtent2D depthExtent);
+  ~HiZPyramid();
+
+  HiZPyramid(const HiZPyramid &) = delete;
+  HiZPyramid &operator=(const HiZPyramid &) = delete;
+
+  // Expects the depth image in DEPTH_STENCIL_ATTACHMENT_OPTIMAL and leaves it
+  // in DEPTH_STENCIL_READ_ONLY_OPTIMAL
+  void build(VkCommandBuffer commandBuffer, int frameIndex, VkImage depthImage,
+             VkImageView depthImageView);
+
+  VkDescriptorImageInfo descriptorInfo();
+  VkExtent2D getDepthExtent() const { return depthExtent; }
+  VkExtent2D getExtent() const { return extent; }
+  uint32_t getLevelCount() const { return levelCount; }
+
+private:
+  struct PushConstants {
+    uint32_t srcSize[2];
+    uint32_t dstSize[2];
+  };
+
+  static constexpr uint32_t WORKGROUP_SIZE = 16;
+
+  Device &device;
+  VkExtent2D depthExtent;
+  VkExtent2D extent;
+  uint32_t levelCount;
+
+  VkImage image;
+  MemoryAllocation imageMemory;
+  VkImageView imageView;
+  std::vector<VkImageView> levelViews;
+  VkSampler sampler;
+
+  std::unique_ptr<DescriptorSetLayout> descriptorSetLayout;
+  std::unique_ptr<DescriptorPool> descriptorPool;
+  // Level 0 reads the depth image of whichever swap chain image is drawn to,
+  // so every frame in flight gets its own set
+  std::vector<VkDescriptorSet> depthDescriptorSets;
+  std::vector<VkDescriptorSet> levelDescriptorSets;
+  VkPipelineLayout pipelineLayout;
+  std::unique_ptr<ComputePipeline> pipeline;
+
+  void createImage();
+  void createSampler();
+  void createDescriptorSets();
+  void createPipelineLayout();
+  VkExtent2D getLevelExtent(uint32_t level) const;
+};
+
+} // namespace engine
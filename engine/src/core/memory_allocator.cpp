@@ -0,0 +1,264 @@
+#include "memory_allocator.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice,
+                                 VkDevice device, bool memoryBudgetSupported)
+    : physicalDevice{physicalDevice}, device{device},
+      memoryBudgetSupported{memoryBudgetSupported} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+}
+
+MemoryAllocator::~MemoryAllocator() {
+  for (uint32_t i = 0; i < blocks.size(); i++) {
+    if (blocks[i])
+      destroyBlock(i);
+  }
+}
+
+MemoryAllocation
+MemoryAllocator::allocate(const VkMemoryRequirements &requirements,
+                          VkMemoryPropertyFlags properties, bool linear) {
+  MemoryAllocation allocation{};
+  allocation.memoryType =
+      findMemoryType(requirements.memoryTypeBits, properties);
+
+  VkDeviceSize size = requirements.size;
+  VkDeviceSize alignment = requirements.alignment;
+  if (isNonCoherent(allocation.memoryType)) {
+    // Keep flush ranges inside the allocation
+    alignment = max(alignment, nonCoherentAtomSize);
+    size = (size + nonCoherentAtomSize - 1) / nonCoherentAtomSize *
+           nonCoherentAtomSize;
+  }
+
+  lock_guard<mutex> lock(allocationMutex);
+
+  VkDeviceSize blockSize = getBlockSize(allocation.memoryType);
+  if (size >= blockSize / 2) {
+    allocation.memory = allocateDeviceMemory(size, allocation.memoryType,
+                                             &allocation.mappedData);
+    allocation.size = size;
+    dedicatedCount++;
+    return allocation;
+  }
+
+  for (uint32_t i = 0; i < blocks.size(); i++) {
+    Block *block = blocks[i].get();
+    if (block && block->memoryType == allocation.memoryType &&
+        block->linear == linear &&
+        block->allocator.allocate(size, allocation.range, alignment)) {
+      allocation.block = i;
+      break;
+    }
+  }
+
+  if (allocation.block == MemoryAllocation::DEDICATED) {
+    allocation.block = createBlock(allocation.memoryType, linear);
+    if (!blocks[allocation.block]->allocator.allocate(size, allocation.range,
+                                                      alignment))
+      throw runtime_error("Failed to sub-allocate device memory!");
+  }
+
+  Block &block = *blocks[allocation.block];
+  allocation.memory = block.memory;
+  allocation.offset = allocation.range.offset;
+  allocation.size = allocation.range.size;
+  if (block.mappedData)
+    allocation.mappedData =
+        static_cast<char *>(block.mappedData) + allocation.offset;
+  return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation &allocation) {
+  if (!allocation.isValid())
+    return;
+
+  lock_guard<mutex> lock(allocationMutex);
+
+  if (allocation.isDedicated()) {
+    freeDeviceMemory(allocation.memory, allocation.size,
+                     allocation.memoryType);
+    dedicatedCount--;
+    allocation = {};
+    return;
+  }
+
+  Block &block = *blocks[allocation.block];
+  block.allocator.free(allocation.range);
+
+  // Keep one empty block around per kind so resources that are recreated
+  // over and over (e.g. depth images on resize) don't hit the driver
+  if (block.allocator.isEmpty()) {
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+      if (i != allocation.block && blocks[i] &&
+          blocks[i]->memoryType == block.memoryType &&
+          blocks[i]->linear == block.linear) {
+        destroyBlock(allocation.block);
+        break;
+      }
+    }
+  }
+
+  allocation = {};
+}
+
+void MemoryAllocator::flush(const MemoryAllocation &allocation,
+                            VkDeviceSize size, VkDeviceSize offset) {
+  if (!allocation.isValid() || !isNonCoherent(allocation.memoryType))
+    return;
+
+  if (size == VK_WHOLE_SIZE || offset + size > allocation.size)
+    size = allocation.size - offset;
+
+  // Allocations of non coherent memory are atom aligned, so rounding the
+  // range outwards never leaves the allocation
+  VkDeviceSize begin = offset / nonCoherentAtomSize * nonCoherentAtomSize;
+  VkDeviceSize end = (offset + size + nonCoherentAtomSize - 1) /
+                     nonCoherentAtomSize * nonCoherentAtomSize;
+
+  VkMappedMemoryRange mappedRange = {};
+  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  mappedRange.memory = allocation.memory;
+  mappedRange.offset = allocation.offset + begin;
+  mappedRange.size = min(end, allocation.size) - begin;
+  vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+}
+
+uint32_t MemoryAllocator::findMemoryType(
+    uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+            properties)
+      return i;
+  }
+
+  throw runtime_error("Failed to find suitable memory type!");
+}
+
+uint32_t MemoryAllocator::getDeviceMemoryCount() const {
+  uint32_t count = dedicatedCount;
+  for (const auto &block : blocks) {
+    if (block)
+      count++;
+  }
+  return count;
+}
+
+vector<HeapBudget> MemoryAllocator::getHeapBudgets() {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+  budgetProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  if (memoryBudgetSupported) {
+    VkPhysicalDeviceMemoryProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+  }
+
+  lock_guard<mutex> lock(allocationMutex);
+
+  vector<HeapBudget> heapBudgets(memoryProperties.memoryHeapCount);
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    HeapBudget &heapBudget = heapBudgets[i];
+    heapBudget.size = memoryProperties.memoryHeaps[i].size;
+    heapBudget.allocated = heapAllocated[i];
+    heapBudget.deviceLocal = memoryProperties.memoryHeaps[i].flags &
+                             VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+    // Some drivers report a zero budget for heaps they don't track
+    if (memoryBudgetSupported && budgetProperties.heapBudget[i] != 0) {
+      heapBudget.budget = budgetProperties.heapBudget[i];
+      heapBudget.usage = budgetProperties.heapUsage[i];
+    } else {
+      heapBudget.budget = heapBudget.size / 100 * FALLBACK_BUDGET_PERCENT;
+      heapBudget.usage = heapAllocated[i];
+    }
+  }
+  return heapBudgets;
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType) const {
+  // Small heaps (e.g. the 256MB BAR window) get smaller blocks so one block
+  // can't take a large share of the heap
+  uint32_t heap = memoryProperties.memoryTypes[memoryType].heapIndex;
+  VkDeviceSize heapSize = memoryProperties.memoryHeaps[heap].size;
+  return min(BLOCK_SIZE, heapSize / 8);
+}
+
+bool MemoryAllocator::isNonCoherent(uint32_t memoryType) const {
+  VkMemoryPropertyFlags flags =
+      memoryProperties.memoryTypes[memoryType].propertyFlags;
+  return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+         !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size,
+                                                     uint32_t memoryType,
+                                                     void **mappedData) {
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    throw runtime_error("Failed to allocate device memory!");
+  heapAllocated[memoryProperties.memoryTypes[memoryType].heapIndex] += size;
+
+  *mappedData = nullptr;
+  if (memoryProperties.memoryTypes[memoryType].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) !=
+        VK_SUCCESS)
+      throw runtime_error("Failed to map device memory!");
+  }
+
+  return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size,
+                                       uint32_t memoryType) {
+  vkFreeMemory(device, memory, nullptr);
+  heapAllocated[memoryProperties.memoryTypes[memoryType].heapIndex] -= size;
+}
+
+uint32_t MemoryAllocator::createBlock(uint32_t memoryType, bool linear) {
+  VkDeviceSize size = getBlockSize(memoryType);
+
+  auto block = make_unique<Block>(size);
+  block->memoryType = memoryType;
+  block->linear = linear;
+  block->memory = allocateDeviceMemory(size, memoryType, &block->mappedData);
+
+  for (uint32_t i = 0; i < blocks.size(); i++) {
+    if (!blocks[i]) {
+      blocks[i] = std::move(block);
+      return i;
+    }
+  }
+
+  blocks.push_back(std::move(block));
+  return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void MemoryAllocator::destroyBlock(uint32_t block) {
+  freeDeviceMemory(blocks[block]->memory, blocks[block]->size,
+                   blocks[block]->memoryType);
+  blocks[block].reset();
+}
+
+} // namespace engine
@@ -0,0 +1,106 @@
+#pragma once
+#include "tlsf_allocator.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+struct MemoryAllocation {
+  static constexpr uint32_t DEDICATED = UINT32_MAX;
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void *mappedData = nullptr;
+  uint32_t memoryType = 0;
+  uint32_t block = DEDICATED;
+  TlsfAllocator::Allocation range;
+
+  bool isValid() const { return memory != VK_NULL_HANDLE; }
+  bool isDedicated() const { return block == DEDICATED; }
+};
+
+struct HeapBudget {
+  VkDeviceSize size = 0;
+  // How much this process should use before the driver has to page
+  VkDeviceSize budget = 0;
+  // Of the whole process with VK_EXT_memory_budget, else only ours
+  VkDeviceSize usage = 0;
+  // Bytes in VkDeviceMemory allocated through this allocator
+  VkDeviceSize allocated = 0;
+  bool deviceLocal = false;
+};
+
+// Reserves large VkDeviceMemory blocks per memory type and sub-allocates
+// buffers and images from them. Linear (buffer) and optimal (image)
+// resources never share a block, so bufferImageGranularity can be ignored.
+// Host visible blocks stay mapped for their whole lifetime.
+class MemoryAllocator {
+public:
+  static constexpr VkDeviceSize BLOCK_SIZE = 64 * 1024 * 1024;
+  // Share of a heap assumed available without VK_EXT_memory_budget
+  static constexpr VkDeviceSize FALLBACK_BUDGET_PERCENT = 80;
+
+  MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device,
+                  bool memoryBudgetSupported);
+  ~MemoryAllocator();
+
+  MemoryAllocator(const MemoryAllocator &) = delete;
+  MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+  MemoryAllocation allocate(const VkMemoryRequirements &requirements,
+                            VkMemoryPropertyFlags properties, bool linear);
+  void free(MemoryAllocation &allocation);
+  void flush(const MemoryAllocation &allocation,
+             VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+  uint32_t findMemoryType(uint32_t typeFilter,
+                          VkMemoryPropertyFlags properties) const;
+  const VkPhysicalDeviceMemoryProperties &getMemoryProperties() const {
+    return memoryProperties;
+  }
+  uint32_t getDeviceMemoryCount() const;
+  // One entry per memory heap, queried from the driver on every call when
+  // the budget extension is enabled
+  std::vector<HeapBudget> getHeapBudgets();
+  bool supportsMemoryBudget() const { return memoryBudgetSupported; }
+
+private:
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size;
+    TlsfAllocator allocator;
+    void *mappedData = nullptr;
+    uint32_t memoryType = 0;
+    bool linear = true;
+
+    Block(VkDeviceSize size) : size{size}, allocator{size} {}
+  };
+
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  bool memoryBudgetSupported;
+  VkDeviceSize nonCoherentAtomSize;
+
+  std::vector<std::unique_ptr<Block>> blocks;
+  uint32_t dedicatedCount = 0;
+  std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapAllocated{};
+  std::mutex allocationMutex;
+
+  VkDeviceSize getBlockSize(uint32_t memoryType) const;
+  bool isNonCoherent(uint32_t memoryType) const;
+  VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType,
+                                      void **mappedData);
+  void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size,
+                        uint32_t memoryType);
+  uint32_t createBlock(uint32_t memoryType, bool linear);
+  void destroyBlock(uint32_t block);
+};
+
+} // namespace engine
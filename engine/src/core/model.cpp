@@ -20,9 +20,6 @@ using namespace std;
 
 namespace engine {
 
-const int MAX_VERTEX_COUNT = 10000000;
-const int MAX_INDEX_COUNT = 10000000;
-
 std::vector<VkVertexInputBindingDescription>
 Model::Vertex::getBindingDescriptions() {
   std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
@@ -43,6 +40,8 @@ Model::Vertex::getAttributeDescriptions() {
       {2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
   attributeDescriptions.push_back(
       {3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, texCoord)});
+  attributeDescriptions.push_back(
+      {4, 0, VK_FORMAT_R32_UINT, offsetof(Vertex, textureLayer)});
 
   return attributeDescriptions;
 }
@@ -157,24 +156,26 @@ std::unique_ptr<Model> Model::loadFromMeshes(
 Model::Model(Device &device) : device{device} {
   cout << "Creating model with default constructor" << endl;
   createRingBuffer(MAX_VERTEX_COUNT, MAX_INDEX_COUNT);
-  createStagingBuffers(MAX_VERTEX_COUNT, MAX_INDEX_COUNT);
 }
 
 Model::Model(Device &device, const Model::Builder &builder) : device{device} {
-  createVertexBuffer(builder.vertices);
-  createIndexBuffer(builder.indices);
+  UploadBatch uploadBatch{device};
+  createVertexBuffer(builder.vertices, uploadBatch);
+  createIndexBuffer(builder.indices, uploadBatch);
 }
 
 Model::Model(Device &device, const std::vector<Vertex> &vertices)
     : device{device} {
-  createVertexBuffer(vertices);
+  UploadBatch uploadBatch{device};
+  createVertexBuffer(vertices, uploadBatch);
 }
 
 Model::Model(Device &device, const std::vector<Vertex> &vertices,
              const std::vector<uint32_t> &indices)
     : device{device} {
-  createVertexBuffer(vertices);
-  createIndexBuffer(indices);
+  UploadBatch uploadBatch{device};
+  createVertexBuffer(vertices, uploadBatch);
+  createIndexBuffer(indices, uploadBatch);
 }
 
 void Model::createRingBuffer(uint32_t vertexCount, uint32_t indexCount) {
@@ -184,7 +185,7 @@ void Model::createRingBuffer(uint32_t vertexCount, uint32_t indexCount) {
       device, instanceSize, SwapChain::MAX_FRAMES_IN_FLIGHT,
       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VK_SHARING_MODE_CONCURRENT);
 
   hasIndexBuffer = indexCount > 0;
 }
@@ -200,28 +201,21 @@ void Model::createVertexBuffer(uint32_t vertexCount) {
   }
 }
 
-void Model::createVertexBuffer(const std::vector<Vertex> &vertices) {
+void Model::createVertexBuffer(const std::vector<Vertex> &vertices,
+                               UploadBatch &uploadBatch) {
   vertexCount = vertices.size();
   assert(vertexCount >= 3 && "Vertex count must be at least 3!");
 
   uint32_t vertexSize = sizeof(vertices[0]);
   VkDeviceSize bufferSize = vertexSize * vertexCount;
 
-  Buffer stagingBuffer{device, vertexSize, vertexCount,
-                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)vertices.data());
-
-  vertexBuffers[0] = std::make_unique<Buffer>(
+  vertexBuffers = {std::make_shared<Buffer>(
       device, vertexSize, vertexCount,
       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
 
-  device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffers[0]->getBuffer(),
-                    bufferSize);
+  uploadBatch.copyToBuffer(vertices.data(), bufferSize,
+                           vertexBuffers[0]->getBuffer());
 }
 
 Model::~Model() {}
@@ -242,7 +236,8 @@ void Model::createIndexBuffer(uint32_t indexCount) {
     indexBuffers.push_back(indexBuffer);
   }
 }
-void Model::createIndexBuffer(const std::vector<uint32_t> &indices) {
+void Model::createIndexBuffer(const std::vector<uint32_t> &indices,
+                              UploadBatch &uploadBatch) {
   indexCount = static_cast<uint32_t>(indices.size());
   hasIndexBuffer = indexCount > 0;
 
@@ -252,47 +247,13 @@ void Model::createIndexBuffer(const std::vector<uint32_t> &indices) {
   uint32_t indexSize = sizeof(indices[0]);
   VkDeviceSize bufferSize = indexSize * indexCount;
 
-  Buffer stagingBuffer{device, indexSize, indexCount,
-                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)indices.data());
-
-  indexBuffers[0] = std::make_unique<Buffer>(
+  indexBuffers = {std::make_shared<Buffer>(
       device, indexSize, indexCount,
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  device.copyBuffer(stagingBuffer.getBuffer(), indexBuffers[0]->getBuffer(),
-                    bufferSize);
-}
-
-void Model::createStagingBuffers(uint32_t vertexCount, uint32_t indexCount) {
-  uint32_t vertexSize = sizeof(Model::Vertex);
-  uint32_t indexSize = sizeof(uint32_t);
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
 
-  size_t vertexBufferSize = vertexSize * vertexCount + indexSize * indexCount;
-  stagingBuffer = std::make_shared<Buffer>(
-      device, vertexBufferSize, SwapChain::MAX_FRAMES_IN_FLIGHT,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-  stagingBuffer->map();
-}
-
-void Model::writeMeshDataToBuffer(
-    const std::pair<std::vector<Vertex>, std::vector<uint32_t>> &mesh,
-    uint32_t vertexBufferOffset, uint32_t indexBufferOffset) {
-  size_t vertexDataSize = mesh.first.size() * sizeof(Vertex);
-  size_t indexDataSize = mesh.second.size() * sizeof(uint32_t);
-
-  stagingBuffer->writeToBuffer((void *)mesh.first.data(), vertexDataSize,
-                               vertexBufferOffset);
-  stagingBuffer->writeToBuffer((void *)mesh.second.data(), indexDataSize,
-                               indexBufferOffset +
-                                   MAX_VERTEX_COUNT * sizeof(Vertex));
+  uploadBatch.copyToBuffer(indices.data(), bufferSize,
+                           indexBuffers[0]->getBuffer());
 }
 
 void Model::bind(VkCommandBuffer commandBuffer) {
@@ -301,10 +262,8 @@ void Model::bind(VkCommandBuffer commandBuffer) {
   vkCmdBindVertexBuffers(commandBuffer, 0, 1, vkRingBuffers, offsets);
 
   if (hasIndexBuffer) {
-    uint32_t indexBufferOffset = MAX_VERTEX_COUNT * sizeof(Vertex);
-
     vkCmdBindIndexBuffer(commandBuffer, ringBuffer->getBuffer(),
-                         indexBufferOffset, VK_INDEX_TYPE_UINT32);
+                         INDEX_REGION_OFFSET, VK_INDEX_TYPE_UINT32);
   }
 }
 
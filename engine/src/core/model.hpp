@@ -3,6 +3,7 @@
 #include "buffer.hpp"
 #include "device.hpp"
 #include "swapchain.hpp"
+#include "upload_batch.hpp"
 #include <cstdint>
 #include <glm/ext/vector_float2.hpp>
 #include <glm/ext/vector_float3.hpp>
@@ -15,11 +16,16 @@ namespace engine {
 
 class Model {
 public:
+  static constexpr uint32_t MAX_VERTEX_COUNT = 10000000;
+  static constexpr uint32_t MAX_INDEX_COUNT = 10000000;
+
   struct Vertex {
     glm::vec3 position{0.f, 0.f, 0.f};
     glm::vec3 color{0.f, 0.f, 0.f};
     glm::vec3 normal{0.f, 0.f, 0.f};
     glm::vec2 texCoord{0.f, 0.f};
+    // Layer of the block texture array
+    uint32_t textureLayer = 0;
 
     static std::vector<VkVertexInputBindingDescription>
     getBindingDescriptions();
@@ -27,6 +33,9 @@ public:
     getAttributeDescriptions();
   };
 
+  static constexpr VkDeviceSize INDEX_REGION_OFFSET =
+      MAX_VERTEX_COUNT * sizeof(Vertex);
+
   struct TexCoord {
     constexpr static glm::vec2 first = glm::vec2{0.f, 0.f};
     constexpr static glm::vec2 second = glm::vec2{0.f, 1.f};
@@ -57,14 +66,10 @@ public:
   std::vector<std::shared_ptr<Buffer>> indexBuffers;
 
   std::shared_ptr<Buffer> ringBuffer;
-  std::shared_ptr<Buffer> stagingBuffer;
 
   uint32_t vertexCount;
   uint32_t indexCount;
 
-  void writeMeshDataToBuffer(
-      const std::pair<std::vector<Vertex>, std::vector<uint32_t>> &mesh,
-      uint32_t vertexOffset, uint32_t indexOffset);
   void bind(VkCommandBuffer commandBuffer);
   void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1);
 
@@ -82,9 +87,10 @@ private:
 
   void createVertexBuffer(uint32_t size);
   void createIndexBuffer(uint32_t size);
-  void createVertexBuffer(const std::vector<Vertex> &vertices);
-  void createIndexBuffer(const std::vector<uint32_t> &indices);
-  void createStagingBuffers(uint32_t vertexCount, uint32_t indexCount);
+  void createVertexBuffer(const std::vector<Vertex> &vertices,
+                          UploadBatch &uploadBatch);
+  void createIndexBuffer(const std::vector<uint32_t> &indices,
+                         UploadBatch &uploadBatch);
   void createRingBuffer(uint32_t vertexCount, uint32_t indexCount);
 };
 } // namespace engine
@@ -1,5 +1,19 @@
+#pragma once
 #include <glm/ext/matrix_float4x4.hpp>
-struct ObjectData {
-  glm::mat4 modelMatrix{1.f};
-  glm::mat4 normalMatrix{1.f};
+#include <glm/ext/vector_float4.hpp>
+#include <glm/ext/vector_int3.hpp>
+
+#include <cstdint>
+
+// Per draw record of a terrain chunk, read by terrain.vert. Chunks are only
+// translated, so their block aligned origin replaces a full model matrix.
+struct ChunkDrawData {
+  glm::ivec3 origin{0};
+  uint32_t lod = 0;
+};
+
+// World space bounds of a draw, read by the culling pass
+struct DrawBounds {
+  glm::vec4 min{0.f};
+  glm::vec4 max{0.f};
 };
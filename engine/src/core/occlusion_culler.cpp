@@ -1,133 +1,317 @@
 #include "occlusion_culler.hpp"
-#include "../app.hpp"
-#include "camera.hpp"
-#include "game_object.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/common.hpp>
+#include <glm/ext/vector_float2.hpp>
 #include <glm/ext/vector_float4.hpp>
-#include <memory>
-#include <ostream>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace engine {
 
-Octree::Octree() { root = nullptr; }
+namespace {
+
+// Corner i of a box takes max on x, y and z for bits 0, 1 and 2
+constexpr std::array<std::array<int, 2>, 12> BOX_EDGES{{{0, 1},
+                                                        {2, 3},
+                                                        {4, 5},
+                                                        {6, 7},
+                                                        {0, 2},
+                                                        {1, 3},
+                                                        {4, 6},
+                                                        {5, 7},
+                                                        {0, 4},
+                                                        {1, 5},
+                                                        {2, 6},
+                                                        {3, 7}}};
+
+// The corners and one point per box edge cut by the near plane
+constexpr size_t MAX_OUTLINE_POINTS = 20;
 
-Octree::Octree(const BoxCollider boundingBox, int depth) {
-  root = std::make_unique<OctreeNode>(boundingBox, depth);
+glm::vec3 boxCorner(const glm::vec3 &min, const glm::vec3 &max, int corner) {
+  return {corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y,
+          corner & 4 ? max.z : min.z};
 }
 
-void Octree::print() { root->print(this); }
+// Edge function of a -> b in the form A * x + B * y + C, positive on the
+// inner side of a counter clockwise polygon. C is moved in by half a pixel
+// on both axes, so the function is only positive at a pixel's centre if the
+// whole pixel lies on the inner side.
+struct Edge {
+  float a, b, c;
 
-OctreeNode::OctreeNode(const BoxCollider boundingBox, int depth)
-    : boundingBox{boundingBox} {
-  if (depth == 0)
-    return;
+  Edge() = default;
+  Edge(const glm::vec2 &from, const glm::vec2 &to)
+      : a{from.y - to.y}, b{to.x - from.x},
+        c{(to.y - from.y) * from.x - (to.x - from.x) * from.y -
+          0.5f * (std::abs(a) + std::abs(b))} {}
+};
 
-  glm::vec3 min = boundingBox.collisionBox.min;
-  glm::vec3 center = boundingBox.collisionBox.center();
-  glm::vec3 max = boundingBox.collisionBox.max;
+float cross(const glm::vec2 &origin, const glm::vec2 &a, const glm::vec2 &b) {
+  return (a.x - origin.x) * (b.y - origin.y) -
+         (a.y - origin.y) * (b.x - origin.x);
+}
 
-  BoxCollider childBox1 = BoxCollider(min, center);
-  children[0] = std::make_unique<OctreeNode>(childBox1, depth - 1);
+// Monotone chain, writes the hull counter clockwise and returns its size.
+// hull needs room for twice the points.
+size_t convexHull(glm::vec2 *points, size_t count, glm::vec2 *hull) {
+  std::sort(points, points + count,
+            [](const glm::vec2 &a, const glm::vec2 &b) {
+              return a.x < b.x || (a.x == b.x && a.y < b.y);
+            });
 
-  glm::vec3 bottomLeftCenter(min.x, min.y, center.z);
-  glm::vec3 backCenter(center.x, center.y, max.z);
-  BoxCollider childBox2 = BoxCollider(bottomLeftCenter, backCenter);
-  children[1] = std::make_unique<OctreeNode>(childBox2, depth - 1);
+  size_t size = 0;
+  for (size_t i = 0; i < count; i++) {
+    while (size >= 2 && cross(hull[size - 2], hull[size - 1], points[i]) <= 0)
+      size--;
+    hull[size++] = points[i];
+  }
+  for (size_t i = count - 1, lower = size + 1; i-- > 0;) {
+    while (size >= lower &&
+           cross(hull[size - 2], hull[size - 1], points[i]) <= 0)
+      size--;
+    hull[size++] = points[i];
+  }
+  // The last point closes the loop
+  return size - 1;
+}
 
-  glm::vec3 bottomFrontCenter(center.x, min.y, min.z);
-  glm::vec3 rightCenter(max.x, center.y, center.z);
-  BoxCollider childBox3 = BoxCollider(bottomFrontCenter, rightCenter);
-  children[2] = std::make_unique<OctreeNode>(childBox3, depth - 1);
+// Keeps far off screen coordinates of near clipped vertices in int range
+int toPixel(float coordinate, uint32_t size) {
+  return static_cast<int>(
+      std::clamp(coordinate, -1.f, static_cast<float>(size)));
+}
 
-  glm::vec3 bottomCenter(center.x, min.y, center.z);
-  glm::vec3 backRightCenter(max.x, center.y, max.z);
-  BoxCollider childBox4 = BoxCollider(bottomCenter, backRightCenter);
-  children[3] = std::make_unique<OctreeNode>(childBox4, depth - 1);
+void fillRowScalar(float *row, int minX, int maxX, const Edge *edges,
+                   const float *rowEdges, size_t edgeCount, float depth) {
+  for (int x = minX; x <= maxX; x++) {
+    float pixelX = x + 0.5f;
+    bool inside = true;
+    for (size_t i = 0; i < edgeCount && inside; i++)
+      inside = edges[i].a * pixelX + rowEdges[i] >= 0.f;
+    if (inside)
+      row[x] = std::min(row[x], depth);
+  }
+}
 
-  glm::vec3 frontLeftCenter(min.x, center.y, min.z);
-  glm::vec3 topCenter(center.x, max.y, center.z);
-  BoxCollider childBox5 = BoxCollider(frontLeftCenter, topCenter);
-  children[4] = std::make_unique<OctreeNode>(childBox5, depth - 1);
+bool isRowOccludedScalar(const float *row, int minX, int maxX,
+                         float minDepth) {
+  for (int x = minX; x <= maxX; x++)
+    if (row[x] >= minDepth)
+      return false;
+  return true;
+}
 
-  glm::vec3 leftCenter(min.x, center.y, center.z);
-  glm::vec3 topBackCenter(center.x, max.y, max.z);
-  BoxCollider childBox6 = BoxCollider(leftCenter, topBackCenter);
-  children[5] = std::make_unique<OctreeNode>(childBox6, depth - 1);
+#ifdef __SSE2__
+// 4 pixels at a time from an aligned column, the width is a multiple of 4 so
+// a block never leaves its row. Pixels past the outline's bounds fail the
+// edge test like they do in fillRowScalar.
+void fillRow(float *row, int minX, int maxX, const Edge *edges,
+             const float *rowEdges, size_t edgeCount, float depth) {
+  const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 outlineDepth = _mm_set1_ps(depth);
+  for (int x = minX & ~3; x <= maxX; x += 4) {
+    __m128 pixelX =
+        _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
 
-  glm::vec3 frontCenter(center.x, center.y, min.z);
-  glm::vec3 topRightCenter(max.x, max.y, center.z);
-  BoxCollider childBox7 = BoxCollider(frontCenter, topRightCenter);
-  children[6] = std::make_unique<OctreeNode>(childBox7, depth - 1);
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (size_t i = 0; i < edgeCount; i++) {
+      __m128 w = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[i].a), pixelX),
+                            _mm_set1_ps(rowEdges[i]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(w, zero));
+    }
+    if (_mm_movemask_ps(inside) == 0)
+      continue;
 
-  BoxCollider childBox8 = BoxCollider(center, max);
-  children[7] = std::make_unique<OctreeNode>(childBox8, depth - 1);
+    __m128 current = _mm_loadu_ps(row + x);
+    __m128 nearest = _mm_min_ps(current, outlineDepth);
+    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                     _mm_andnot_ps(inside, current)));
+  }
 }
 
-void OctreeNode::print(const Octree *octree) {
-  std::cout << "Octree: " << octree << std::endl;
-  std::cout << "OctreeNode: " << this << std::endl;
-  std::cout << "   Bounding Box: " << &boundingBox << std::endl;
-  std::cout << "      Min: " << boundingBox.collisionBox.min.x << " "
-            << boundingBox.collisionBox.min.y << " "
-            << boundingBox.collisionBox.min.z << std::endl;
-  std::cout << "      Max: " << boundingBox.collisionBox.max.x << " "
-            << boundingBox.collisionBox.max.y << " "
-            << boundingBox.collisionBox.max.z << std::endl;
+bool isRowOccluded(const float *row, int minX, int maxX, float minDepth) {
+  const __m128 boxDepth = _mm_set1_ps(minDepth);
+  for (int x = minX & ~3; x <= maxX; x += 4) {
+    int lanes = 0xF;
+    if (x < minX)
+      lanes &= 0xF << (minX - x);
+    if (x + 3 > maxX)
+      lanes &= 0xF >> (x + 3 - maxX);
 
-  for (std::unique_ptr<OctreeNode> &child : children)
-    if (child)
-      child->print(octree);
+    __m128 depth = _mm_loadu_ps(row + x);
+    if (_mm_movemask_ps(_mm_cmpge_ps(depth, boxDepth)) & lanes)
+      return false;
+  }
+  return true;
 }
+#endif
 
-OcclusionCuller3D::OcclusionCuller3D(Camera &camera,
-                                     std::vector<float> &depthData)
-    : camera{camera}, depthData{depthData} {};
+} // namespace
 
-void OcclusionCuller3D::generateOctree(const BoxCollider root, int depth) {
-  octree = Octree(root, depth);
+OcclusionCuller3D::OcclusionCuller3D(uint32_t width, uint32_t height)
+    : width{width}, height{height} {
+  assert(width % 4 == 0 && "Occlusion buffer width has to be a multiple of 4");
+  depthBuffer.resize(width * height, 1.f);
 }
 
-bool OcclusionCuller3D::checkAgainstDepthBuffer() {
-  if (octree.root == nullptr)
-    throw std::runtime_error(
-        "Octree root is null! \n Call generateOctree() first!");
-
-  checkOcclusion(octree.root);
+void OcclusionCuller3D::clear(const glm::mat4 &projectionView) {
+  this->projectionView = projectionView;
+  std::fill(depthBuffer.begin(), depthBuffer.end(), 1.f);
+}
 
-  return octree.isOccluded;
+glm::vec3 OcclusionCuller3D::toScreen(const glm::vec4 &clip) const {
+  glm::vec3 ndc = glm::vec3{clip} / clip.w;
+  // The viewport is flipped, +y in NDC is the top row
+  return {(ndc.x * 0.5f + 0.5f) * width, (0.5f - ndc.y * 0.5f) * height,
+          ndc.z};
 }
 
-void OcclusionCuller3D::checkOcclusion(
-    const std::unique_ptr<OctreeNode> &node) {
-  if (node == nullptr)
-    throw std::runtime_error("Node is null!");
+void OcclusionCuller3D::addOccluder(const glm::vec3 &min,
+                                    const glm::vec3 &max) {
+  rasterize(min, max, true);
+}
 
-  glm::mat4 projectionView = camera.getProjection() * camera.getView();
+void OcclusionCuller3D::addOccluderScalar(const glm::vec3 &min,
+                                          const glm::vec3 &max) {
+  rasterize(min, max, false);
+}
 
-  for (Transform corner : node->boundingBox.collisionBox.corners()) {
-    glm::vec4 worldSpacePosition = glm::vec4(corner.position, 1.f);
-    glm::vec4 clipSpacePosition = projectionView * worldSpacePosition;
-    glm::vec3 ndcPos = clipSpacePosition / clipSpacePosition.w;
+bool OcclusionCuller3D::isOccluded(const glm::vec3 &min,
+                                   const glm::vec3 &max) const {
+  return test(min, max, true);
+}
 
-    if (ndcPos.x < -1 || ndcPos.x >= 1 || ndcPos.y < -1 || ndcPos.y >= 1 ||
-        ndcPos.z < 0 || ndcPos.z >= 1)
-      continue;
+bool OcclusionCuller3D::isOccludedScalar(const glm::vec3 &min,
+                                         const glm::vec3 &max) const {
+  return test(min, max, false);
+}
 
-    int screenX = ((ndcPos.x + 1) / 2) * int(WIDTH / 4.f);
-    int screenY = ((ndcPos.y + 1) / 2) * int(HEIGHT / 4.f);
+// Fills the outline of the box cut at the near plane (z >= 0 in clip space),
+// occluders right in front of the camera are the most valuable ones. The
+// cut box is convex, so its outline is the hull of its projected points.
+void OcclusionCuller3D::rasterize(const glm::vec3 &min, const glm::vec3 &max,
+                                  bool useSimd) {
+  std::array<glm::vec4, 8> corners;
+  for (int i = 0; i < 8; i++)
+    corners[i] = projectionView * glm::vec4{boxCorner(min, max, i), 1.f};
 
-    int depthIndex = screenX + screenY * int(WIDTH / 4);
+  std::array<glm::vec4, MAX_OUTLINE_POINTS> clipped;
+  size_t count = 0;
+  for (const glm::vec4 &corner : corners)
+    if (corner.z >= 0.f)
+      clipped[count++] = corner;
+  for (const auto &[from, to] : BOX_EDGES) {
+    const glm::vec4 &a = corners[from];
+    const glm::vec4 &b = corners[to];
+    if ((a.z >= 0.f) != (b.z >= 0.f))
+      clipped[count++] = a + (b - a) * (a.z / (a.z - b.z));
+  }
+  if (count < 3)
+    return;
 
-    if (ndcPos.z <= depthData[depthIndex] || depthData[depthIndex] == 1.f) {
-      octree.isOccluded = false;
+  std::array<glm::vec2, MAX_OUTLINE_POINTS> points;
+  float depth = 0.f;
+  for (size_t i = 0; i < count; i++) {
+    if (clipped[i].w <= 0.f)
       return;
+    glm::vec3 screen = toScreen(clipped[i]);
+    if (std::isnan(screen.x) || std::isnan(screen.y))
+      return;
+    points[i] = glm::vec2{screen};
+    depth = std::max(depth, screen.z);
+  }
+
+  std::array<glm::vec2, MAX_OUTLINE_POINTS * 2> hull;
+  size_t hullSize = convexHull(points.data(), count, hull.data());
+  if (hullSize < 3)
+    return;
+
+  glm::vec2 hullMin = hull[0];
+  glm::vec2 hullMax = hull[0];
+  std::array<Edge, MAX_OUTLINE_POINTS> edges;
+  for (size_t i = 0; i < hullSize; i++) {
+    hullMin = glm::min(hullMin, hull[i]);
+    hullMax = glm::max(hullMax, hull[i]);
+    edges[i] = Edge{hull[i], hull[(i + 1) % hullSize]};
+  }
+
+  int minX = std::max(toPixel(std::floor(hullMin.x), width), 0);
+  int maxX = std::min(toPixel(std::floor(hullMax.x), width),
+                      static_cast<int>(width) - 1);
+  int minY = std::max(toPixel(std::floor(hullMin.y), height), 0);
+  int maxY = std::min(toPixel(std::floor(hullMax.y), height),
+                      static_cast<int>(height) - 1);
+
+  std::array<float, MAX_OUTLINE_POINTS> rowEdges;
+  for (int y = minY; y <= maxY; y++) {
+    float pixelY = y + 0.5f;
+    for (size_t i = 0; i < hullSize; i++)
+      rowEdges[i] = edges[i].b * pixelY + edges[i].c;
+    float *row = depthBuffer.data() + y * width;
+
+#ifdef __SSE2__
+    if (useSimd) {
+      fillRow(row, minX, maxX, edges.data(), rowEdges.data(), hullSize,
+              depth);
+      continue;
     }
+#endif
+    fillRowScalar(row, minX, maxX, edges.data(), rowEdges.data(), hullSize,
+                  depth);
+  }
+}
+
+// Visible as soon as a single pixel under the box's screen rectangle holds
+// an occluder that is not in front of the box's nearest point
+bool OcclusionCuller3D::test(const glm::vec3 &min, const glm::vec3 &max,
+                             bool useSimd) const {
+  glm::vec2 screenMin{INFINITY};
+  glm::vec2 screenMax{-INFINITY};
+  float minDepth = 1.f;
+  for (int i = 0; i < 8; i++) {
+    glm::vec4 clip = projectionView * glm::vec4{boxCorner(min, max, i), 1.f};
+    if (clip.w <= 0.f || clip.z < 0.f)
+      return false;
 
-    if (node->children[0]) {
-      for (const std::unique_ptr<OctreeNode> &child : node->children)
-        if (child != nullptr)
-          checkOcclusion(child);
+    glm::vec3 screen = toScreen(clip);
+    screenMin = glm::min(screenMin, glm::vec2{screen});
+    screenMax = glm::max(screenMax, glm::vec2{screen});
+    minDepth = std::min(minDepth, screen.z);
+  }
+
+  int minX = std::max(toPixel(std::floor(screenMin.x), width), 0);
+  int maxX = std::min(toPixel(std::floor(screenMax.x), width),
+                      static_cast<int>(width) - 1);
+  int minY = std::max(toPixel(std::floor(screenMin.y), height), 0);
+  int maxY = std::min(toPixel(std::floor(screenMax.y), height),
+                      static_cast<int>(height) - 1);
+  if (minX > maxX || minY > maxY)
+    return false;
+
+  for (int y = minY; y <= maxY; y++) {
+    const float *row = depthBuffer.data() + y * width;
+
+#ifdef __SSE2__
+    if (useSimd) {
+      if (!isRowOccluded(row, minX, maxX, minDepth))
+        return false;
+      continue;
     }
+#endif
+    if (!isRowOccludedScalar(row, minX, maxX, minDepth))
+      return false;
   }
+
+  return true;
 }
 
 } // namespace engine
@@ -1,50 +1,46 @@
-#include "../collision.hpp"
-#include "camera.hpp"
-#include "game_object.hpp"
+#pragma once
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_float4.hpp>
 
-#include <array>
-#include <memory>
+#include <cstdint>
 #include <vector>
 namespace engine {
 
-class Octree;
-
-class OctreeNode {
-public:
-  OctreeNode(){};
-  OctreeNode(const BoxCollider boundingBox, int depth);
-
-  BoxCollider boundingBox;
-  std::array<std::unique_ptr<OctreeNode>, 8> children;
-
-  friend class Octree;
-  friend class OcclusionCuller3D;
-
-private:
-  void print(const Octree *octree);
-};
-
-class Octree {
+// Software occlusion culling for devices without GPU driven culling.
+// Occluders are rasterized into a small CPU depth buffer which occludees are
+// then tested against. Occluder boxes have to lie completely inside solid
+// geometry, so anything they hide is hidden on screen as well.
+//
+// Occluders are rasterized conservatively: only pixels that lie completely
+// inside the outline of a box are written, and they take the depth of the
+// box's farthest point. A pixel the buffer marks as covered is covered on
+// screen over its whole area, never just at its centre.
+class OcclusionCuller3D {
 public:
-  Octree();
-  Octree(const BoxCollider rootBoundingBox, int depth);
+  // The width has to be a multiple of 4
+  OcclusionCuller3D(uint32_t width, uint32_t height);
 
-  std::unique_ptr<OctreeNode> root;
-  bool isOccluded = true;
+  void clear(const glm::mat4 &projectionView);
+  // 4 pixels at a time where SSE2 is available
+  void addOccluder(const glm::vec3 &min, const glm::vec3 &max);
+  bool isOccluded(const glm::vec3 &min, const glm::vec3 &max) const;
+  // References for addOccluder and isOccluded, one pixel at a time
+  void addOccluderScalar(const glm::vec3 &min, const glm::vec3 &max);
+  bool isOccludedScalar(const glm::vec3 &min, const glm::vec3 &max) const;
 
-  void print();
-}; // namespace engine
-
-class OcclusionCuller3D {
-public:
-  OcclusionCuller3D(Camera &camera, std::vector<float> &depthBuffer);
-  void generateOctree(const BoxCollider root, int depth);
-  bool checkAgainstDepthBuffer();
-  void checkOcclusion(const std::unique_ptr<OctreeNode> &node);
+  uint32_t getWidth() const { return width; }
+  uint32_t getHeight() const { return height; }
+  const std::vector<float> &getDepthBuffer() const { return depthBuffer; }
 
 private:
-  Octree octree;
-  Camera &camera;
-  std::vector<float> &depthData;
+  uint32_t width;
+  uint32_t height;
+  glm::mat4 projectionView{1.f};
+  std::vector<float> depthBuffer;
+
+  void rasterize(const glm::vec3 &min, const glm::vec3 &max, bool useSimd);
+  bool test(const glm::vec3 &min, const glm::vec3 &max, bool useSimd) const;
+  glm::vec3 toScreen(const glm::vec4 &clip) const;
 };
 } // namespace engine
@@ -45,67 +45,81 @@ void Pipeline::createGraphicsPipeline(const std::string &vertFilepath,
   assert(configInfo.renderPass != VK_NULL_HANDLE &&
          "Cannot create graphics pipeline. Invalid render pass!");
 
+  assert(tcsFilepath.empty() == tesFilepath.empty() &&
+         "Tessellation needs both a control and an evaluation shader!");
+  bool tessellated = !tcsFilepath.empty();
+
   std::vector<char> vertCode = readFile(vertFilepath);
-  std::vector<char> tcsCode = readFile(tcsFilepath);
-  std::vector<char> tesCode = readFile(tesFilepath);
   std::vector<char> fragCode = readFile(fragFilepath);
-
-  createShaderModule(vertCode, &vertShaderModule);
-  createShaderModule(tcsCode, &tcsShaderModule);
-  createShaderModule(tesCode, &tesShaderModule);
-  createShaderModule(fragCode, &fragShaderModule);
-
-  VkPipelineShaderStageCreateInfo shaderStages[2];
-  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-  shaderStages[0].module = vertShaderModule;
-  shaderStages[0].pName = "main";
-  shaderStages[0].flags = 0;
-  shaderStages[0].pNext = nullptr;
-  shaderStages[0].pSpecializationInfo = nullptr;
-
-  shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  shaderStages[1].module = fragShaderModule;
-  shaderStages[1].pName = "main";
-  shaderStages[1].flags = 0;
-  shaderStages[1].pNext = nullptr;
-  shaderStages[1].pSpecializationInfo = nullptr;
-
-  // shaderStages[2].sType =
-  // VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; shaderStages[2].stage
-  // = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; shaderStages[2].module =
-  // tcsShaderModule; shaderStages[2].pName = "main"; shaderStages[2].flags = 0;
-  // shaderStages[2].pNext = nullptr;
-  // shaderStages[2].pSpecializationInfo = nullptr;
-
-  // shaderStages[3].sType =
-  // VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; shaderStages[3].stage
-  // = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; shaderStages[3].module =
-  // tesShaderModule; shaderStages[3].pName = "main"; shaderStages[3].flags = 0;
-  // shaderStages[3].pNext = nullptr;
-  // shaderStages[3].pSpecializationInfo = nullptr;
-
-  auto bindingDescriptions = Model::Vertex::getBindingDescriptions();
-  auto attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+  createShaderModule(device, vertCode, &vertShaderModule);
+  createShaderModule(device, fragCode, &fragShaderModule);
+
+  if (tessellated) {
+    std::vector<char> tcsCode = readFile(tcsFilepath);
+    std::vector<char> tesCode = readFile(tesFilepath);
+    createShaderModule(device, tcsCode, &tcsShaderModule);
+    createShaderModule(device, tesCode, &tesShaderModule);
+  }
+
+  std::vector<VkSpecializationMapEntry> specializationEntries(
+      configInfo.specializationConstants.size());
+  for (uint32_t i = 0; i < specializationEntries.size(); i++)
+    specializationEntries[i] = {i, i * static_cast<uint32_t>(sizeof(uint32_t)),
+                                sizeof(uint32_t)};
+
+  VkSpecializationInfo specializationInfo = {};
+  specializationInfo.mapEntryCount =
+      static_cast<uint32_t>(specializationEntries.size());
+  specializationInfo.pMapEntries = specializationEntries.data();
+  specializationInfo.dataSize =
+      configInfo.specializationConstants.size() * sizeof(uint32_t);
+  specializationInfo.pData = configInfo.specializationConstants.data();
+
+  std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+  auto addStage = [&](VkShaderStageFlagBits stage, VkShaderModule module) {
+    VkPipelineShaderStageCreateInfo shaderStage = {};
+    shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStage.stage = stage;
+    shaderStage.module = module;
+    shaderStage.pName = "main";
+    shaderStage.pSpecializationInfo =
+        specializationEntries.empty() ? nullptr : &specializationInfo;
+    shaderStages.push_back(shaderStage);
+  };
+
+  addStage(VK_SHADER_STAGE_VERTEX_BIT, vertShaderModule);
+  if (tessellated) {
+    addStage(VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, tcsShaderModule);
+    addStage(VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, tesShaderModule);
+  }
+  addStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragShaderModule);
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
   vertexInputInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vertexInputInfo.vertexBindingDescriptionCount =
-      static_cast<uint32_t>(bindingDescriptions.size());
+      static_cast<uint32_t>(configInfo.bindingDescriptions.size());
   vertexInputInfo.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+      static_cast<uint32_t>(configInfo.attributeDescriptions.size());
+  vertexInputInfo.pVertexBindingDescriptions =
+      configInfo.bindingDescriptions.data();
+  vertexInputInfo.pVertexAttributeDescriptions =
+      configInfo.attributeDescriptions.data();
+
+  // Tessellation consumes patches instead of triangles
+  VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo =
+      configInfo.inputAssemblyInfo;
+  if (tessellated)
+    inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
 
   VkGraphicsPipelineCreateInfo pipelineInfo = {};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+  pipelineInfo.pStages = shaderStages.data();
   pipelineInfo.pVertexInputState = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
-  // pipelineInfo.pTessellationState = &configInfo.tessellationInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
+  pipelineInfo.pTessellationState =
+      tessellated ? &configInfo.tessellationInfo : nullptr;
   pipelineInfo.pViewportState = &configInfo.viewportInfo;
   pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
   pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
@@ -122,7 +136,7 @@ void Pipeline::createGraphicsPipeline(const std::string &vertFilepath,
 
   pipelineInfo.pNext = nullptr;
 
-  if (vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1,
+  if (vkCreateGraphicsPipelines(device.device(), device.getPipelineCache(), 1,
                                 &pipelineInfo, nullptr,
                                 &graphicsPipeline) != VK_SUCCESS)
     throw std::runtime_error("Failed to create graphics pipeline!");
@@ -144,7 +158,7 @@ std::vector<char> Pipeline::readFile(const std::string &path) {
   return buffer;
 }
 
-void Pipeline::createShaderModule(const std::vector<char> &code,
+void Pipeline::createShaderModule(Device &device, const std::vector<char> &code,
                                   VkShaderModule *shaderModule) {
   VkShaderModuleCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -156,7 +170,49 @@ void Pipeline::createShaderModule(const std::vector<char> &code,
     throw std::runtime_error("Failed to create shader module!");
 }
 
+ComputePipeline::ComputePipeline(Device &device,
+                                 const std::string &compFilepath,
+                                 VkPipelineLayout pipelineLayout)
+    : device{device} {
+  assert(pipelineLayout != VK_NULL_HANDLE &&
+         "Cannot create compute pipeline. Invalid pipeline layout!");
+
+  std::vector<char> compCode = Pipeline::readFile(compFilepath);
+  Pipeline::createShaderModule(device, compCode, &compShaderModule);
+
+  VkPipelineShaderStageCreateInfo shaderStage = {};
+  shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  shaderStage.module = compShaderModule;
+  shaderStage.pName = "main";
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = shaderStage;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  if (vkCreateComputePipelines(device.device(), device.getPipelineCache(), 1,
+                               &pipelineInfo, nullptr,
+                               &computePipeline) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create compute pipeline!");
+}
+
+ComputePipeline::~ComputePipeline() {
+  vkDestroyShaderModule(device.device(), compShaderModule, nullptr);
+  vkDestroyPipeline(device.device(), computePipeline, nullptr);
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    computePipeline);
+}
+
 void Pipeline::defaultPipelineConfig(PipelineConfigInfo &configInfo) {
+  configInfo.bindingDescriptions = Model::Vertex::getBindingDescriptions();
+  configInfo.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+
   configInfo.dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
                               VK_DYNAMIC_STATE_SCISSOR};
   // Dynamic States
@@ -1,5 +1,7 @@
+#pragma once
 #include "device.hpp"
 #include <cstdint>
+#include <string>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -18,6 +20,10 @@ struct PipelineConfigInfo {
   VkPipelineColorBlendAttachmentState colorBlendAttachment;
   VkPipelineColorBlendStateCreateInfo colorBlendInfo;
   VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+  // Value i is bound to constant_id i in every stage
+  std::vector<uint32_t> specializationConstants;
   std::vector<VkDynamicState> dynamicStates;
   VkPipelineDynamicStateCreateInfo dynamicStateInfo;
   VkPipelineLayout pipelineLayout = nullptr;
@@ -27,6 +33,7 @@ struct PipelineConfigInfo {
 
 class Pipeline {
 public:
+  // Without tessellation when both tessellation paths are empty
   Pipeline(Device &device, const std::string &vertFilepath,
            const std::string &tcsFilepath, const std::string &tesFilepath,
            const std::string &fragFilepath,
@@ -37,6 +44,9 @@ public:
   Pipeline &operator=(const Pipeline &) = delete;
 
   static void defaultPipelineConfig(PipelineConfigInfo &configInfo);
+  static std::vector<char> readFile(const std::string &filepath);
+  static void createShaderModule(Device &device, const std::vector<char> &code,
+                                 VkShaderModule *shaderModule);
 
   void bind(VkCommandBuffer commandBuffer);
 
@@ -44,8 +54,8 @@ private:
   Device &device;
   VkPipeline graphicsPipeline;
   VkShaderModule vertShaderModule;
-  VkShaderModule tcsShaderModule;
-  VkShaderModule tesShaderModule;
+  VkShaderModule tcsShaderModule = VK_NULL_HANDLE;
+  VkShaderModule tesShaderModule = VK_NULL_HANDLE;
   VkShaderModule fragShaderModule;
 
   void createGraphicsPipeline(const std::string &vertFilepath,
@@ -53,8 +63,22 @@ private:
                               const std::string &tesFilepath,
                               const std::string &fragFilepath,
                               const PipelineConfigInfo &configInfo);
-  std::vector<char> readFile(const std::string &filepath);
-  void createShaderModule(const std::vector<char> &code,
-                          VkShaderModule *shaderModule);
+};
+
+class ComputePipeline {
+public:
+  ComputePipeline(Device &device, const std::string &compFilepath,
+                  VkPipelineLayout pipelineLayout);
+  ~ComputePipeline();
+
+  ComputePipeline(const ComputePipeline &) = delete;
+  ComputePipeline &operator=(const ComputePipeline &) = delete;
+
+  void bind(VkCommandBuffer commandBuffer);
+
+private:
+  Device &device;
+  VkPipeline computePipeline;
+  VkShaderModule compShaderModule;
 };
 } // namespace engine
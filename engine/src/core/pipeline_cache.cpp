@@ -0,0 +1,101 @@
+#include "pipeline_cache.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+PipelineCache::PipelineCache(VkDevice device,
+                             const VkPhysicalDeviceProperties &properties,
+                             const string &filepath)
+    : device{device}, filepath{filepath} {
+  expectedHeader.magic = MAGIC;
+  expectedHeader.headerSize = sizeof(FileHeader);
+  expectedHeader.vendorID = properties.vendorID;
+  expectedHeader.deviceID = properties.deviceID;
+  expectedHeader.driverVersion = properties.driverVersion;
+  memcpy(expectedHeader.pipelineCacheUUID, properties.pipelineCacheUUID,
+         VK_UUID_SIZE);
+
+  vector<char> data;
+  bool loaded = load(data);
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = loaded ? data.size() : 0;
+  cacheInfo.pInitialData = loaded ? data.data() : nullptr;
+
+  // Drivers may still reject data that passed the header check
+  if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) ==
+      VK_SUCCESS)
+    return;
+
+  cacheInfo.initialDataSize = 0;
+  cacheInfo.pInitialData = nullptr;
+  if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) !=
+      VK_SUCCESS)
+    throw runtime_error("Failed to create pipeline cache!");
+}
+
+PipelineCache::~PipelineCache() {
+  save();
+  vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+bool PipelineCache::load(vector<char> &data) {
+  ifstream file{filepath, ios::ate | ios::binary};
+  if (!file.is_open())
+    return false;
+
+  size_t fileSize = static_cast<size_t>(file.tellg());
+  file.seekg(0);
+
+  FileHeader header;
+  if (fileSize < sizeof(FileHeader) ||
+      !file.read(reinterpret_cast<char *>(&header), sizeof(FileHeader)) ||
+      memcmp(&header, &expectedHeader, offsetof(FileHeader, dataSize)) != 0 ||
+      header.dataSize != fileSize - sizeof(FileHeader))
+    return false;
+
+  data.resize(header.dataSize);
+  return static_cast<bool>(file.read(data.data(), header.dataSize));
+}
+
+// Written to a temporary file first, a crash mid write must not leave a
+// truncated cache behind
+void PipelineCache::save() {
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS)
+    return;
+
+  vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(device, cache, &dataSize, data.data()) !=
+      VK_SUCCESS)
+    return;
+
+  FileHeader header = expectedHeader;
+  header.dataSize = dataSize;
+
+  string tempFilepath = filepath + ".tmp";
+  {
+    ofstream file{tempFilepath, ios::binary | ios::trunc};
+    if (!file.is_open())
+      return;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+    file.write(data.data(), dataSize);
+    if (!file)
+      return;
+  }
+  rename(tempFilepath.c_str(), filepath.c_str());
+}
+
+} // namespace engine
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// VkPipelineCache that outlives the process. The file starts with the
+// device's vendor, device and driver version plus its pipeline cache UUID,
+// data written by any other driver or GPU is dropped instead of handed to
+// Vulkan. Shared by every pipeline, vkCreate*Pipelines may use it from
+// several threads at once.
+class PipelineCache {
+public:
+  PipelineCache(VkDevice device, const VkPhysicalDeviceProperties &properties,
+                const std::string &filepath);
+  // Saves the cache
+  ~PipelineCache();
+
+  PipelineCache(const PipelineCache &) = delete;
+  PipelineCache &operator=(const PipelineCache &) = delete;
+
+  VkPipelineCache getCache() { return cache; }
+  void save();
+
+private:
+  struct FileHeader {
+    uint32_t magic;
+    uint32_t headerSize;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint32_t reserved;
+    uint64_t dataSize;
+  };
+
+  static constexpr uint32_t MAGIC = 0x43504B56; // "VKPC"
+
+  VkDevice device;
+  FileHeader expectedHeader{};
+  std::string filepath;
+  VkPipelineCache cache;
+
+  bool load(std::vector<char> &data);
+};
+
+} // namespace engine
@@ -0,0 +1,123 @@
+#include "pipeline_registry.hpp"
+#include "cpu_profiler.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+size_t PipelineRegistry::KeyHash::operator()(const PipelineKey &key) const {
+  size_t seed = 0;
+  auto combine = [&seed](size_t value) {
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  };
+
+  combine(hash<string>{}(key.vertFilepath));
+  combine(hash<string>{}(key.fragFilepath));
+  combine(hash<string>{}(key.tcsFilepath));
+  combine(hash<string>{}(key.tesFilepath));
+  combine(static_cast<size_t>(key.vertexFormat));
+  for (uint32_t constant : key.specializationConstants)
+    combine(constant);
+  return seed;
+}
+
+PipelineRegistry::PipelineRegistry(Device &device,
+                                   VkPipelineLayout pipelineLayout,
+                                   VkRenderPass renderPass)
+    : device{device}, pipelineLayout{pipelineLayout}, renderPass{renderPass} {}
+
+PipelineRegistry::~PipelineRegistry() {
+  for (auto &[key, pendingPipeline] : pendingPipelines)
+    pendingPipeline.wait();
+}
+
+unique_ptr<Pipeline>
+PipelineRegistry::createPipeline(const PipelineKey &key,
+                                 VkRenderPass renderPass) const {
+  PipelineConfigInfo configInfo = {};
+  Pipeline::defaultPipelineConfig(configInfo);
+  configInfo.renderPass = renderPass;
+  configInfo.pipelineLayout = pipelineLayout;
+  configInfo.specializationConstants = key.specializationConstants;
+  if (key.vertexFormat == VertexFormat::None) {
+    configInfo.bindingDescriptions.clear();
+    configInfo.attributeDescriptions.clear();
+  }
+
+  return make_unique<Pipeline>(device, key.vertFilepath, key.tcsFilepath,
+                               key.tesFilepath, key.fragFilepath, configInfo);
+}
+
+void PipelineRegistry::prepare(const PipelineKey &key) {
+  if (pipelines.contains(key) || pendingPipelines.contains(key))
+    return;
+
+  // setRenderPass waits for this before the old render pass can go away
+  VkRenderPass targetRenderPass = renderPass;
+  pendingPipelines.emplace(
+      key, async(launch::async, [this, key, targetRenderPass]() {
+        PROFILE_THREAD("pipeline compiler");
+        PROFILE_SCOPE("compile pipeline");
+        return createPipeline(key, targetRenderPass);
+      }));
+}
+
+Pipeline &PipelineRegistry::get(const PipelineKey &key) {
+  auto pending = pendingPipelines.find(key);
+  if (pending != pendingPipelines.end()) {
+    auto pendingPipeline = std::move(pending->second);
+    pendingPipelines.erase(pending);
+    return *(pipelines[key] = pendingPipeline.get());
+  }
+
+  auto pipeline = pipelines.find(key);
+  if (pipeline != pipelines.end())
+    return *pipeline->second;
+
+  return *(pipelines[key] = createPipeline(key, renderPass));
+}
+
+Pipeline *PipelineRegistry::tryGet(const PipelineKey &key) {
+  auto pipeline = pipelines.find(key);
+  if (pipeline != pipelines.end())
+    return pipeline->second.get();
+
+  prepare(key);
+  collect(false);
+
+  pipeline = pipelines.find(key);
+  return pipeline != pipelines.end() ? pipeline->second.get() : nullptr;
+}
+
+void PipelineRegistry::waitIdle() { collect(true); }
+
+void PipelineRegistry::setRenderPass(VkRenderPass renderPass) {
+  waitIdle();
+  this->renderPass = renderPass;
+}
+
+void PipelineRegistry::collect(bool wait) {
+  auto pending = pendingPipelines.begin();
+  while (pending != pendingPipelines.end()) {
+    if (!wait &&
+        pending->second.wait_for(chrono::seconds(0)) != future_status::ready) {
+      pending++;
+      continue;
+    }
+
+    PipelineKey key = pending->first;
+    auto pendingPipeline = std::move(pending->second);
+    pending = pendingPipelines.erase(pending);
+    pipelines[key] = pendingPipeline.get();
+  }
+}
+
+} // namespace engine
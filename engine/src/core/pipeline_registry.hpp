@@ -0,0 +1,82 @@
+#pragma once
+#include "device.hpp"
+#include "pipeline.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+enum class VertexFormat {
+  // Model::Vertex from a single vertex buffer
+  Model,
+  // No vertex input, e.g. vertices generated from gl_VertexIndex
+  None
+};
+
+// Identifies one pipeline permutation. Every permutation shares the layout
+// and render pass of its registry.
+struct PipelineKey {
+  std::string vertFilepath;
+  std::string fragFilepath;
+  // Both empty for a pipeline without tessellation
+  std::string tcsFilepath;
+  std::string tesFilepath;
+  VertexFormat vertexFormat = VertexFormat::Model;
+  // Value i is bound to constant_id i in every stage
+  std::vector<uint32_t> specializationConstants;
+
+  bool operator==(const PipelineKey &) const = default;
+};
+
+// Creates pipeline permutations on first use and keeps them until it is
+// destroyed. All calls have to come from one thread, only the compilation
+// itself runs on workers.
+class PipelineRegistry {
+public:
+  PipelineRegistry(Device &device, VkPipelineLayout pipelineLayout,
+                   VkRenderPass renderPass);
+  // Waits for pipelines that are still compiling
+  ~PipelineRegistry();
+
+  PipelineRegistry(const PipelineRegistry &) = delete;
+  PipelineRegistry &operator=(const PipelineRegistry &) = delete;
+
+  // Starts compiling on a worker thread unless the key is already known
+  void prepare(const PipelineKey &key);
+  // Compiles on the calling thread if needed
+  Pipeline &get(const PipelineKey &key);
+  // Never blocks, nullptr until the pipeline is ready
+  Pipeline *tryGet(const PipelineKey &key);
+
+  void waitIdle();
+  // For pipelines created from now on, existing ones stay compatible
+  void setRenderPass(VkRenderPass renderPass);
+
+private:
+  struct KeyHash {
+    size_t operator()(const PipelineKey &key) const;
+  };
+
+  Device &device;
+  VkPipelineLayout pipelineLayout;
+  VkRenderPass renderPass;
+
+  std::unordered_map<PipelineKey, std::unique_ptr<Pipeline>, KeyHash>
+      pipelines;
+  std::unordered_map<PipelineKey, std::future<std::unique_ptr<Pipeline>>,
+                     KeyHash>
+      pendingPipelines;
+
+  std::unique_ptr<Pipeline> createPipeline(const PipelineKey &key,
+                                           VkRenderPass renderPass) const;
+  // Moves finished compilations over, rethrowing their errors
+  void collect(bool wait);
+};
+
+} // namespace engine
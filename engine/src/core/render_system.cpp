@@ -5,14 +5,15 @@
 #include "game_object.hpp"
 #include "model.hpp"
 #include "object_data.hpp"
-#include "occlusion_culler.hpp"
 #include "swapchain.hpp"
 #include <array>
 #include <cassert>
 #include <cstdint>
-#include <cstring>
+#include <fstream>
 #include <glm/ext/scalar_constants.hpp>
 #include <memory>
+#include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -21,19 +22,36 @@ using namespace std;
 
 namespace engine {
 
+namespace {
+
+constexpr uint32_t TESSELLATION_LEVEL = 10;
+
+const PipelineKey TERRAIN_PIPELINE{"src/shaders/terrain.vert.spv",
+                                   "src/shaders/shader.frag.spv"};
+const PipelineKey TESSELLATED_TERRAIN_PIPELINE{
+    "src/shaders/terrain.vert.spv",
+    "src/shaders/shader.frag.spv",
+    "src/shaders/terrain_control.spv",
+    "src/shaders/terrain_evaluation.spv",
+    VertexFormat::Model,
+    {TESSELLATION_LEVEL}};
+
+} // namespace
+
 RenderSystem::RenderSystem(Device &device, Window &window,
                            VkDescriptorSetLayout descriptorSetLayout)
     : device{device}, window{window} {
   swapChain = make_unique<SwapChain>(device, window.getExtent());
   createPipelineLayout(descriptorSetLayout);
-  createPipeline(swapChain->getRenderPass());
+  createPipelines(swapChain->getRenderPass());
   createCommandBuffers();
+  gpuProfiler =
+      make_unique<GpuProfiler>(device, SwapChain::MAX_FRAMES_IN_FLIGHT);
 }
 
 RenderSystem::~RenderSystem() {
+  pipelines.reset();
   vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
-  vkFreeCommandBuffers(device.device(), device.getCommandPool(), 1,
-                       &imageAcquireCommandBuffer);
 }
 
 void RenderSystem::recreateSwapChain() {
@@ -44,12 +62,15 @@ void RenderSystem::recreateSwapChain() {
   }
 
   vkDeviceWaitIdle(device.device());
+  // Pipelines may still be compiling against the old render pass
+  pipelines->waitIdle();
 
   shared_ptr<SwapChain> oldSwapChain = std::move(swapChain);
   swapChain = make_unique<SwapChain>(device, extent, oldSwapChain);
 
   if (!oldSwapChain->compareSwapFormats(*swapChain.get()))
     throw runtime_error("Swap chain image(or depth) format has changed!");
+  pipelines->setRenderPass(swapChain->getRenderPass());
 }
 
 void RenderSystem::createPipelineLayout(
@@ -67,19 +88,18 @@ void RenderSystem::createPipelineLayout(
     throw runtime_error("Failed to create pipeline layout!");
 }
 
-void RenderSystem::createPipeline(VkRenderPass renderPass) {
+void RenderSystem::createPipelines(VkRenderPass renderPass) {
   assert(pipelineLayout != nullptr &&
          "Cannot create pipeline before pipeline layout!");
 
-  PipelineConfigInfo piplineConfigInfo = {};
-  Pipeline::defaultPipelineConfig(piplineConfigInfo);
-  piplineConfigInfo.renderPass = renderPass;
-  piplineConfigInfo.pipelineLayout = pipelineLayout;
+  // Compiles during startup, frames before it is ready skip their draws
+  pipelines =
+      make_unique<PipelineRegistry>(device, pipelineLayout, renderPass);
+  pipelines->prepare(TERRAIN_PIPELINE);
+}
 
-  pipeline = make_unique<Pipeline>(
-      device, "src/shaders/shader.vert.spv", "src/shaders/terrain_control.spv",
-      "src/shaders/terrain_evaluation.spv", "src/shaders/shader.frag.spv",
-      piplineConfigInfo);
+const PipelineKey &RenderSystem::getWorldPipelineKey() const {
+  return tessellationEnabled ? TESSELLATED_TERRAIN_PIPELINE : TERRAIN_PIPELINE;
 }
 
 void RenderSystem::createCommandBuffers() {
@@ -112,17 +132,29 @@ VkCommandBuffer RenderSystem::beginFrame() {
   if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
     throw runtime_error("Failed to begin recording command buffer!");
 
+  gpuProfiler->beginFrame(commandBuffer, currentFrameIndex);
+  gpuProfiler->beginScope(commandBuffer, "frame");
   return commandBuffer;
 }
 
 void RenderSystem::recordCommandBuffer(VkCommandBuffer commandBuffer) {
+  beginRenderPass(commandBuffer, swapChain->getRenderPass());
+}
+
+void RenderSystem::resumeRenderPass(VkCommandBuffer commandBuffer) {
+  beginRenderPass(commandBuffer, swapChain->getLoadRenderPass());
+}
+
+void RenderSystem::beginRenderPass(VkCommandBuffer commandBuffer,
+                                   VkRenderPass renderPass) {
   VkRenderPassBeginInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  renderPassInfo.renderPass = swapChain->getRenderPass();
+  renderPassInfo.renderPass = renderPass;
   renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
   renderPassInfo.renderArea.offset = {0, 0};
   renderPassInfo.renderArea.extent = swapChain->extent();
 
+  // Ignored by the load render pass
   array<VkClearValue, 2> clearValues{};
   clearValues[0].color = {{0.53f, 0.81f, 0.92f, 1.0f}};
   clearValues[1].depthStencil = {1.0f, 0};
@@ -146,13 +178,15 @@ void RenderSystem::recordCommandBuffer(VkCommandBuffer commandBuffer) {
   scissor.extent = swapChain->extent();
   vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-  pipeline->bind(commandBuffer);
+  worldPipeline = pipelines->tryGet(getWorldPipelineKey());
+  if (worldPipeline != nullptr)
+    worldPipeline->bind(commandBuffer);
 }
 
 void RenderSystem::renderWorld(FrameInfo &frameInfo,
                                shared_ptr<Model> &worldModel,
                                uint32_t drawCalls) {
-  if (drawCalls == 0 || worldModel == nullptr)
+  if (drawCalls == 0 || worldModel == nullptr || worldPipeline == nullptr)
     return;
 
   vkCmdBindDescriptorSets(frameInfo.commandBuffer,
@@ -161,29 +195,24 @@ void RenderSystem::renderWorld(FrameInfo &frameInfo,
 
   worldModel->bind(frameInfo.commandBuffer);
 
+  if (frameInfo.drawCountBuffer != nullptr) {
+    vkCmdDrawIndexedIndirectCount(
+        frameInfo.commandBuffer, frameInfo.drawCallBuffer->getBuffer(), 0,
+        frameInfo.drawCountBuffer->getBuffer(), 0, drawCalls,
+        sizeof(VkDrawIndexedIndirectCommand));
+    return;
+  }
+
   vkCmdDrawIndexedIndirect(frameInfo.commandBuffer,
                            frameInfo.drawCallBuffer->getBuffer(), 0, drawCalls,
                            sizeof(VkDrawIndexedIndirectCommand));
 }
 
-void RenderSystem::getDepthBufferData(const FrameInfo &frameInfo,
-                                      vector<float> &depthData,
-                                      unique_ptr<Buffer> &stagingBuffer) {
-  depthData.resize(swapChain->extent().width / 4 * swapChain->extent().height /
-                   4);
-  VkImage &depthImage = swapChain->getDepthImage(
-      (frameInfo.frameIndex + SwapChain::MAX_FRAMES_IN_FLIGHT - 1) %
-      SwapChain::MAX_FRAMES_IN_FLIGHT);
-
-  stagingBuffer->getDepthBufferData(imageAcquireCommandBuffer, depthImage,
-                                    swapChain->extent(), depthData);
-
-  memcpy(depthData.data(), stagingBuffer->mappedData(),
-         depthData.size() * sizeof(float));
-}
-
 void RenderSystem::renderGameObjects(FrameInfo &frameInfo,
                                      vector<GameObject> &gameObjects) {
+  if (worldPipeline == nullptr)
+    return;
+
   vkCmdBindDescriptorSets(frameInfo.commandBuffer,
                           VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
                           &frameInfo.descriptorSet, 0, nullptr);
@@ -197,13 +226,19 @@ void RenderSystem::endRenderPass(VkCommandBuffer commandBuffer) {
   vkCmdEndRenderPass(commandBuffer);
 }
 
-void RenderSystem::endFrame() {
+void RenderSystem::endFrame(const TimelineWait &timelineWait) {
   VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
+  if (!capturePath.empty())
+    recordCapture(commandBuffer);
+  gpuProfiler->endScope(commandBuffer);
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
     throw runtime_error("Failed to record command buffer!");
 
-  auto result =
-      swapChain->submitCommandBuffer(&commandBuffer, &currentImageIndex);
+  auto result = swapChain->submitCommandBuffer(&commandBuffer,
+                                              &currentImageIndex, timelineWait);
+
+  if (!capturePath.empty())
+    writeCapture();
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       window.wasWindowResized()) {
@@ -216,4 +251,76 @@ void RenderSystem::endFrame() {
 
   currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
 }
+
+void RenderSystem::captureFrame(const string &path) {
+  if (!swapChain->isHeadless())
+    throw runtime_error("Frames can only be captured when headless!");
+  capturePath = path;
+}
+
+void RenderSystem::recordCapture(VkCommandBuffer commandBuffer) {
+  VkExtent2D extent = swapChain->extent();
+  VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height;
+  if (captureBuffer == nullptr || captureBuffer->getBufferSize() != size * 4) {
+    captureBuffer = make_unique<Buffer>(
+        device, 4, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    captureBuffer->map();
+  }
+
+  // The render pass already left the image in TRANSFER_SRC_OPTIMAL
+  VkMemoryBarrier colorBarrier = {};
+  colorBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  colorBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  colorBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &colorBarrier, 0,
+                       nullptr, 0, nullptr);
+
+  VkBufferImageCopy region = {};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {extent.width, extent.height, 1};
+  vkCmdCopyImageToBuffer(commandBuffer,
+                         swapChain->getImage(currentImageIndex),
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         captureBuffer->getBuffer(), 1, &region);
+
+  VkMemoryBarrier hostBarrier = {};
+  hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0,
+                       nullptr, 0, nullptr);
+}
+
+void RenderSystem::writeCapture() {
+  vkQueueWaitIdle(device.graphicsQueue());
+
+  ofstream file(capturePath, ios::binary);
+  if (!file)
+    throw runtime_error("Failed to open " + capturePath + "!");
+
+  VkExtent2D extent = swapChain->extent();
+  file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+
+  bool isBgra = swapChain->getImageFormat() == VK_FORMAT_B8G8R8A8_SRGB;
+  const uint8_t *pixels =
+      static_cast<const uint8_t *>(captureBuffer->mappedData());
+  vector<uint8_t> row(extent.width * 3);
+  for (uint32_t y = 0; y < extent.height; y++) {
+    for (uint32_t x = 0; x < extent.width; x++) {
+      const uint8_t *pixel = pixels + (y * extent.width + x) * 4;
+      row[x * 3 + 0] = pixel[isBgra ? 2 : 0];
+      row[x * 3 + 1] = pixel[1];
+      row[x * 3 + 2] = pixel[isBgra ? 0 : 2];
+    }
+    file.write(reinterpret_cast<const char *>(row.data()), row.size());
+  }
+
+  capturePath.clear();
+}
 } // namespace engine
@@ -2,13 +2,17 @@
 #define RENDERSYSTEM_HPP
 #include "../chunk.hpp"
 #include "../player.hpp"
+#include "buffer.hpp"
 #include "frame_info.hpp"
 #include "game_object.hpp"
+#include "gpu_profiler.hpp"
 #include "pipeline.hpp"
+#include "pipeline_registry.hpp"
 #include "swapchain.hpp"
 #include "window.hpp"
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -26,36 +30,59 @@ public:
   SwapChain &getSwapChain() { return *swapChain; }
 
   VkCommandBuffer beginFrame();
-  VkCommandBuffer beginDepthImageAcquire();
   VkCommandBuffer getCurrentCommandBuffer() const {
     return commandBuffers[currentFrameIndex];
   }
   float getAspectRatio() const { return swapChain->extentAspectRatio(); }
-  void getDepthBufferData(const FrameInfo &frameInfo,
-                          std::vector<float> &depthData,
-                          std::unique_ptr<Buffer> &stagingBuffer);
+  VkExtent2D getExtent() const { return swapChain->extent(); }
+  VkImage getCurrentDepthImage() const {
+    return swapChain->getDepthImage(currentImageIndex);
+  }
+  VkImageView getCurrentDepthImageView() const {
+    return swapChain->getDepthImageView(currentImageIndex);
+  }
   void recordCommandBuffer(VkCommandBuffer commandBuffer);
+  // Continues into the attachments left by recordCommandBuffer
+  void resumeRenderPass(VkCommandBuffer commandBuffer);
   void renderWorld(FrameInfo &frameInfo, std::shared_ptr<Model> &worldModel,
                    uint32_t drawCalls);
   void renderGameObjects(FrameInfo &frameInfo,
                          std::vector<GameObject> &gameObjects);
   void endRenderPass(VkCommandBuffer commandBuffer);
-  void endFrame();
+  void endFrame(const TimelineWait &timelineWait = {});
+
+  // Opt in variant of the world pipeline, compiled on first use
+  void setTessellation(bool enabled) { tessellationEnabled = enabled; }
+  bool isTessellationEnabled() const { return tessellationEnabled; }
+
+  // Writes this frame's colour image to a binary PPM once it finished.
+  // Only headless frames can be captured, the capture stalls the queue.
+  void captureFrame(const std::string &path);
+
+  // Every frame is timed as "frame", callers add scopes inside it
+  GpuProfiler &getGpuProfiler() { return *gpuProfiler; }
 
 private:
   Device &device;
   Window &window;
   VkPipelineLayout pipelineLayout;
-  std::unique_ptr<Pipeline> pipeline;
+  std::unique_ptr<PipelineRegistry> pipelines;
+  // Bound by the current render pass, null while it is still compiling
+  Pipeline *worldPipeline = nullptr;
+  bool tessellationEnabled = false;
   std::unique_ptr<SwapChain> swapChain;
   std::vector<VkCommandBuffer> commandBuffers;
-
-  VkCommandBuffer imageAcquireCommandBuffer =
-      device.allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+  std::unique_ptr<GpuProfiler> gpuProfiler;
+  std::string capturePath;
+  std::unique_ptr<Buffer> captureBuffer;
 
   void createPipelineLayout(VkDescriptorSetLayout descriptorSetLayout);
-  void createPipeline(VkRenderPass renderPass);
+  void createPipelines(VkRenderPass renderPass);
+  const PipelineKey &getWorldPipelineKey() const;
   void createCommandBuffers();
+  void beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass);
+  void recordCapture(VkCommandBuffer commandBuffer);
+  void writeCapture();
 
   void recreateSwapChain();
 
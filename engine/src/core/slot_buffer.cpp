@@ -0,0 +1,107 @@
+#include "slot_buffer.hpp"
+#include "swapchain.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+SlotBuffer::SlotBuffer(Device &device, VkDeviceSize elementSize,
+                       uint32_t capacity)
+    : elementSize{elementSize}, capacity{capacity} {
+  buffer = make_shared<Buffer>(device, elementSize, capacity,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  stagingBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (auto &stagingBuffer : stagingBuffers) {
+    stagingBuffer = make_unique<Buffer>(
+        device, elementSize, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer->map();
+  }
+
+  slotToPending.resize(capacity, NO_WRITE);
+}
+
+void SlotBuffer::write(uint32_t slot, const void *data) {
+  assert(slot < capacity && "Slot is out of range!");
+
+  uint32_t pending = slotToPending[slot];
+  if (pending == NO_WRITE) {
+    pending = static_cast<uint32_t>(pendingSlots.size());
+    slotToPending[slot] = pending;
+    pendingSlots.push_back(slot);
+    pendingData.resize(pendingData.size() + elementSize);
+  }
+  memcpy(pendingData.data() + pending * elementSize, data, elementSize);
+}
+
+void SlotBuffer::flush(VkCommandBuffer commandBuffer, int frameIndex) {
+  if (pendingSlots.empty())
+    return;
+
+  // The frame's fence was waited on, nothing reads its staging buffer. Slots
+  // are staged in order so neighbouring slots become a single copy.
+  vector<uint32_t> order(pendingSlots.size());
+  for (uint32_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return pendingSlots[a] < pendingSlots[b];
+  });
+
+  auto *staging =
+      static_cast<uint8_t *>(stagingBuffers[frameIndex]->mappedData());
+  copyRegions.clear();
+  for (uint32_t i = 0; i < order.size(); i++) {
+    uint32_t slot = pendingSlots[order[i]];
+    memcpy(staging + i * elementSize,
+           pendingData.data() + order[i] * elementSize, elementSize);
+    slotToPending[slot] = NO_WRITE;
+
+    if (!copyRegions.empty() &&
+        copyRegions.back().dstOffset + copyRegions.back().size ==
+            slot * elementSize) {
+      copyRegions.back().size += elementSize;
+      continue;
+    }
+    copyRegions.push_back({i * elementSize, slot * elementSize, elementSize});
+  }
+  pendingSlots.clear();
+  pendingData.clear();
+
+  // Earlier frames may still be reading the elements about to be replaced
+  VkMemoryBarrier readBarrier = {};
+  readBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  readBarrier.srcAccessMask = 0;
+  readBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &readBarrier, 0,
+                       nullptr, 0, nullptr);
+
+  vkCmdCopyBuffer(commandBuffer, stagingBuffers[frameIndex]->getBuffer(),
+                  buffer->getBuffer(),
+                  static_cast<uint32_t>(copyRegions.size()),
+                  copyRegions.data());
+
+  VkMemoryBarrier copyBarrier = {};
+  copyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  copyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  copyBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &copyBarrier, 0, nullptr, 0, nullptr);
+}
+
+} // namespace engine
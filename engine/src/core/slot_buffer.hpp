@@ -0,0 +1,52 @@
+#pragma once
+#include "buffer.hpp"
+#include "device.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// Device local array of fixed size elements, one per draw slot. Writes are
+// collected on the CPU and copied in at the start of the next recorded
+// frame through that frame's staging buffer, so untouched slots cost nothing.
+// All frames share the one device local buffer. The barriers around the copy
+// make it wait for the shader reads of earlier submissions and make it
+// visible to later ones, nothing more. A slot an earlier frame still draws
+// from must not be written, callers only reuse slots they retired at least
+// MAX_FRAMES_IN_FLIGHT frames ago.
+class SlotBuffer {
+public:
+  SlotBuffer(Device &device, VkDeviceSize elementSize, uint32_t capacity);
+
+  SlotBuffer(const SlotBuffer &) = delete;
+  SlotBuffer &operator=(const SlotBuffer &) = delete;
+
+  // A later write to the same slot before the next flush replaces this one
+  void write(uint32_t slot, const void *data);
+  // Has to be recorded outside of a render pass, before the frame's first
+  // vertex or compute shader reads the buffer
+  void flush(VkCommandBuffer commandBuffer, int frameIndex);
+
+  std::shared_ptr<Buffer> getBuffer() { return buffer; }
+  uint32_t getPendingCount() const {
+    return static_cast<uint32_t>(pendingSlots.size());
+  }
+
+private:
+  static constexpr uint32_t NO_WRITE = UINT32_MAX;
+
+  VkDeviceSize elementSize;
+  uint32_t capacity;
+
+  std::shared_ptr<Buffer> buffer;
+  std::vector<std::unique_ptr<Buffer>> stagingBuffers;
+
+  std::vector<uint8_t> pendingData;
+  std::vector<uint32_t> pendingSlots;
+  std::vector<uint32_t> slotToPending;
+  std::vector<VkBufferCopy> copyRegions;
+};
+
+} // namespace engine
@@ -0,0 +1,72 @@
+#include "staging_ring.hpp"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+StagingRing::StagingRing(Device &device, VkDeviceSize size) : size{size} {
+  buffer = make_unique<Buffer>(device, size, 1,
+                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  buffer->map();
+}
+
+bool StagingRing::allocate(VkDeviceSize requestSize, VkDeviceSize &offset,
+                           VkDeviceSize alignment) {
+  if (requestSize == 0 || requestSize > size)
+    return false;
+
+  if (usedSize == 0)
+    head = tail = 0;
+
+  VkDeviceSize start = (head + alignment - 1) / alignment * alignment;
+  VkDeviceSize skipped = start - head;
+
+  bool isWrapped = head < tail || (head == tail && usedSize > 0);
+  if (isWrapped) {
+    if (start + requestSize > tail)
+      return false;
+  } else if (start + requestSize > size) {
+    // Not enough room at the end, continue at the front and count the
+    // unused end as used until this submission is released
+    if (requestSize > tail)
+      return false;
+    start = 0;
+    skipped = size - head;
+  }
+
+  offset = start;
+  head = start + requestSize;
+  usedSize += skipped + requestSize;
+  unsubmittedSize += skipped + requestSize;
+  return true;
+}
+
+void StagingRing::write(const void *data, VkDeviceSize dataSize,
+                        VkDeviceSize offset) {
+  memcpy(static_cast<char *>(buffer->mappedData()) + offset, data, dataSize);
+}
+
+void StagingRing::submit(uint64_t uploadValue) {
+  if (unsubmittedSize == 0)
+    return;
+
+  submissions.push({uploadValue, head, unsubmittedSize});
+  unsubmittedSize = 0;
+}
+
+void StagingRing::release(uint64_t completedValue) {
+  while (!submissions.empty() &&
+         submissions.front().uploadValue <= completedValue) {
+    usedSize -= submissions.front().size;
+    tail = submissions.front().end;
+    submissions.pop();
+  }
+}
+
+} // namespace engine
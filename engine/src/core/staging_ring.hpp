@@ -0,0 +1,52 @@
+#pragma once
+#include "buffer.hpp"
+#include "device.hpp"
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// Host visible ring buffer that uploads are streamed through. Space handed
+// out since the last submit() is tagged with the upload's timeline value
+// and only reused once release() sees that value completed.
+class StagingRing {
+public:
+  static constexpr VkDeviceSize SIZE_PER_FRAME = 8 * 1024 * 1024;
+
+  StagingRing(Device &device, VkDeviceSize size);
+
+  StagingRing(const StagingRing &) = delete;
+  StagingRing &operator=(const StagingRing &) = delete;
+
+  // Returns false if there is not enough room until older uploads complete
+  bool allocate(VkDeviceSize requestSize, VkDeviceSize &offset,
+                VkDeviceSize alignment = 16);
+  void write(const void *data, VkDeviceSize dataSize, VkDeviceSize offset);
+
+  void submit(uint64_t uploadValue);
+  void release(uint64_t completedValue);
+
+  VkBuffer getBuffer() { return buffer->getBuffer(); }
+  VkDeviceSize getSize() const { return size; }
+  VkDeviceSize getUsedSize() const { return usedSize; }
+
+private:
+  struct Submission {
+    uint64_t uploadValue;
+    VkDeviceSize end;
+    VkDeviceSize size;
+  };
+
+  std::unique_ptr<Buffer> buffer;
+  VkDeviceSize size;
+
+  VkDeviceSize head = 0;
+  VkDeviceSize tail = 0;
+  VkDeviceSize usedSize = 0;
+  VkDeviceSize unsubmittedSize = 0;
+  std::queue<Submission> submissions;
+};
+
+} // namespace engine
@@ -39,12 +39,19 @@ SwapChain::~SwapChain() {
     vkDestroyImageView(device.device(), imageView, nullptr);
   }
 
-  vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
+  if (isHeadless()) {
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+      vkDestroyImage(device.device(), swapChainImages[i], nullptr);
+      device.freeMemory(offscreenImageMemories[i]);
+    }
+  } else {
+    vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
+  }
 
   for (size_t i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemories[i], nullptr);
+    device.freeMemory(depthImageMemories[i]);
   }
 
   for (auto framebuffer : framebuffers) {
@@ -52,6 +59,7 @@ SwapChain::~SwapChain() {
   }
 
   vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  vkDestroyRenderPass(device.device(), loadRenderPass, nullptr);
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
@@ -61,6 +69,11 @@ SwapChain::~SwapChain() {
 }
 
 void SwapChain::createSwapChain() {
+  if (device.isHeadless()) {
+    createOffscreenImages();
+    return;
+  }
+
   SwapchainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
   VkSurfaceFormatKHR surfaceFormat =
@@ -115,6 +128,36 @@ void SwapChain::createSwapChain() {
   swapChainExtent = extent;
 }
 
+void SwapChain::createOffscreenImages() {
+  swapChainImageFormat = device.findSupportedFormat(
+      {VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB},
+      VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+  swapChainExtent = windowExtent;
+
+  swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+  offscreenImageMemories.resize(MAX_FRAMES_IN_FLIGHT);
+  for (size_t i = 0; i < swapChainImages.size(); i++) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = swapChainExtent.width;
+    imageInfo.extent.height = swapChainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = swapChainImageFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                      VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               swapChainImages[i], offscreenImageMemories[i]);
+  }
+}
+
 void SwapChain::createImageViews() {
   swapChainImageViews.resize(swapChainImages.size());
   for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -136,29 +179,46 @@ void SwapChain::createImageViews() {
 }
 
 void SwapChain::createRenderPass() {
+  swapChainDepthFormat = findDepthFormat();
+  renderPass = createRenderPass(false);
+  loadRenderPass = createRenderPass(true);
+}
+
+// The load variant continues drawing into the attachments of the clearing
+// pass after the depth image was sampled for occlusion culling. Both are
+// compatible, so pipelines and framebuffers are shared.
+VkRenderPass SwapChain::createRenderPass(bool loadAttachments) {
+  VkImageLayout colorLayout = isHeadless()
+                                  ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                  : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
   VkAttachmentDescription colorAttachment = {};
   colorAttachment.format = swapChainImageFormat;
   colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.loadOp = loadAttachments ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                           : VK_ATTACHMENT_LOAD_OP_CLEAR;
   colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  colorAttachment.initialLayout =
+      loadAttachments ? colorLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = colorLayout;
 
   VkAttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment = 0;
   colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
   VkAttachmentDescription depthAttachment = {};
-  swapChainDepthFormat = findDepthFormat();
   depthAttachment.format = swapChainDepthFormat;
   depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.loadOp = loadAttachments ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                           : VK_ATTACHMENT_LOAD_OP_CLEAR;
   depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.initialLayout =
+      loadAttachments ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                      : VK_IMAGE_LAYOUT_UNDEFINED;
   depthAttachment.finalLayout =
       VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
@@ -172,15 +232,23 @@ void SwapChain::createRenderPass() {
   subpass.pColorAttachments = &colorAttachmentRef;
   subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+  // Also waits for the depth pyramid build of an earlier pass that sampled
+  // the depth image
   VkSubpassDependency dependency = {};
   dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
   dependency.dstSubpass = 0;
   dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.srcAccessMask = 0;
+                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
   dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
                              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
   std::array<VkAttachmentDescription, 2> attachments = {colorAttachment,
@@ -195,9 +263,12 @@ void SwapChain::createRenderPass() {
   renderPassInfo.dependencyCount = 1;
   renderPassInfo.pDependencies = &dependency;
 
+  VkRenderPass newRenderPass;
   if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr,
-                         &renderPass) != VK_SUCCESS)
+                         &newRenderPass) != VK_SUCCESS)
     throw std::runtime_error("Failed to create render pass!");
+
+  return newRenderPass;
 }
 
 void SwapChain::createDepthResources() {
@@ -218,11 +289,12 @@ void SwapChain::createDepthResources() {
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
-                      VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                      VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                      VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    device.createImageWithInfo(imageInfo, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT,
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                                depthImages[i], depthImageMemories[i]);
 
     VkImageViewCreateInfo viewInfo = {};
@@ -324,37 +396,60 @@ SwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
   }
 }
 
+// Depth only, since the depth image is sampled and its views and barriers
+// name only the depth aspect. Vulkan guarantees D16_UNORM.
 VkFormat SwapChain::findDepthFormat() {
   return device.findSupportedFormat(
-      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
-       VK_FORMAT_D24_UNORM_S8_UINT},
-      VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32,
+       VK_FORMAT_D16_UNORM},
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
 VkResult SwapChain::acquireNextImage(uint32_t *imageIndex) {
   vkWaitForFences(device.device(), 1, &inFlightFences[currentFrame], VK_TRUE,
                   UINT64_MAX);
 
+  if (isHeadless()) {
+    *imageIndex = nextOffscreenImage;
+    nextOffscreenImage = (nextOffscreenImage + 1) % swapChainImages.size();
+    return VK_SUCCESS;
+  }
+
   return vkAcquireNextImageKHR(device.device(), swapChain, UINT64_MAX,
                                imageAvailableSemaphores[currentFrame],
                                VK_NULL_HANDLE, imageIndex);
 }
 
 VkResult SwapChain::submitCommandBuffer(const VkCommandBuffer *commandBuffer,
-                                        uint32_t *imageIndex) {
+                                        uint32_t *imageIndex,
+                                        const TimelineWait &timelineWait) {
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+  // Offscreen images are not acquired, so only the timeline is waited for
+  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame],
+                                  timelineWait.semaphore};
   VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, timelineWait.stage};
+  uint32_t firstWait = isHeadless() ? 1 : 0;
+  submitInfo.waitSemaphoreCount =
+      (timelineWait.semaphore != VK_NULL_HANDLE ? 2 : 1) - firstWait;
+  submitInfo.pWaitSemaphores = waitSemaphores + firstWait;
+  submitInfo.pWaitDstStageMask = waitStages + firstWait;
+
+  // Binary semaphores ignore their entry in the value array
+  uint64_t waitValues[] = {0, timelineWait.value};
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+  timelineInfo.pWaitSemaphoreValues = waitValues + firstWait;
+  submitInfo.pNext = &timelineInfo;
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = commandBuffer;
 
   VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.signalSemaphoreCount = isHeadless() ? 0 : 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
   vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
@@ -362,6 +457,9 @@ VkResult SwapChain::submitCommandBuffer(const VkCommandBuffer *commandBuffer,
                     inFlightFences[currentFrame]) != VK_SUCCESS)
     throw std::runtime_error("Failed to submit draw command buffer!");
 
+  if (isHeadless())
+    return VK_SUCCESS;
+
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
   presentInfo.waitSemaphoreCount = 1;
@@ -7,6 +7,16 @@
 #include <vulkan/vulkan_core.h>
 
 namespace engine {
+
+// Extra timeline semaphore the frame submit waits on, e.g. finished uploads
+struct TimelineWait {
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+  uint64_t value = 0;
+  VkPipelineStageFlags stage = 0;
+};
+
+// Without a surface the swap chain renders into offscreen images it owns.
+// They are never presented and stay in TRANSFER_SRC_OPTIMAL between frames.
 class SwapChain {
 public:
   static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
@@ -20,19 +30,24 @@ public:
   SwapChain &operator=(const SwapChain &) = delete;
 
   VkRenderPass getRenderPass() { return renderPass; }
+  VkRenderPass getLoadRenderPass() { return loadRenderPass; }
   VkFramebuffer getFrameBuffer(int index) { return framebuffers[index]; }
+  VkImage getImage(int index) { return swapChainImages[index]; }
+  VkFormat getImageFormat() { return swapChainImageFormat; }
+  bool isHeadless() { return swapChain == VK_NULL_HANDLE; }
   VkImage &getDepthImage(int index) { return depthImages[index]; }
+  VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
   VkExtent2D &extent() { return swapChainExtent; }
   float extentAspectRatio() {
     return static_cast<float>(swapChainExtent.width) /
            static_cast<float>(swapChainExtent.height);
   }
-  VkImageLayout &getImageLayout(int index) { return depthImageLayouts[index]; }
   VkFence &getInFlightFence(int index) { return inFlightFences[index]; }
 
   VkResult acquireNextImage(uint32_t *imageIndex);
   VkResult submitCommandBuffer(const VkCommandBuffer *commandBuffer,
-                               uint32_t *imageIndex);
+                               uint32_t *imageIndex,
+                               const TimelineWait &timelineWait = {});
 
   bool compareSwapFormats(const SwapChain &swapChain) {
     return swapChain.swapChainImageFormat == swapChainImageFormat &&
@@ -43,20 +58,23 @@ private:
   Device &device;
   VkExtent2D windowExtent;
 
-  VkSwapchainKHR swapChain;
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE;
   VkFormat swapChainImageFormat;
   VkFormat swapChainDepthFormat;
   VkExtent2D swapChainExtent;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
   std::shared_ptr<SwapChain> oldSwapChain;
+  // Only set when headless
+  std::vector<MemoryAllocation> offscreenImageMemories;
+  uint32_t nextOffscreenImage = 0;
 
   VkRenderPass renderPass;
+  VkRenderPass loadRenderPass;
 
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemories;
+  std::vector<MemoryAllocation> depthImageMemories;
   std::vector<VkImageView> depthImageViews;
-  std::vector<VkImageLayout> depthImageLayouts;
 
   std::vector<VkFramebuffer> framebuffers;
 
@@ -67,8 +85,10 @@ private:
   size_t currentFrame = 0;
 
   void createSwapChain();
+  void createOffscreenImages();
   void createImageViews();
   void createRenderPass();
+  VkRenderPass createRenderPass(bool loadAttachments);
   void createDepthResources();
   void createFramebuffers();
   void createSyncObjects();
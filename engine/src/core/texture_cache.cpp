@@ -0,0 +1,453 @@
+#include "texture_cache.hpp"
+#include "../include/stb_image.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+namespace {
+
+// Bumped whenever the encoder changes, so stale cache files are ignored
+constexpr uint32_t CACHE_VERSION = 1;
+
+constexpr VkFormat COMPRESSED_FORMAT = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+constexpr uint32_t BC1_BLOCK_SIZE = 8;
+
+constexpr array<uint8_t, 12> KTX2_IDENTIFIER{0xAB, 'K',  'T',  'X', ' ',
+                                             '2',  '0',  0xBB, '\r', '\n',
+                                             0x1A, '\n'};
+
+struct Ktx2Header {
+  array<uint8_t, 12> identifier;
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+
+struct Ktx2Level {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+// Basic data format descriptor of an sRGB BC1 texture without alpha
+constexpr array<uint32_t, 11> BC1_SRGB_DFD{
+    // Total size, vendor and descriptor type, version and block size
+    44, 0, 2 | (40 << 16),
+    // BC1A model, BT709 primaries, sRGB transfer
+    128 | (1 << 8) | (2 << 16),
+    // 4x4 texel blocks of 8 bytes
+    3 | (3 << 8), 8, 0,
+    // A single 64 bit color sample
+    63 << 16, 0, 0, 0xFFFFFFFF};
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  while (width > 1 || height > 1) {
+    width = max(width / 2, 1u);
+    height = max(height / 2, 1u);
+    levels++;
+  }
+  return levels;
+}
+
+// Bilinear resample of RGBA8 pixels, texel centers are aligned
+vector<uint8_t> resizeImage(const vector<uint8_t> &pixels, int width,
+                            int height, int newWidth, int newHeight) {
+  vector<uint8_t> resized(static_cast<size_t>(newWidth) * newHeight * 4);
+  float scaleX = static_cast<float>(width) / newWidth;
+  float scaleY = static_cast<float>(height) / newHeight;
+
+  for (int y = 0; y < newHeight; y++) {
+    float sourceY = clamp((y + 0.5f) * scaleY - 0.5f, 0.f, height - 1.f);
+    int y0 = static_cast<int>(sourceY);
+    int y1 = min(y0 + 1, height - 1);
+    float fy = sourceY - y0;
+
+    for (int x = 0; x < newWidth; x++) {
+      float sourceX = clamp((x + 0.5f) * scaleX - 0.5f, 0.f, width - 1.f);
+      int x0 = static_cast<int>(sourceX);
+      int x1 = min(x0 + 1, width - 1);
+      float fx = sourceX - x0;
+
+      for (int c = 0; c < 4; c++) {
+        auto texel = [&](int tx, int ty) {
+          return static_cast<float>(pixels[(ty * width + tx) * 4 + c]);
+        };
+        float top = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * fx;
+        float bottom = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * fx;
+        resized[(y * newWidth + x) * 4 + c] =
+            static_cast<uint8_t>(top + (bottom - top) * fy + 0.5f);
+      }
+    }
+  }
+  return resized;
+}
+
+// 2x2 box filter, the last row or column is repeated for odd sizes
+TextureImage::Level downsample(const TextureImage::Level &level) {
+  TextureImage::Level next{max(level.width / 2, 1u),
+                           max(level.height / 2, 1u),
+                           {}};
+  next.data.resize(static_cast<size_t>(next.width) * next.height * 4);
+
+  for (uint32_t y = 0; y < next.height; y++) {
+    uint32_t y0 = min(y * 2, level.height - 1);
+    uint32_t y1 = min(y * 2 + 1, level.height - 1);
+    for (uint32_t x = 0; x < next.width; x++) {
+      uint32_t x0 = min(x * 2, level.width - 1);
+      uint32_t x1 = min(x * 2 + 1, level.width - 1);
+      for (uint32_t c = 0; c < 4; c++) {
+        auto texel = [&](uint32_t tx, uint32_t ty) {
+          return static_cast<uint32_t>(
+              level.data[(ty * level.width + tx) * 4 + c]);
+        };
+        next.data[(y * next.width + x) * 4 + c] = static_cast<uint8_t>(
+            (texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1) +
+             2) /
+            4);
+      }
+    }
+  }
+  return next;
+}
+
+uint16_t toRgb565(const array<int, 3> &color) {
+  return static_cast<uint16_t>(((color[0] >> 3) << 11) |
+                               ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+array<int, 3> fromRgb565(uint16_t color) {
+  int r = (color >> 11) & 31;
+  int g = (color >> 5) & 63;
+  int b = color & 31;
+  return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+}
+
+// Endpoints span the block's bounding box along the diagonal that follows
+// the colors' correlation, inset a little to spread the error evenly
+void encodeBlock(const array<array<int, 3>, 16> &texels, uint8_t *block) {
+  array<int, 3> minColor{255, 255, 255};
+  array<int, 3> maxColor{0, 0, 0};
+  array<int, 3> mean{0, 0, 0};
+  for (const auto &texel : texels)
+    for (int c = 0; c < 3; c++) {
+      minColor[c] = min(minColor[c], texel[c]);
+      maxColor[c] = max(maxColor[c], texel[c]);
+      mean[c] += texel[c];
+    }
+
+  // Green and blue swap ends when they run against red
+  for (int c = 1; c < 3; c++) {
+    long covariance = 0;
+    for (const auto &texel : texels)
+      covariance += static_cast<long>(texel[0] * 16 - mean[0]) *
+                    (texel[c] * 16 - mean[c]);
+    if (covariance < 0)
+      swap(minColor[c], maxColor[c]);
+  }
+
+  for (int c = 0; c < 3; c++) {
+    int inset = (maxColor[c] - minColor[c]) / 16;
+    maxColor[c] -= inset;
+    minColor[c] += inset;
+  }
+
+  uint16_t color0 = toRgb565(maxColor);
+  uint16_t color1 = toRgb565(minColor);
+  // color0 > color1 selects the four color mode
+  if (color0 < color1)
+    swap(color0, color1);
+
+  uint32_t indices = 0;
+  if (color0 != color1) {
+    array<array<int, 3>, 4> palette;
+    palette[0] = fromRgb565(color0);
+    palette[1] = fromRgb565(color1);
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (int i = 0; i < 16; i++) {
+      uint32_t best = 0;
+      int bestDistance = INT32_MAX;
+      for (uint32_t p = 0; p < 4; p++) {
+        int distance = 0;
+        for (int c = 0; c < 3; c++) {
+          int delta = texels[i][c] - palette[p][c];
+          distance += delta * delta;
+        }
+        if (distance < bestDistance) {
+          bestDistance = distance;
+          best = p;
+        }
+      }
+      indices |= best << (i * 2);
+    }
+  }
+
+  memcpy(block, &color0, 2);
+  memcpy(block + 2, &color1, 2);
+  memcpy(block + 4, &indices, 4);
+}
+
+uint64_t hashFile(const string &path) {
+  ifstream file{path, ios::binary};
+  if (!file.is_open())
+    throw runtime_error("Failed to open texture " + path + "!");
+
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325;
+  for (istreambuf_iterator<char> it{file}, end; it != end; ++it) {
+    hash ^= static_cast<uint8_t>(*it);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+} // namespace
+
+TextureCache::TextureCache(string directory)
+    : directory{std::move(directory)} {}
+
+TextureImage TextureCache::load(const string &path, uint32_t width,
+                                uint32_t height, bool compressed) {
+  if (!compressed)
+    return decode(path, width, height);
+
+  string cachePath = getCachePath(path, width, height);
+  TextureImage image;
+  if (readKtx2(cachePath, image))
+    return image;
+
+  image = encodeBC1(decode(path, width, height));
+  writeKtx2(cachePath, image);
+  return image;
+}
+
+void TextureCache::getSourceSize(const string &path, uint32_t &width,
+                                 uint32_t &height) {
+  int sourceWidth, sourceHeight, channels;
+  if (!stbi_info(path.c_str(), &sourceWidth, &sourceHeight, &channels)) {
+    cerr << "Failed to load texture image: " << stbi_failure_reason() << endl;
+    throw runtime_error("Failed to load texture image");
+  }
+  width = static_cast<uint32_t>(sourceWidth);
+  height = static_cast<uint32_t>(sourceHeight);
+}
+
+string TextureCache::getCachePath(const string &path, uint32_t width,
+                                  uint32_t height) const {
+  char name[64];
+  snprintf(name, sizeof(name), "%016llx_%ux%u_v%u.ktx2",
+           static_cast<unsigned long long>(hashFile(path)), width, height,
+           CACHE_VERSION);
+  return directory + "/" + name;
+}
+
+TextureImage TextureCache::decode(const string &path, uint32_t width,
+                                  uint32_t height) {
+  int sourceWidth, sourceHeight, channels;
+  stbi_uc *textureData = stbi_load(path.c_str(), &sourceWidth, &sourceHeight,
+                                   &channels, STBI_rgb_alpha);
+  if (!textureData) {
+    cerr << "Failed to load texture image: " << stbi_failure_reason() << endl;
+    throw runtime_error("Failed to load texture image");
+  }
+
+  TextureImage::Level level{static_cast<uint32_t>(sourceWidth),
+                            static_cast<uint32_t>(sourceHeight),
+                            {}};
+  level.data.assign(textureData,
+                    textureData + static_cast<size_t>(sourceWidth) *
+                                      sourceHeight * 4);
+  stbi_image_free(textureData);
+
+  if (level.width != width || level.height != height) {
+    level.data = resizeImage(level.data, sourceWidth, sourceHeight,
+                             static_cast<int>(width),
+                             static_cast<int>(height));
+    level.width = width;
+    level.height = height;
+  }
+
+  TextureImage image;
+  image.format = VK_FORMAT_R8G8B8A8_SRGB;
+  image.levels.push_back(std::move(level));
+  while (image.levels.back().width > 1 || image.levels.back().height > 1)
+    image.levels.push_back(downsample(image.levels.back()));
+  return image;
+}
+
+// Levels smaller than a block still take a whole block, the texels outside
+// the level repeat its last row and column
+TextureImage TextureCache::encodeBC1(const TextureImage &image) {
+  TextureImage compressed;
+  compressed.format = COMPRESSED_FORMAT;
+
+  for (const TextureImage::Level &level : image.levels) {
+    uint32_t blocksX = (level.width + 3) / 4;
+    uint32_t blocksY = (level.height + 3) / 4;
+    TextureImage::Level &target = compressed.levels.emplace_back();
+    target.width = level.width;
+    target.height = level.height;
+    target.data.resize(static_cast<size_t>(blocksX) * blocksY *
+                       BC1_BLOCK_SIZE);
+
+    array<array<int, 3>, 16> texels;
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+      for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+        for (uint32_t i = 0; i < 16; i++) {
+          uint32_t x = min(blockX * 4 + i % 4, level.width - 1);
+          uint32_t y = min(blockY * 4 + i / 4, level.height - 1);
+          const uint8_t *texel = &level.data[(y * level.width + x) * 4];
+          texels[i] = {texel[0], texel[1], texel[2]};
+        }
+        encodeBlock(texels, &target.data[(blockY * blocksX + blockX) *
+                                         BC1_BLOCK_SIZE]);
+      }
+  }
+  return compressed;
+}
+
+bool TextureCache::readKtx2(const string &path, TextureImage &image) {
+  ifstream file{path, ios::ate | ios::binary};
+  if (!file.is_open())
+    return false;
+
+  uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+  file.seekg(0);
+
+  Ktx2Header header;
+  if (fileSize < sizeof(Ktx2Header) ||
+      !file.read(reinterpret_cast<char *>(&header), sizeof(Ktx2Header)) ||
+      header.identifier != KTX2_IDENTIFIER ||
+      header.vkFormat != COMPRESSED_FORMAT || header.typeSize != 1 ||
+      header.pixelDepth != 0 || header.layerCount != 0 ||
+      header.faceCount != 1 || header.supercompressionScheme != 0 ||
+      header.levelCount !=
+          getMipLevelCount(header.pixelWidth, header.pixelHeight))
+    return false;
+
+  vector<Ktx2Level> levelIndex(header.levelCount);
+  if (!file.read(reinterpret_cast<char *>(levelIndex.data()),
+                 levelIndex.size() * sizeof(Ktx2Level)))
+    return false;
+
+  TextureImage loaded;
+  loaded.format = COMPRESSED_FORMAT;
+  uint32_t width = header.pixelWidth;
+  uint32_t height = header.pixelHeight;
+  for (const Ktx2Level &entry : levelIndex) {
+    uint64_t expectedLength =
+        static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) *
+        BC1_BLOCK_SIZE;
+    if (entry.byteLength != expectedLength ||
+        entry.byteOffset > fileSize ||
+        entry.byteLength > fileSize - entry.byteOffset)
+      return false;
+
+    TextureImage::Level &level = loaded.levels.emplace_back();
+    level.width = width;
+    level.height = height;
+    level.data.resize(entry.byteLength);
+    file.seekg(static_cast<streamoff>(entry.byteOffset));
+    if (!file.read(reinterpret_cast<char *>(level.data.data()),
+                   entry.byteLength))
+      return false;
+
+    width = max(width / 2, 1u);
+    height = max(height / 2, 1u);
+  }
+
+  image = std::move(loaded);
+  return true;
+}
+
+// Level data is stored smallest first as the format asks. Written to a
+// temporary file first, so an interrupted write never leaves a broken cache
+// entry behind.
+void TextureCache::writeKtx2(const string &path, const TextureImage &image) {
+  uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+
+  Ktx2Header header = {};
+  header.identifier = KTX2_IDENTIFIER;
+  header.vkFormat = image.format;
+  header.typeSize = 1;
+  header.pixelWidth = image.getWidth();
+  header.pixelHeight = image.getHeight();
+  header.faceCount = 1;
+  header.levelCount = levelCount;
+  header.dfdByteOffset = static_cast<uint32_t>(
+      sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level));
+  header.dfdByteLength = static_cast<uint32_t>(sizeof(BC1_SRGB_DFD));
+
+  vector<Ktx2Level> levelIndex(levelCount);
+  uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+  for (uint32_t i = levelCount; i-- > 0;) {
+    offset = (offset + BC1_BLOCK_SIZE - 1) / BC1_BLOCK_SIZE * BC1_BLOCK_SIZE;
+    levelIndex[i] = {offset, image.levels[i].data.size(),
+                     image.levels[i].data.size()};
+    offset += image.levels[i].data.size();
+  }
+
+  error_code error;
+  filesystem::create_directories(filesystem::path{path}.parent_path(), error);
+
+  string tempPath = path + ".tmp";
+  {
+    ofstream file{tempPath, ios::binary | ios::trunc};
+    if (!file.is_open())
+      return;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Ktx2Header));
+    file.write(reinterpret_cast<const char *>(levelIndex.data()),
+               levelIndex.size() * sizeof(Ktx2Level));
+    file.write(reinterpret_cast<const char *>(BC1_SRGB_DFD.data()),
+               sizeof(BC1_SRGB_DFD));
+
+    uint64_t written = header.dfdByteOffset + header.dfdByteLength;
+    const char padding[BC1_BLOCK_SIZE] = {};
+    for (uint32_t i = levelCount; i-- > 0;) {
+      file.write(padding,
+                 static_cast<streamsize>(levelIndex[i].byteOffset - written));
+      file.write(reinterpret_cast<const char *>(image.levels[i].data.data()),
+                 image.levels[i].data.size());
+      written = levelIndex[i].byteOffset + levelIndex[i].byteLength;
+    }
+    if (!file)
+      return;
+  }
+  rename(tempPath.c_str(), path.c_str());
+}
+
+} // namespace engine
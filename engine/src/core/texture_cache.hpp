@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+struct TextureImage {
+  struct Level {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> data;
+  };
+
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  // Largest first, down to 1x1
+  std::vector<Level> levels;
+
+  uint32_t getWidth() const { return levels.front().width; }
+  uint32_t getHeight() const { return levels.front().height; }
+};
+
+// Turns source images into full mip chains. Compressed textures are encoded
+// to BC1 once and kept as KTX2 files named after the hash of the source, so
+// later starts skip decoding and encoding entirely.
+class TextureCache {
+public:
+  static constexpr const char *DEFAULT_DIRECTORY = "texture_cache";
+
+  explicit TextureCache(std::string directory = DEFAULT_DIRECTORY);
+
+  // Scales the source to width x height. Without compression the source is
+  // decoded on every call and the result is RGBA8.
+  TextureImage load(const std::string &path, uint32_t width, uint32_t height,
+                    bool compressed);
+
+  // Reads the size from the image header without decoding it
+  static void getSourceSize(const std::string &path, uint32_t &width,
+                            uint32_t &height);
+
+private:
+  std::string directory;
+
+  std::string getCachePath(const std::string &path, uint32_t width,
+                           uint32_t height) const;
+  static TextureImage decode(const std::string &path, uint32_t width,
+                             uint32_t height);
+  static TextureImage encodeBC1(const TextureImage &image);
+
+  static bool readKtx2(const std::string &path, TextureImage &image);
+  static void writeKtx2(const std::string &path, const TextureImage &image);
+};
+
+} // namespace engine
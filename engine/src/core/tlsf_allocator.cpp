@@ -0,0 +1,289 @@
+#include "tlsf_allocator.hpp"
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+TlsfAllocator::TlsfAllocator(uint64_t size) : size{size} {
+  nodes.reserve(64);
+  reset();
+}
+
+void TlsfAllocator::reset() {
+  nodes.clear();
+  unusedNodes.clear();
+
+  usedSize = 0;
+  allocationCount = 0;
+  freeBlockCount = 0;
+
+  flBitmap = 0;
+  for (uint32_t fl = 0; fl < FL_COUNT; fl++) {
+    slBitmap[fl] = 0;
+    for (uint32_t sl = 0; sl < SL_COUNT; sl++)
+      freeLists[fl][sl] = INVALID_NODE;
+  }
+
+  if (size == 0)
+    return;
+
+  uint32_t root = createNode();
+  nodes[root].offset = 0;
+  nodes[root].size = size;
+  insertFree(root);
+}
+
+bool TlsfAllocator::allocate(uint64_t requestSize, Allocation &allocation,
+                             uint64_t alignment) {
+  if (alignment == 0)
+    alignment = 1;
+
+  if (requestSize == 0 || requestSize > size - usedSize)
+    return false;
+
+  uint32_t node = findFreeNode(requestSize, alignment);
+  if (node == INVALID_NODE)
+    return false;
+
+  removeFree(node);
+
+  uint64_t alignedOffset =
+      (nodes[node].offset + alignment - 1) / alignment * alignment;
+  uint64_t padding = alignedOffset - nodes[node].offset;
+  if (padding > 0) {
+    uint32_t front = node;
+    node = splitOff(front, padding);
+    insertFree(front);
+  }
+
+  if (nodes[node].size > requestSize) {
+    uint32_t tail = splitOff(node, requestSize);
+    insertFree(tail);
+  }
+
+  usedSize += nodes[node].size;
+  allocationCount++;
+
+  allocation.offset = nodes[node].offset;
+  allocation.size = nodes[node].size;
+  allocation.node = node;
+  return true;
+}
+
+void TlsfAllocator::free(Allocation &allocation) {
+  if (!allocation.isValid())
+    return;
+
+  uint32_t node = allocation.node;
+  assert(node < nodes.size() && !nodes[node].isFree &&
+         "Allocation does not belong to this allocator or was freed twice!");
+
+  usedSize -= nodes[node].size;
+  allocationCount--;
+
+  uint32_t prev = nodes[node].prevPhysical;
+  if (prev != INVALID_NODE && nodes[prev].isFree) {
+    removeFree(prev);
+    nodes[prev].size += nodes[node].size;
+    nodes[prev].nextPhysical = nodes[node].nextPhysical;
+    if (nodes[node].nextPhysical != INVALID_NODE)
+      nodes[nodes[node].nextPhysical].prevPhysical = prev;
+    releaseNode(node);
+    node = prev;
+  }
+
+  uint32_t next = nodes[node].nextPhysical;
+  if (next != INVALID_NODE && nodes[next].isFree) {
+    removeFree(next);
+    nodes[node].size += nodes[next].size;
+    nodes[node].nextPhysical = nodes[next].nextPhysical;
+    if (nodes[next].nextPhysical != INVALID_NODE)
+      nodes[nodes[next].nextPhysical].prevPhysical = node;
+    releaseNode(next);
+  }
+
+  insertFree(node);
+  allocation = {};
+}
+
+TlsfAllocator::Statistics TlsfAllocator::getStatistics() const {
+  Statistics statistics{};
+  statistics.totalSize = size;
+  statistics.usedSize = usedSize;
+  statistics.freeSize = size - usedSize;
+  statistics.allocationCount = allocationCount;
+  statistics.freeBlockCount = freeBlockCount;
+
+  if (flBitmap != 0) {
+    uint32_t fl = static_cast<uint32_t>(std::bit_width(flBitmap)) - 1;
+    uint32_t sl = static_cast<uint32_t>(std::bit_width(slBitmap[fl])) - 1;
+    for (uint32_t node = freeLists[fl][sl]; node != INVALID_NODE;
+         node = nodes[node].nextFree) {
+      if (nodes[node].size > statistics.largestFreeBlock)
+        statistics.largestFreeBlock = nodes[node].size;
+    }
+  }
+
+  return statistics;
+}
+
+void TlsfAllocator::mapping(uint64_t size, uint32_t &fl, uint32_t &sl) {
+  if (size < SL_COUNT) {
+    fl = 0;
+    sl = static_cast<uint32_t>(size);
+    return;
+  }
+
+  uint32_t msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+  fl = msb - SL_LOG2 + 1;
+  sl = static_cast<uint32_t>(size >> (msb - SL_LOG2)) - SL_COUNT;
+}
+
+uint32_t TlsfAllocator::findFreeNode(uint64_t requestSize,
+                                     uint64_t alignment) const {
+  if (requestSize <= UINT64_MAX - (alignment - 1)) {
+    uint32_t node = findListAbove(requestSize + alignment - 1);
+    if (node != INVALID_NODE)
+      return node;
+  }
+
+  // Blocks below that list may still fit, either because they are between
+  // the request and the list boundary or because they need less padding
+  // than the worst case. Only searched when the fast path fails, so when
+  // the allocator is nearly full.
+  uint32_t fl, sl;
+  mapping(requestSize, fl, sl);
+  for (; fl < FL_COUNT; fl++, sl = 0) {
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    while (slMap != 0) {
+      uint32_t list = static_cast<uint32_t>(std::countr_zero(slMap));
+      slMap &= slMap - 1;
+      for (uint32_t node = freeLists[fl][list]; node != INVALID_NODE;
+           node = nodes[node].nextFree) {
+        if (fits(node, requestSize, alignment))
+          return node;
+      }
+    }
+  }
+  return INVALID_NODE;
+}
+
+uint32_t TlsfAllocator::findListAbove(uint64_t requestSize) const {
+  // Round up to the next list boundary so every block in the list we land
+  // on is large enough and the head can be taken without searching.
+  uint64_t size = requestSize;
+  if (size >= SL_COUNT) {
+    uint32_t msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+    uint64_t roundUp = (uint64_t{1} << (msb - SL_LOG2)) - 1;
+    if (size > UINT64_MAX - roundUp)
+      return INVALID_NODE;
+    size += roundUp;
+  }
+
+  uint32_t fl, sl;
+  mapping(size, fl, sl);
+  if (fl >= FL_COUNT)
+    return INVALID_NODE;
+
+  uint32_t slMap = slBitmap[fl] & (~0u << sl);
+  if (slMap == 0) {
+    if (fl + 1 >= FL_COUNT)
+      return INVALID_NODE;
+
+    uint64_t flMap = flBitmap & (~uint64_t{0} << (fl + 1));
+    if (flMap == 0)
+      return INVALID_NODE;
+
+    fl = static_cast<uint32_t>(std::countr_zero(flMap));
+    slMap = slBitmap[fl];
+  }
+
+  sl = static_cast<uint32_t>(std::countr_zero(slMap));
+  return freeLists[fl][sl];
+}
+
+bool TlsfAllocator::fits(uint32_t node, uint64_t requestSize,
+                         uint64_t alignment) const {
+  uint64_t alignedOffset =
+      (nodes[node].offset + alignment - 1) / alignment * alignment;
+  uint64_t padding = alignedOffset - nodes[node].offset;
+  return padding <= nodes[node].size &&
+         requestSize <= nodes[node].size - padding;
+}
+
+uint32_t TlsfAllocator::createNode() {
+  if (!unusedNodes.empty()) {
+    uint32_t node = unusedNodes.back();
+    unusedNodes.pop_back();
+    return node;
+  }
+
+  nodes.push_back(Node{});
+  return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void TlsfAllocator::releaseNode(uint32_t node) {
+  nodes[node] = Node{};
+  unusedNodes.push_back(node);
+}
+
+void TlsfAllocator::insertFree(uint32_t node) {
+  uint32_t fl, sl;
+  mapping(nodes[node].size, fl, sl);
+
+  uint32_t head = freeLists[fl][sl];
+  nodes[node].prevFree = INVALID_NODE;
+  nodes[node].nextFree = head;
+  nodes[node].isFree = true;
+  if (head != INVALID_NODE)
+    nodes[head].prevFree = node;
+
+  freeLists[fl][sl] = node;
+  flBitmap |= uint64_t{1} << fl;
+  slBitmap[fl] |= 1u << sl;
+  freeBlockCount++;
+}
+
+void TlsfAllocator::removeFree(uint32_t node) {
+  uint32_t fl, sl;
+  mapping(nodes[node].size, fl, sl);
+
+  uint32_t prev = nodes[node].prevFree;
+  uint32_t next = nodes[node].nextFree;
+  if (prev != INVALID_NODE)
+    nodes[prev].nextFree = next;
+  else
+    freeLists[fl][sl] = next;
+  if (next != INVALID_NODE)
+    nodes[next].prevFree = prev;
+
+  if (freeLists[fl][sl] == INVALID_NODE) {
+    slBitmap[fl] &= ~(1u << sl);
+    if (slBitmap[fl] == 0)
+      flBitmap &= ~(uint64_t{1} << fl);
+  }
+
+  nodes[node].prevFree = INVALID_NODE;
+  nodes[node].nextFree = INVALID_NODE;
+  nodes[node].isFree = false;
+  freeBlockCount--;
+}
+
+uint32_t TlsfAllocator::splitOff(uint32_t node, uint64_t keep) {
+  uint32_t remainder = createNode();
+
+  nodes[remainder].offset = nodes[node].offset + keep;
+  nodes[remainder].size = nodes[node].size - keep;
+  nodes[remainder].prevPhysical = node;
+  nodes[remainder].nextPhysical = nodes[node].nextPhysical;
+  if (nodes[node].nextPhysical != INVALID_NODE)
+    nodes[nodes[node].nextPhysical].prevPhysical = remainder;
+
+  nodes[node].nextPhysical = remainder;
+  nodes[node].size = keep;
+  return remainder;
+}
+
+} // namespace engine
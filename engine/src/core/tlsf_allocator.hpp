@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+// Two-level segregated fit allocator over an abstract range [0, size).
+// It only hands out offsets, the caller decides what a unit is (vertices,
+// indices or bytes of a VkDeviceMemory block).
+class TlsfAllocator {
+public:
+  static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+  struct Allocation {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t node = INVALID_NODE;
+
+    bool isValid() const { return node != INVALID_NODE; }
+  };
+
+  struct Statistics {
+    uint64_t totalSize = 0;
+    uint64_t usedSize = 0;
+    uint64_t freeSize = 0;
+    uint64_t largestFreeBlock = 0;
+    uint32_t allocationCount = 0;
+    uint32_t freeBlockCount = 0;
+
+    // 0 if all free space is one block, towards 1 the more it is splintered
+    float fragmentation() const {
+      if (freeSize == 0)
+        return 0.f;
+      return 1.f - static_cast<float>(largestFreeBlock) /
+                       static_cast<float>(freeSize);
+    }
+  };
+
+  TlsfAllocator(uint64_t size);
+
+  TlsfAllocator(const TlsfAllocator &) = delete;
+  TlsfAllocator &operator=(const TlsfAllocator &) = delete;
+  TlsfAllocator(TlsfAllocator &&) = default;
+  TlsfAllocator &operator=(TlsfAllocator &&) = default;
+
+  bool allocate(uint64_t requestSize, Allocation &allocation,
+                uint64_t alignment = 1);
+  void free(Allocation &allocation);
+  void reset();
+
+  uint64_t getSize() const { return size; }
+  bool isEmpty() const { return allocationCount == 0; }
+  Statistics getStatistics() const;
+
+private:
+  static constexpr uint32_t SL_LOG2 = 5;
+  static constexpr uint32_t SL_COUNT = 1u << SL_LOG2;
+  static constexpr uint32_t FL_COUNT = 65 - SL_LOG2;
+
+  struct Node {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t prevPhysical = INVALID_NODE;
+    uint32_t nextPhysical = INVALID_NODE;
+    uint32_t prevFree = INVALID_NODE;
+    uint32_t nextFree = INVALID_NODE;
+    bool isFree = false;
+  };
+
+  uint64_t size;
+  uint64_t usedSize = 0;
+  uint32_t allocationCount = 0;
+  uint32_t freeBlockCount = 0;
+
+  uint64_t flBitmap = 0;
+  uint32_t slBitmap[FL_COUNT] = {};
+  uint32_t freeLists[FL_COUNT][SL_COUNT];
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> unusedNodes;
+
+  static void mapping(uint64_t size, uint32_t &fl, uint32_t &sl);
+  uint32_t findFreeNode(uint64_t requestSize, uint64_t alignment) const;
+  uint32_t findListAbove(uint64_t requestSize) const;
+  bool fits(uint32_t node, uint64_t requestSize, uint64_t alignment) const;
+
+  uint32_t createNode();
+  void releaseNode(uint32_t node);
+  void insertFree(uint32_t node);
+  void removeFree(uint32_t node);
+  uint32_t splitOff(uint32_t node, uint64_t keep);
+};
+
+} // namespace engine
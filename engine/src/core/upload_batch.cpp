@@ -0,0 +1,172 @@
+#include "upload_batch.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+UploadBatch::UploadBatch(Device &device) : device{device} {
+  commandBuffer =
+      device.allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    throw runtime_error("Failed to begin upload batch!");
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(device.device(), &fenceInfo, nullptr, &fence) !=
+      VK_SUCCESS)
+    throw runtime_error("Failed to create upload batch fence!");
+}
+
+UploadBatch::~UploadBatch() {
+  wait();
+  vkDestroyFence(device.device(), fence, nullptr);
+  vkFreeCommandBuffers(device.device(), device.getCommandPool(), 1,
+                       &commandBuffer);
+}
+
+void *UploadBatch::stage(VkDeviceSize size, VkBuffer &stagingBuffer,
+                         VkDeviceSize &stagingOffset, VkDeviceSize alignment) {
+  assert(!isSubmitted && "Upload batch was already submitted!");
+
+  if (!stagingBlocks.empty()) {
+    StagingBlock &block = stagingBlocks.back();
+    VkDeviceSize offset = (block.used + alignment - 1) / alignment * alignment;
+    if (offset + size <= block.buffer->getBufferSize()) {
+      block.used = offset + size;
+      stagingBuffer = block.buffer->getBuffer();
+      stagingOffset = offset;
+      return static_cast<char *>(block.buffer->mappedData()) + offset;
+    }
+  }
+
+  // Larger uploads get a block of their own
+  StagingBlock &block = stagingBlocks.emplace_back();
+  block.buffer = make_unique<Buffer>(
+      device, max(size, STAGING_BLOCK_SIZE), 1,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  block.buffer->map();
+  block.used = size;
+
+  stagingBuffer = block.buffer->getBuffer();
+  stagingOffset = 0;
+  return block.buffer->mappedData();
+}
+
+void UploadBatch::copyToBuffer(const void *data, VkDeviceSize size,
+                               VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+  VkBuffer stagingBuffer;
+  VkDeviceSize stagingOffset;
+  memcpy(stage(size, stagingBuffer, stagingOffset), data, size);
+  copyBuffer(stagingBuffer, dstBuffer, size, stagingOffset, dstOffset);
+}
+
+void UploadBatch::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
+                             VkDeviceSize size, VkDeviceSize srcOffset,
+                             VkDeviceSize dstOffset) {
+  assert(!isSubmitted && "Upload batch was already submitted!");
+
+  VkBufferCopy copyRegion = {};
+  copyRegion.srcOffset = srcOffset;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+}
+
+void UploadBatch::copyBufferToImage(VkBuffer buffer, VkImage image,
+                                    const vector<VkBufferImageCopy> &regions) {
+  assert(!isSubmitted && "Upload batch was already submitted!");
+
+  vkCmdCopyBufferToImage(commandBuffer, buffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+}
+
+void UploadBatch::transitionImageLayout(VkImage image,
+                                        VkImageLayout oldLayout,
+                                        VkImageLayout newLayout,
+                                        uint32_t layerCount,
+                                        uint32_t mipLevels) {
+  assert(!isSubmitted && "Upload batch was already submitted!");
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = mipLevels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = layerCount;
+
+  VkPipelineStageFlags sourceStage;
+  VkPipelineStageFlags destinationStage;
+
+  if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
+      newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
+             newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  } else {
+    throw std::invalid_argument("unsupported layout transition!");
+  }
+
+  vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0,
+                       nullptr, 0, nullptr, 1, &barrier);
+}
+
+void UploadBatch::submit() {
+  assert(!isSubmitted && "Upload batch was already submitted!");
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    throw runtime_error("Failed to record upload batch!");
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+
+  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, fence) !=
+      VK_SUCCESS)
+    throw runtime_error("Failed to submit upload batch!");
+  isSubmitted = true;
+}
+
+void UploadBatch::wait() {
+  if (!isSubmitted)
+    submit();
+  vkWaitForFences(device.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+}
+
+bool UploadBatch::isComplete() {
+  return isSubmitted &&
+         vkGetFenceStatus(device.device(), fence) == VK_SUCCESS;
+}
+
+} // namespace engine
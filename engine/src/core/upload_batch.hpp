@@ -0,0 +1,59 @@
+#pragma once
+#include "buffer.hpp"
+#include "device.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// Records copies and layout transitions into a single command buffer on the
+// graphics queue and submits them with one fence. Staging memory is owned
+// by the batch and lives until the batch completed. Destroying the batch
+// submits what is left and waits for it.
+class UploadBatch {
+public:
+  static constexpr VkDeviceSize STAGING_BLOCK_SIZE = 4 * 1024 * 1024;
+
+  explicit UploadBatch(Device &device);
+  ~UploadBatch();
+
+  UploadBatch(const UploadBatch &) = delete;
+  UploadBatch &operator=(const UploadBatch &) = delete;
+
+  // Host visible memory for size bytes, copy commands read it from
+  // stagingBuffer at stagingOffset
+  void *stage(VkDeviceSize size, VkBuffer &stagingBuffer,
+              VkDeviceSize &stagingOffset, VkDeviceSize alignment = 16);
+
+  void copyToBuffer(const void *data, VkDeviceSize size, VkBuffer dstBuffer,
+                    VkDeviceSize dstOffset = 0);
+  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size,
+                  VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
+  void copyBufferToImage(VkBuffer buffer, VkImage image,
+                         const std::vector<VkBufferImageCopy> &regions);
+  void transitionImageLayout(VkImage image, VkImageLayout oldLayout,
+                             VkImageLayout newLayout, uint32_t layerCount = 1,
+                             uint32_t mipLevels = 1);
+
+  // Nothing can be recorded afterwards
+  void submit();
+  void wait();
+  bool isComplete();
+
+private:
+  struct StagingBlock {
+    std::unique_ptr<Buffer> buffer;
+    VkDeviceSize used = 0;
+  };
+
+  Device &device;
+  VkCommandBuffer commandBuffer;
+  VkFence fence;
+  bool isSubmitted = false;
+
+  std::vector<StagingBlock> stagingBlocks;
+};
+
+} // namespace engine
@@ -0,0 +1,173 @@
+#include "upload_service.hpp"
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace std;
+
+namespace engine {
+
+UploadService::UploadService(Device &device) : device{device} {
+  VkSemaphoreTypeCreateInfo typeInfo = {};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr,
+                        &timelineSemaphore) != VK_SUCCESS)
+    throw runtime_error("Failed to create upload timeline semaphore!");
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = device.getTransferCommandPool();
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = COMMAND_BUFFER_COUNT;
+
+  if (vkAllocateCommandBuffers(device.device(), &allocInfo,
+                               commandBuffers.data()) != VK_SUCCESS)
+    throw runtime_error("Failed to allocate upload command buffers!");
+
+  uint32_t validBits = device.getTransferTimestampValidBits();
+  if (validBits == 0)
+    return;
+  timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = COMMAND_BUFFER_COUNT * 2;
+
+  if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &queryPool) !=
+      VK_SUCCESS)
+    throw runtime_error("Failed to create upload timestamp query pool!");
+}
+
+UploadService::~UploadService() {
+  wait(lastSubmittedValue());
+
+  vkFreeCommandBuffers(device.device(), device.getTransferCommandPool(),
+                       COMMAND_BUFFER_COUNT, commandBuffers.data());
+  vkDestroySemaphore(device.device(), timelineSemaphore, nullptr);
+  if (queryPool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(device.device(), queryPool, nullptr);
+}
+
+VkCommandBuffer UploadService::begin() {
+  assert(!isRecording && "Upload is already being recorded!");
+
+  if (!isComplete(submittedValues[currentCommandBuffer]))
+    return VK_NULL_HANDLE;
+
+  VkCommandBuffer commandBuffer = commandBuffers[currentCommandBuffer];
+  vkResetCommandBuffer(commandBuffer, 0);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    throw runtime_error("Failed to begin recording upload command buffer!");
+
+  if (queryPool != VK_NULL_HANDLE) {
+    // The previous submit of this command buffer is complete, so its
+    // results can be read before its queries are reset
+    collectTimings();
+    vkResetQueryPool(device.device(), queryPool, currentCommandBuffer * 2, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        queryPool, currentCommandBuffer * 2);
+  }
+
+  isRecording = true;
+  return commandBuffer;
+}
+
+uint64_t UploadService::submit() {
+  assert(isRecording && "No upload is being recorded!");
+
+  VkCommandBuffer commandBuffer = commandBuffers[currentCommandBuffer];
+  if (queryPool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queryPool, currentCommandBuffer * 2 + 1);
+    isTimed[currentCommandBuffer] = true;
+  }
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    throw runtime_error("Failed to record upload command buffer!");
+
+  uint64_t signalValue = nextValue++;
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &timelineSemaphore;
+
+  if (vkQueueSubmit(device.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) !=
+      VK_SUCCESS)
+    throw runtime_error("Failed to submit upload command buffer!");
+
+  submittedValues[currentCommandBuffer] = signalValue;
+  currentCommandBuffer = (currentCommandBuffer + 1) % COMMAND_BUFFER_COUNT;
+  isRecording = false;
+
+  return signalValue;
+}
+
+void UploadService::wait(uint64_t value) {
+  if (value == 0)
+    return;
+
+  VkSemaphoreWaitInfo waitInfo = {};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &timelineSemaphore;
+  waitInfo.pValues = &value;
+
+  vkWaitSemaphores(device.device(), &waitInfo, UINT64_MAX);
+}
+
+uint64_t UploadService::completedValue() {
+  uint64_t value = 0;
+  vkGetSemaphoreCounterValue(device.device(), timelineSemaphore, &value);
+  return value;
+}
+
+vector<double> UploadService::takeTimings() {
+  if (queryPool != VK_NULL_HANDLE)
+    collectTimings();
+  vector<double> finished;
+  finished.swap(timings);
+  return finished;
+}
+
+void UploadService::collectTimings() {
+  uint64_t completed = completedValue();
+  for (uint32_t i = 0; i < COMMAND_BUFFER_COUNT; i++) {
+    if (!isTimed[i] || submittedValues[i] > completed)
+      continue;
+    isTimed[i] = false;
+
+    uint64_t results[2];
+    if (vkGetQueryPoolResults(device.device(), queryPool, i * 2, 2,
+                              sizeof(results), results, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+      continue;
+    uint64_t ticks = (results[1] - results[0]) & timestampMask;
+    timings.push_back(static_cast<double>(ticks) *
+                      device.getTimestampPeriod() / 1e6);
+  }
+}
+
+} // namespace engine
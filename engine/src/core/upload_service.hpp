@@ -0,0 +1,55 @@
+#pragma once
+#include "device.hpp"
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+// Records copies for the transfer queue and signals a timeline semaphore
+// per submit. Callers poll completedValue() instead of waiting on a fence.
+class UploadService {
+public:
+  static constexpr uint32_t COMMAND_BUFFER_COUNT = 8;
+
+  UploadService(Device &device);
+  ~UploadService();
+
+  UploadService(const UploadService &) = delete;
+  UploadService &operator=(const UploadService &) = delete;
+
+  // Returns VK_NULL_HANDLE if every command buffer is still in flight
+  VkCommandBuffer begin();
+  uint64_t submit();
+  void wait(uint64_t value);
+
+  uint64_t completedValue();
+  bool isComplete(uint64_t value) { return value <= completedValue(); }
+  uint64_t lastSubmittedValue() const { return nextValue - 1; }
+  VkSemaphore getSemaphore() const { return timelineSemaphore; }
+
+  // Milliseconds the transfer queue spent on each submit that finished since
+  // the last call. Always empty if the transfer queue can't be timed.
+  std::vector<double> takeTimings();
+
+private:
+  Device &device;
+  VkSemaphore timelineSemaphore;
+  // Two timestamps per command buffer, around its copies
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  uint64_t timestampMask = 0;
+  std::array<bool, COMMAND_BUFFER_COUNT> isTimed{};
+  std::vector<double> timings;
+
+  std::array<VkCommandBuffer, COMMAND_BUFFER_COUNT> commandBuffers;
+  std::array<uint64_t, COMMAND_BUFFER_COUNT> submittedValues{};
+  uint32_t currentCommandBuffer = 0;
+  bool isRecording = false;
+
+  uint64_t nextValue = 1;
+
+  void collectTimings();
+};
+
+} // namespace engine
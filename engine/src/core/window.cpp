@@ -3,12 +3,15 @@
 
 namespace engine {
 
-Window::Window(int width, int height, std::string name)
-    : width(width), height(height), name(name) {
-  initWindow();
+Window::Window(int width, int height, std::string name, bool headless)
+    : width(width), height(height), headless(headless), name(name) {
+  if (!headless)
+    initWindow();
 }
 
 Window::~Window() {
+  if (headless)
+    return;
   glfwDestroyWindow(window);
   glfwTerminate();
 }
@@ -37,5 +40,10 @@ void Window::framebufferResizeCallback(GLFWwindow *window, int width,
   app->height = height;
 }
 
-void Window::close() { glfwSetWindowShouldClose(window, GLFW_TRUE); }
+void Window::close() {
+  if (headless)
+    closeRequested = true;
+  else
+    glfwSetWindowShouldClose(window, GLFW_TRUE);
+}
 } // namespace engine
@@ -12,10 +12,15 @@ namespace engine {
 
 class Window {
 public:
-  Window(int width, int height, std::string name);
+  // A headless window only carries the extent, nothing touches GLFW and no
+  // surface can be created for it
+  Window(int width, int height, std::string name, bool headless = false);
   ~Window();
 
-  bool shouldClose() { return glfwWindowShouldClose(window); }
+  bool shouldClose() {
+    return headless ? closeRequested : glfwWindowShouldClose(window);
+  }
+  bool isHeadless() const { return headless; }
 
   Window(const Window &) = delete;
   Window &operator=(const Window &) = delete;
@@ -26,6 +31,8 @@ public:
   GLFWwindow *getGLFWwindow() { return window; }
 
   void createSurface(VkInstance instance, VkSurfaceKHR *surface) {
+    if (headless)
+      throw std::runtime_error("Headless windows have no surface!");
     if (glfwCreateWindowSurface(instance, window, nullptr, surface) !=
         VK_SUCCESS)
       throw std::runtime_error("Surface Creation was unsuccessful");
@@ -42,9 +49,11 @@ private:
   int width;
   int height;
   bool framebufferResized = false;
+  bool headless;
+  bool closeRequested = false;
 
   std::string name;
-  GLFWwindow *window;
+  GLFWwindow *window = nullptr;
 
   static void framebufferResizeCallback(GLFWwindow *window, int width,
                                         int height);
@@ -0,0 +1,75 @@
+#include "input_recording.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace engine {
+
+namespace {
+
+constexpr char MAGIC[4] = {'V', 'K', 'I', 'R'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(VERSION);
+constexpr size_t RECORD_SIZE = 3 * sizeof(float) + sizeof(uint8_t);
+
+} // namespace
+
+InputRecorder::InputRecorder(const string &path)
+    : file{path, ios::binary | ios::trunc} {
+  if (!file)
+    throw runtime_error("Failed to open input recording " + path + "!");
+
+  file.write(MAGIC, sizeof(MAGIC));
+  file.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+}
+
+void InputRecorder::record(const InputFrame &frame) {
+  char record[RECORD_SIZE];
+  memcpy(record, &frame.deltaTime, sizeof(float));
+  memcpy(record + 4, &frame.input.cursorDeltaX, sizeof(float));
+  memcpy(record + 8, &frame.input.cursorDeltaY, sizeof(float));
+  record[12] = static_cast<char>(frame.input.keys);
+  file.write(record, RECORD_SIZE);
+}
+
+InputReplay::InputReplay(const string &path) {
+  ifstream file(path, ios::binary);
+  if (!file)
+    throw runtime_error("Failed to open input recording " + path + "!");
+
+  vector<char> data{istreambuf_iterator<char>(file),
+                    istreambuf_iterator<char>()};
+
+  uint32_t version = 0;
+  if (data.size() >= HEADER_SIZE)
+    memcpy(&version, data.data() + sizeof(MAGIC), sizeof(version));
+  if (data.size() < HEADER_SIZE ||
+      memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0 || version != VERSION)
+    throw runtime_error(path + " is not an input recording!");
+
+  // A trailing partial record from an interrupted run is dropped
+  size_t frameCount = (data.size() - HEADER_SIZE) / RECORD_SIZE;
+  frames.resize(frameCount);
+  for (size_t i = 0; i < frameCount; i++) {
+    const char *record = data.data() + HEADER_SIZE + i * RECORD_SIZE;
+    memcpy(&frames[i].deltaTime, record, sizeof(float));
+    memcpy(&frames[i].input.cursorDeltaX, record + 4, sizeof(float));
+    memcpy(&frames[i].input.cursorDeltaY, record + 8, sizeof(float));
+    frames[i].input.keys = static_cast<uint8_t>(record[12]);
+  }
+}
+
+bool InputReplay::next(InputFrame &frame) {
+  if (nextFrame == frames.size())
+    return false;
+  frame = frames[nextFrame++];
+  return true;
+}
+
+} // namespace engine
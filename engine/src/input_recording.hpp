@@ -0,0 +1,45 @@
+#pragma once
+#include "movement_controller.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+struct InputFrame {
+  float deltaTime;
+  InputState input;
+};
+
+// Appends one 13 byte record per frame behind a small header. Values are
+// stored in host byte order.
+class InputRecorder {
+public:
+  explicit InputRecorder(const std::string &path);
+
+  InputRecorder(const InputRecorder &) = delete;
+  InputRecorder &operator=(const InputRecorder &) = delete;
+
+  void record(const InputFrame &frame);
+
+private:
+  std::ofstream file;
+};
+
+// Loads a whole recording up front, so replaying touches no file
+class InputReplay {
+public:
+  explicit InputReplay(const std::string &path);
+
+  // False once every recorded frame was handed out
+  bool next(InputFrame &frame);
+  size_t getFrameCount() const { return frames.size(); }
+
+private:
+  std::vector<InputFrame> frames;
+  size_t nextFrame = 0;
+};
+
+} // namespace engine
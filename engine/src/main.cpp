@@ -1,8 +1,68 @@
 #include "app.hpp"
+#include "core/cpu_profiler.hpp"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
 
-int main() {
-  engine::App app{};
+namespace {
+
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--headless] [--frames <count>] [--capture <file.ppm>]"
+               " [--record <file> | --replay <file> [--report <file.csv>]]"
+               " [--terrain-budget <MB>] [--cpu-trace <file.json>]\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  engine::AppOptions options{};
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--headless") == 0) {
+      options.headless = true;
+    } else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+      options.frameLimit = std::strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--capture") == 0 && hasValue) {
+      options.capturePath = argv[++i];
+    } else if (strcmp(argv[i], "--record") == 0 && hasValue) {
+      options.recordPath = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && hasValue) {
+      options.replayPath = argv[++i];
+    } else if (strcmp(argv[i], "--report") == 0 && hasValue) {
+      options.reportPath = argv[++i];
+    } else if (strcmp(argv[i], "--cpu-trace") == 0 && hasValue) {
+      options.cpuTracePath = argv[++i];
+    } else if (strcmp(argv[i], "--terrain-budget") == 0 && hasValue) {
+      options.terrainBudget =
+          std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+    } else {
+      printUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // A headless run cannot be closed by hand, replays end with the recording
+  if (options.headless && options.frameLimit == 0 &&
+      options.replayPath.empty())
+    options.frameLimit = 1000;
+  if (!options.recordPath.empty() && !options.replayPath.empty()) {
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (!options.capturePath.empty() && !options.headless) {
+    std::cerr << "--capture needs --headless\n";
+    return EXIT_FAILURE;
+  }
+
+  if (!options.cpuTracePath.empty() && !engine::CpuProfiler::ENABLED) {
+    std::cerr << "--cpu-trace needs a build without NDEBUG, release builds "
+                 "compile the profiler out\n";
+    return EXIT_FAILURE;
+  }
+
+  engine::App app{options};
 
   try {
     app.run();
@@ -1,52 +1,68 @@
 #include "movement_controller.hpp"
+#include "world_view.hpp"
 #include <GLFW/glfw3.h>
 #include <algorithm>
 #include <glm/ext/vector_float3.hpp>
+#include <mutex>
 #include <unordered_map>
 
 using namespace std;
 namespace engine {
 
-void MovementController::move(GLFWwindow *window, Player &player,
-                              unordered_map<int, Chunk> &chunks, float dt) {
-  if (firstMouse) {
-    glfwGetCursorPos(window, &mouseX, &mouseY);
-    firstMouse = false;
-    return;
+InputState MovementController::pollInput(GLFWwindow *window) {
+  InputState input{};
+
+  double newMouseX, newMouseY;
+  glfwGetCursorPos(window, &newMouseX, &newMouseY);
+  if (!firstMouse) {
+    input.cursorDeltaX = static_cast<float>(newMouseX - mouseX);
+    input.cursorDeltaY = static_cast<float>(newMouseY - mouseY);
   }
+  firstMouse = false;
+  mouseX = newMouseX;
+  mouseY = newMouseY;
 
-  handleInput(window, player, dt);
-  predictMovement(player, dt);
+  if (glfwGetKey(window, keys.forward) == GLFW_PRESS)
+    input.keys |= InputState::Forward;
+  if (glfwGetKey(window, keys.backward) == GLFW_PRESS)
+    input.keys |= InputState::Backward;
+  if (glfwGetKey(window, keys.left) == GLFW_PRESS)
+    input.keys |= InputState::Left;
+  if (glfwGetKey(window, keys.right) == GLFW_PRESS)
+    input.keys |= InputState::Right;
+  if (glfwGetKey(window, keys.up) == GLFW_PRESS)
+    input.keys |= InputState::Up;
+  if (glfwGetKey(window, keys.down) == GLFW_PRESS)
+    input.keys |= InputState::Down;
 
-  auto blocks = player.getBlocksAround(chunks);
+  return input;
+}
 
-  for (auto &block : blocks) {
-    bool isColliding =
-        player.collider.checkCollision(block.collider.collisionBox);
-    if (isColliding) {
-      auto collision =
-          player.collider.resolveCollision(block.collider.collisionBox);
-      if (collision.direction.x != 0.f) {
-        player.rigidBody.velocity.x = 0.f;
-      }
-      if (collision.direction.z != 0.f) {
-        player.rigidBody.velocity.z = 0.f;
-      }
-    }
-  }
-};
+void MovementController::move(const InputState &input, Player &player,
+                              unordered_map<int, Chunk> &chunks,
+                              mutex &positionMutex, float dt) {
+  handleInput(input, player, dt);
 
-void MovementController::handleInput(GLFWwindow *window, Player &player,
-                                     float dt) {
-  double newMouseX, newMouseY;
-  glfwGetCursorPos(window, &newMouseX, &newMouseY);
+  SweepResult sweep = sweepBox(WorldView{chunks}, player.getCollisionBox(),
+                               player.rigidBody.velocity * dt);
+  {
+    lock_guard<mutex> lock(positionMutex);
+    player.transform.position += sweep.displacement;
+  }
+  player.collider.collisionBox = player.getCollisionBox();
 
-  double deltaX = newMouseX - mouseX;
-  double deltaY = newMouseY - mouseY;
+  player.canJump = sweep.blocked.y && player.rigidBody.velocity.y < 0.f;
+  for (int axis = 0; axis < 3; axis++) {
+    if (sweep.blocked[axis])
+      player.rigidBody.velocity[axis] = 0.f;
+  }
+}
 
+void MovementController::handleInput(const InputState &input, Player &player,
+                                     float dt) {
   glm::vec3 rotateDirection{0.f};
-  rotateDirection.y = deltaX * dt;
-  rotateDirection.x = deltaY * dt;
+  rotateDirection.y = input.cursorDeltaX * dt;
+  rotateDirection.x = input.cursorDeltaY * dt;
 
   player.transform.rotation += rotateDirection;
   player.transform.rotation.x =
@@ -59,15 +75,15 @@ void MovementController::handleInput(GLFWwindow *window, Player &player,
   const glm::vec3 rightDirection{forwardDirection.z, 0, -forwardDirection.x};
 
   glm::vec3 moveDirection{0.f};
-  if (glfwGetKey(window, keys.left) == GLFW_PRESS)
+  if (input.isPressed(InputState::Left))
     moveDirection -= rightDirection;
-  if (glfwGetKey(window, keys.right) == GLFW_PRESS)
+  if (input.isPressed(InputState::Right))
     moveDirection += rightDirection;
-  if (glfwGetKey(window, keys.forward) == GLFW_PRESS)
+  if (input.isPressed(InputState::Forward))
     moveDirection += forwardDirection;
-  if (glfwGetKey(window, keys.backward) == GLFW_PRESS)
+  if (input.isPressed(InputState::Backward))
     moveDirection -= forwardDirection;
-  if (glfwGetKey(window, keys.up) == GLFW_PRESS) {
+  if (input.isPressed(InputState::Up)) {
     if (player.canJump) {
       player.rigidBody.applyForce({0.f, 10.f, 0.f});
       player.canJump = false;
@@ -76,16 +92,6 @@ void MovementController::handleInput(GLFWwindow *window, Player &player,
 
   player.rigidBody.velocity.x = moveDirection.x * 10.f;
   player.rigidBody.velocity.z = moveDirection.z * 10.f;
-
-  mouseX = newMouseX;
-  mouseY = newMouseY;
-}
-
-void MovementController::predictMovement(Player &player, float dt) {
-  player.collider.collisionBox.min =
-      player.collider.collisionBox.min + player.rigidBody.velocity * dt;
-  player.collider.collisionBox.max =
-      player.collider.collisionBox.max + player.rigidBody.velocity * dt;
 }
 
 } // namespace engine
@@ -1,9 +1,31 @@
 #include "core/game_object.hpp"
 #include "player.hpp"
 #include <GLFW/glfw3.h>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
 
 namespace engine {
 
+// Everything the controller reads from GLFW in one frame, so frames can be
+// recorded and replayed without a window
+struct InputState {
+  enum Key : uint8_t {
+    Forward = 1 << 0,
+    Backward = 1 << 1,
+    Left = 1 << 2,
+    Right = 1 << 3,
+    Up = 1 << 4,
+    Down = 1 << 5,
+  };
+
+  float cursorDeltaX = 0.f;
+  float cursorDeltaY = 0.f;
+  uint8_t keys = 0;
+
+  bool isPressed(Key key) const { return keys & key; }
+};
+
 class MovementController {
 public:
   struct KeyMapping {
@@ -15,16 +37,21 @@ public:
     int down = GLFW_KEY_LEFT_SHIFT;
   };
 
-  void move(GLFWwindow *window, Player &player,
-            std::unordered_map<int, Chunk> &chunks, float dt);
+  // Cursor movement since the last call, none on the first
+  InputState pollInput(GLFWwindow *window);
+  // Applies the input and moves the player by its velocity, stopped by
+  // solid blocks. The position is written under positionMutex, the chunk
+  // thread reads it under the same mutex.
+  void move(const InputState &input, Player &player,
+            std::unordered_map<int, Chunk> &chunks, std::mutex &positionMutex,
+            float dt);
 
 private:
   KeyMapping keys{};
   double mouseX, mouseY;
   bool firstMouse = true;
 
-  void handleInput(GLFWwindow *window, Player &player, float dt);
-  void predictMovement(Player &player, float dt);
+  void handleInput(const InputState &input, Player &player, float dt);
 };
 
 } // namespace engine
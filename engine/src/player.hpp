@@ -3,16 +3,13 @@
 #include "collision.hpp"
 #include "core/rigidbody3d.hpp"
 #include <glm/fwd.hpp>
-#include <unordered_map>
-#include <vector>
 
 namespace engine {
 
 class Player : public GameObject {
 public:
-  Block getBlockBeneath(const std::unordered_map<int, Chunk> &chunks);
-  std::vector<Block>
-  getBlocksAround(const std::unordered_map<int, Chunk> &chunks);
+  // Centered on the position horizontally, standing on it vertically
+  CollisionBox3D getCollisionBox() const;
 
   bool canJump = false;
 
@@ -2,3 +2,6 @@ glslc src/shaders/shader.vert -o src/shaders/shader.vert.spv
 glslc src/shaders/shader.frag -o src/shaders/shader.frag.spv
 glslc  src/shaders/terrain_control.tesc -o src/shaders/terrain_control.spv
 glslc  src/shaders/terrain_evaluation.tese -o src/shaders/terrain_evaluation.spv
+glslc  src/shaders/cull.comp -o src/shaders/cull.comp.spv
+glslc  src/shaders/hiz_build.comp -o src/shaders/hiz_build.comp.spv
+glslc  src/shaders/terrain.vert -o src/shaders/terrain.vert.spv
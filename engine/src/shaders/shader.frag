@@ -4,11 +4,11 @@ layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 fragPositionWorld;
 layout(location = 2) in vec3 fragNormalWorld;
 layout(location = 3) in vec2 fragTexCoord;
+layout(location = 4) flat in uint fragTextureLayer;
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 2) uniform sampler2D textureSampler;
-layout(binding = 3) uniform sampler2D topSampler;
+layout(binding = 2) uniform sampler2DArray blockTextures;
 
 layout(set = 0, binding = 0) uniform GlobalUbo{
   mat4 projectionMatrix;
@@ -28,10 +28,6 @@ void main() {
   vec3 diffuseLight = lightColor * attenuation;
 
   vec3 ambientLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
-  if (fragNormalWorld.y > 0.0) {
-    outColor = texture(topSampler, fragTexCoord) * vec4((ambientLight + diffuseLight), 1.0f);
-  } else {
-    outColor = texture(textureSampler, fragTexCoord) * vec4((ambientLight + diffuseLight), 1.0f);
-  }
-
+  vec4 albedo = texture(blockTextures, vec3(fragTexCoord, fragTextureLayer));
+  outColor = albedo * vec4((ambientLight + diffuseLight), 1.0f);
 }
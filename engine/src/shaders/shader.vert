@@ -9,11 +9,13 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec3 inNormal;
 layout(location = 3) in vec2 inTexCoord;
+layout(location = 4) in uint inTextureLayer;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPositionWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 layout(location = 3) out vec2 fragTexCoord;
+layout(location = 4) flat out uint fragTextureLayer;
 
 layout(set = 0, binding = 0) uniform GlobalUbo{
   mat4 projectionMatrix;
@@ -35,4 +37,5 @@ void main() {
   gl_Position = ubo.projectionMatrix * worldPosition;
   fragColor = inColor;
   fragTexCoord = inTexCoord;
+  fragTextureLayer = inTextureLayer;
 }
@@ -0,0 +1,43 @@
+#version 460
+
+struct ChunkDrawData {
+    ivec3 origin;
+    uint lod;
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec2 inTexCoord;
+layout(location = 4) in uint inTextureLayer;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPositionWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragTexCoord;
+layout(location = 4) flat out uint fragTextureLayer;
+
+layout(set = 0, binding = 0) uniform GlobalUbo{
+  mat4 projectionMatrix;
+  vec4 ambientLightColor;
+  vec3 lightPosition;
+  vec4 lightColor;
+} ubo;
+
+layout(set = 0, binding = 1) readonly buffer DrawDataBuffer {
+  ChunkDrawData data[];
+} drawDataBuffer;
+
+void main() {
+  // Chunks are only ever translated, so normals stay in world space
+  vec3 origin = vec3(drawDataBuffer.data[gl_InstanceIndex].origin);
+  vec4 worldPosition = vec4(inPosition + origin, 1.0);
+
+  fragNormalWorld = normalize(inNormal);
+  fragPositionWorld = worldPosition.xyz;
+
+  gl_Position = ubo.projectionMatrix * worldPosition;
+  fragColor = inColor;
+  fragTexCoord = inTexCoord;
+  fragTextureLayer = inTextureLayer;
+}
@@ -0,0 +1,101 @@
+#include "voxel_raycast.hpp"
+#include "chunk.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace engine {
+
+RayHit raycast(const WorldView &world, const Ray &ray) {
+  RayHit hit;
+  float length = glm::length(ray.direction);
+  if (length == 0.f)
+    return hit;
+  glm::vec3 direction = ray.direction / length;
+
+  // Distance to the next block boundary (tMax) and between two boundaries
+  // (tDelta) per axis
+  glm::ivec3 block{glm::floor(ray.origin)};
+  glm::ivec3 step{0};
+  glm::vec3 tMax{INFINITY};
+  glm::vec3 tDelta{INFINITY};
+  for (int axis = 0; axis < 3; axis++) {
+    if (direction[axis] > 0.f) {
+      step[axis] = 1;
+      tDelta[axis] = 1.f / direction[axis];
+      tMax[axis] = (block[axis] + 1 - ray.origin[axis]) * tDelta[axis];
+    } else if (direction[axis] < 0.f) {
+      step[axis] = -1;
+      tDelta[axis] = -1.f / direction[axis];
+      tMax[axis] = (ray.origin[axis] - block[axis]) * tDelta[axis];
+    }
+  }
+
+  glm::ivec3 chunkCoords = WorldView::toChunk(block);
+  const Chunk *chunk = world.getChunk(chunkCoords);
+  glm::ivec3 face{0};
+  float distance = 0.f;
+  while (distance <= ray.maxDistance) {
+    glm::ivec3 blockChunk = WorldView::toChunk(block);
+    if (blockChunk != chunkCoords) {
+      chunkCoords = blockChunk;
+      chunk = world.getChunk(chunkCoords);
+    }
+
+    if (chunk != nullptr) {
+      glm::ivec3 local = WorldView::toLocal(block);
+      BlockType type = chunk->getBlock(local.x, local.y, local.z);
+      if (type != BlockType::Air) {
+        hit.hit = true;
+        hit.block = block;
+        hit.face = face;
+        hit.distance = distance;
+        hit.type = type;
+        return hit;
+      }
+    }
+
+    int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2)
+                               : (tMax.y < tMax.z ? 1 : 2);
+    distance = tMax[axis];
+    tMax[axis] += tDelta[axis];
+    block[axis] += step[axis];
+    face = glm::ivec3{0};
+    face[axis] = -step[axis];
+  }
+
+  return hit;
+}
+
+void raycast(const WorldView &world, const Ray *rays, size_t count,
+             RayHit *hits) {
+  for (size_t i = 0; i < count; i++)
+    hits[i] = raycast(world, rays[i]);
+}
+
+void raycast(const unordered_map<int, Chunk> &chunks, const Ray *rays,
+             size_t count, RayHit *hits, unsigned threadCount) {
+  size_t threads = clamp<size_t>(threadCount, 1, max<size_t>(count, 1));
+  size_t share = (count + threads - 1) / threads;
+
+  vector<thread> workers;
+  for (size_t first = share; first < count; first += share) {
+    size_t length = min(share, count - first);
+    workers.emplace_back([&chunks, rays, hits, first, length] {
+      raycast(WorldView{chunks}, rays + first, length, hits + first);
+    });
+  }
+  raycast(WorldView{chunks}, rays, min(share, count), hits);
+
+  for (thread &worker : workers)
+    worker.join();
+}
+
+} // namespace engine
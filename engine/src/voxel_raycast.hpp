@@ -0,0 +1,47 @@
+#pragma once
+#include "block.hpp"
+#include "chunk.hpp"
+#include "world_view.hpp"
+#include <cstddef>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <unordered_map>
+
+namespace engine {
+
+struct Ray {
+  glm::vec3 origin;
+  // Needs no normalizing, distances are in blocks either way
+  glm::vec3 direction;
+  // Has to be finite, the walk through air only ends here
+  float maxDistance;
+};
+
+struct RayHit {
+  bool hit = false;
+  glm::ivec3 block{0};
+  // Outward normal of the face the ray entered through, zero for a ray
+  // that starts inside a solid block
+  glm::ivec3 face{0};
+  float distance = 0.f;
+  BlockType type{BlockType::Air};
+};
+
+// Walks the blocks along the ray (Amanatides and Woo) until the first solid
+// one. The chunk pointer is only looked up again when the ray crosses into
+// another chunk. Only reads the world, so worker threads can cast rays
+// while nothing modifies the chunk map, each with its own WorldView.
+RayHit raycast(const WorldView &world, const Ray &ray);
+// Rays in a batch share the view's chunk cache, so coherent rays (e.g. from
+// one origin) mostly skip the hash lookup
+void raycast(const WorldView &world, const Ray *rays, size_t count,
+             RayHit *hits);
+// Splits the batch into threadCount runs of rays, each cast on its own
+// thread through its own WorldView, the first on the calling thread.
+// Returns once all are cast. chunks must not change meanwhile: App inserts
+// and erases chunks on the main thread under queueMutex, so call this from
+// the main thread or hold queueMutex for the whole call.
+void raycast(const std::unordered_map<int, Chunk> &chunks, const Ray *rays,
+             size_t count, RayHit *hits, unsigned threadCount);
+
+} // namespace engine
@@ -0,0 +1,51 @@
+#include "world_view.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <glm/ext/vector_int3.hpp>
+#include <vector>
+
+using namespace std;
+
+namespace engine {
+
+const Chunk *WorldView::getChunk(const glm::ivec3 &chunk) const {
+  if (hasCachedChunk && cachedCoords == chunk)
+    return cachedChunk;
+
+  auto it = chunks.find(getChunkKey(chunk));
+  cachedChunk = it == chunks.end() ? nullptr : &it->second;
+  cachedCoords = chunk;
+  hasCachedChunk = true;
+  return cachedChunk;
+}
+
+void WorldView::copyRegion(const glm::ivec3 &min, const glm::ivec3 &size,
+                           vector<BlockType> &out) const {
+  out.assign(static_cast<size_t>(max(size.x, 0)) * max(size.y, 0) *
+                 max(size.z, 0),
+             BlockType{BlockType::Air});
+
+  forEachChunkSpan(
+      min, min + size - 1,
+      [&](const Chunk *chunk, const glm::ivec3 &origin, const glm::ivec3 &from,
+          const glm::ivec3 &to) {
+        // Chunks that are all air store a single block
+        if (chunk == nullptr ||
+            chunk->blocks.size() != CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+          return;
+
+        for (int y = from.y; y <= to.y; y++) {
+          for (int z = from.z; z <= to.z; z++) {
+            glm::ivec3 target = origin + glm::ivec3{from.x, y, z} - min;
+            size_t offset =
+                target.x +
+                (target.z + static_cast<size_t>(target.y) * size.z) * size.x;
+            auto row = chunk->blocks.begin() + from.x + z * CHUNK_SIZE +
+                       y * CHUNK_SIZE * CHUNK_SIZE;
+            copy(row, row + (to.x - from.x + 1), out.begin() + offset);
+          }
+        }
+      });
+}
+
+} // namespace engine
@@ -0,0 +1,98 @@
+#pragma once
+#include "block.hpp"
+#include "chunk.hpp"
+#include <algorithm>
+#include <glm/common.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+// Block queries in world coordinates across chunk borders, without
+// exceptions. Blocks of chunks that are not loaded read as air. The chunk
+// of the last query is remembered, so runs of nearby queries skip the hash
+// lookup. Meant to live for one batch of queries, it is not told when
+// chunks are inserted or erased.
+class WorldView {
+public:
+  static constexpr int CHUNK_SIZE = 32;
+
+  explicit WorldView(const std::unordered_map<int, Chunk> &chunks)
+      : chunks{chunks} {}
+
+  // Arithmetic shifts round negative coordinates down as well
+  static glm::ivec3 toChunk(const glm::ivec3 &position) {
+    return {position.x >> 5, position.y >> 5, position.z >> 5};
+  }
+  static glm::ivec3 toLocal(const glm::ivec3 &position) {
+    return {position.x & 31, position.y & 31, position.z & 31};
+  }
+
+  // Null if the chunk is not loaded
+  const Chunk *getChunk(const glm::ivec3 &chunk) const;
+  BlockType getBlock(const glm::ivec3 &position) const {
+    const Chunk *chunk = getChunk(toChunk(position));
+    if (chunk == nullptr)
+      return BlockType{BlockType::Air};
+    glm::ivec3 local = toLocal(position);
+    return chunk->getBlock(local.x, local.y, local.z);
+  }
+
+  // Calls f(position, type) for every block the box overlaps, touching
+  // faces don't count. Visits chunk by chunk, one lookup each.
+  template <typename F>
+  void forEachBlockInAABB(const glm::vec3 &min, const glm::vec3 &max,
+                          F &&f) const {
+    glm::ivec3 first{glm::floor(min)};
+    glm::ivec3 last = glm::ivec3{glm::ceil(max)} - 1;
+    forEachChunkSpan(first, last,
+                     [&](const Chunk *chunk, const glm::ivec3 &origin,
+                         const glm::ivec3 &from, const glm::ivec3 &to) {
+                       for (int y = from.y; y <= to.y; y++)
+                         for (int z = from.z; z <= to.z; z++)
+                           for (int x = from.x; x <= to.x; x++)
+                             f(origin + glm::ivec3{x, y, z},
+                               chunk ? chunk->getBlock(x, y, z)
+                                     : BlockType{BlockType::Air});
+                     });
+  }
+
+  // Copies the blocks of [min, min + size) into out, x first, then z, then
+  // y like Chunk::blocks
+  void copyRegion(const glm::ivec3 &min, const glm::ivec3 &size,
+                  std::vector<BlockType> &out) const;
+
+private:
+  const std::unordered_map<int, Chunk> &chunks;
+
+  mutable const Chunk *cachedChunk = nullptr;
+  mutable glm::ivec3 cachedCoords{};
+  mutable bool hasCachedChunk = false;
+
+  // Calls f(chunk, chunk origin, first local block, last local block) for
+  // every chunk the inclusive block range [first, last] touches
+  template <typename F>
+  void forEachChunkSpan(const glm::ivec3 &first, const glm::ivec3 &last,
+                        F &&f) const {
+    if (first.x > last.x || first.y > last.y || first.z > last.z)
+      return;
+
+    glm::ivec3 firstChunk = toChunk(first);
+    glm::ivec3 lastChunk = toChunk(last);
+    for (int cy = firstChunk.y; cy <= lastChunk.y; cy++) {
+      for (int cz = firstChunk.z; cz <= lastChunk.z; cz++) {
+        for (int cx = firstChunk.x; cx <= lastChunk.x; cx++) {
+          glm::ivec3 chunk{cx, cy, cz};
+          glm::ivec3 origin = chunk * CHUNK_SIZE;
+          glm::ivec3 from = glm::max(first - origin, glm::ivec3{0});
+          glm::ivec3 to = glm::min(last - origin, glm::ivec3{CHUNK_SIZE - 1});
+          f(getChunk(chunk), origin, from, to);
+        }
+      }
+    }
+  }
+};
+
+} // namespace engine
@@ -0,0 +1,24 @@
+#pragma once
+#include <iostream>
+
+namespace engine {
+
+// Failed checks of the running test, main returns whether there were any
+inline int testFailures = 0;
+
+inline void check(bool condition, const char *what) {
+  if (condition)
+    return;
+  std::cout << "FAILED: " << what << std::endl;
+  testFailures++;
+}
+
+inline int finishTest(const char *name) {
+  if (testFailures == 0)
+    std::cout << name << ": passed" << std::endl;
+  else
+    std::cout << name << ": " << testFailures << " failed" << std::endl;
+  return testFailures == 0 ? 0 : 1;
+}
+
+} // namespace engine
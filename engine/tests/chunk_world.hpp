@@ -0,0 +1,38 @@
+#pragma once
+#include "block.hpp"
+#include "chunk.hpp"
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+// Chunks firstChunk to lastChunk included on every axis, with Stone in the
+// blocks isSolid returns true for and Air elsewhere
+template <typename F>
+std::unordered_map<int, Chunk> makeWorld(F &&isSolid,
+                                         const glm::ivec3 &firstChunk,
+                                         const glm::ivec3 &lastChunk) {
+  std::unordered_map<int, Chunk> chunks;
+  for (int cy = firstChunk.y; cy <= lastChunk.y; cy++) {
+    for (int cz = firstChunk.z; cz <= lastChunk.z; cz++) {
+      for (int cx = firstChunk.x; cx <= lastChunk.x; cx++) {
+        glm::ivec3 origin = glm::ivec3{cx, cy, cz} * 32;
+        std::vector<BlockType> blocks;
+        for (int y = 0; y < 32; y++)
+          for (int z = 0; z < 32; z++)
+            for (int x = 0; x < 32; x++)
+              blocks.push_back(
+                  BlockType{isSolid(origin + glm::ivec3{x, y, z})
+                                ? BlockType::Stone
+                                : BlockType::Air});
+        glm::vec3 position{origin};
+        chunks.insert({getChunkKey({cx, cy, cz}), Chunk{blocks, position}});
+      }
+    }
+  }
+  return chunks;
+}
+
+} // namespace engine
@@ -0,0 +1,140 @@
+#include "block.hpp"
+#include "check.hpp"
+#include "chunk.hpp"
+#include "chunk_world.hpp"
+#include "collision.hpp"
+#include "world_view.hpp"
+#include <cmath>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <random>
+#include <unordered_map>
+
+using namespace std;
+using namespace engine;
+
+namespace {
+
+constexpr int FLOOR_TOP = 16;
+constexpr int WALL_X = 20;
+
+// Solid below FLOOR_TOP, plus a wall one block thick at WALL_X that stands
+// 16 blocks on the floor
+bool isSolid(const glm::ivec3 &block) {
+  return block.y < FLOOR_TOP ||
+         (block.x == WALL_X && block.y < FLOOR_TOP + 16);
+}
+
+// Player sized, standing on min
+CollisionBox3D boxAt(const glm::vec3 &min) {
+  return {min, min + glm::vec3{0.8f, 2.f, 0.8f}};
+}
+
+bool isNear(float a, float b) { return abs(a - b) < 1e-4f; }
+
+// Whether a solid block overlaps the box by more than depth
+bool overlapsSolid(const WorldView &world, const CollisionBox3D &box,
+                   float depth) {
+  bool solid = false;
+  world.forEachBlockInAABB(box.min + depth, box.max - depth,
+                           [&](const glm::ivec3 &, BlockType type) {
+                             solid = solid || type != BlockType::Air;
+                           });
+  return solid;
+}
+
+void testLanding(const WorldView &world) {
+  for (glm::vec3 start :
+       {glm::vec3{0.1f, 40.f, 0.1f}, glm::vec3{-40.5f, 40.f, -33.9f}}) {
+    SweepResult fall = sweepBox(world, boxAt(start), {0.f, -20.f, 0.f});
+    check(!fall.blocked.y && isNear(fall.displacement.y, -20.f),
+          "a fall that ends above the floor is not blocked");
+
+    SweepResult land = sweepBox(world, boxAt(start), {0.f, -30.f, 0.f});
+    check(land.blocked.y && isNear(land.displacement.y, FLOOR_TOP - 40.f),
+          "landing on the floor sets blocked.y and stops on its top");
+
+    SweepResult rest = sweepBox(world, boxAt({start.x, 16.f, start.z}),
+                                {0.f, -0.1f, 0.f});
+    check(rest.blocked.y && rest.displacement.y == 0.f,
+          "a box resting on the floor stays blocked");
+  }
+}
+
+void testNoTunnelling(const WorldView &world) {
+  SweepResult fall = sweepBox(world, boxAt({-10.3f, 60.f, -50.6f}),
+                              {0.f, -1000.f, 0.f});
+  check(fall.blocked.y && isNear(fall.displacement.y, FLOOR_TOP - 60.f),
+        "a fall of 1000 blocks in one step stops on the floor");
+
+  SweepResult run = sweepBox(world, boxAt({10.f, 16.f, -3.5f}),
+                             {500.f, 0.f, 0.f});
+  check(run.blocked.x && isNear(run.displacement.x, WALL_X - 10.8f),
+        "a 500 block step stops at a wall one block thick");
+
+  SweepResult back = sweepBox(world, boxAt({30.f, 16.f, -3.5f}),
+                              {-500.f, 0.f, 0.f});
+  check(back.blocked.x && isNear(back.displacement.x, WALL_X + 1 - 30.f),
+        "a 500 block step back stops at the wall's other face");
+
+  // Starts clear of every block, moves up to 200 blocks on all axes at once
+  mt19937 random{49};
+  uniform_real_distribution<float> x{-60.f, 60.f};
+  uniform_real_distribution<float> y{16.f, 60.f};
+  uniform_real_distribution<float> distance{-200.f, 200.f};
+  bool neverInside = true;
+  for (int i = 0; i < 2000; i++) {
+    CollisionBox3D box = boxAt({x(random), y(random), x(random)});
+    if (overlapsSolid(world, box, 0.f))
+      continue;
+
+    glm::vec3 displacement{distance(random), distance(random),
+                           distance(random)};
+    SweepResult sweep = sweepBox(world, box, displacement);
+    CollisionBox3D moved{box.min + sweep.displacement,
+                         box.max + sweep.displacement};
+    // Within the sweep's 1e-3 tolerance
+    neverInside = neverInside && !overlapsSolid(world, moved, 2e-3f);
+    for (int axis = 0; axis < 3; axis++)
+      neverInside = neverInside && abs(sweep.displacement[axis]) <=
+                                       abs(displacement[axis]);
+  }
+  check(neverInside, "random long sweeps never end inside a block");
+}
+
+void testMovesOutOfOverlap(const WorldView &world) {
+  SweepResult up =
+      sweepBox(world, boxAt({-5.f, FLOOR_TOP - 1.5f, 5.f}), {0.f, 10.f, 0.f});
+  check(!up.blocked.y && isNear(up.displacement.y, 10.f),
+        "a box half sunk in the floor moves up out of it");
+
+  for (float distance : {5.f, -5.f}) {
+    SweepResult out = sweepBox(world, boxAt({WALL_X + 0.5f, 16.f, -40.f}),
+                               {distance, 0.f, 0.f});
+    check(!out.blocked.x && isNear(out.displacement.x, distance),
+          "a box inside the wall moves out of it either way");
+  }
+
+  // Less than the 1e-3 tolerance deep, the floor still holds the box
+  CollisionBox3D sunk = boxAt({0.f, FLOOR_TOP - 5e-4f, 0.f});
+  SweepResult down = sweepBox(world, sunk, {0.f, -1.f, 0.f});
+  check(down.blocked.y && down.displacement.y == 0.f,
+        "a box sunk less than the tolerance is stopped by the floor");
+  SweepResult slide = sweepBox(world, sunk, {3.f, 0.f, 3.f});
+  check(!slide.blocked.x && !slide.blocked.z,
+        "a box sunk less than the tolerance slides along the floor");
+}
+
+} // namespace
+
+int main() {
+  // Chunks -2 to 1 on x and z and -1 to 1 on y, so the floor and the wall
+  // cross chunk borders at negative coordinates
+  unordered_map<int, Chunk> chunks =
+      makeWorld(isSolid, {-2, -1, -2}, {1, 1, 1});
+  WorldView world{chunks};
+  testLanding(world);
+  testNoTunnelling(world);
+  testMovesOutOfOverlap(world);
+  return finishTest("collision_test");
+}
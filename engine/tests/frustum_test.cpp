@@ -0,0 +1,141 @@
+#include "check.hpp"
+#include "core/box_list.hpp"
+#include "core/camera.hpp"
+#include "core/frustum.hpp"
+#include <cstdint>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/geometric.hpp>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace engine;
+
+namespace {
+
+constexpr uint8_t UNTOUCHED = 0xAB;
+
+Frustum randomFrustum(mt19937 &random) {
+  uniform_real_distribution<float> angle{-3.1f, 3.1f};
+  uniform_real_distribution<float> coordinate{-100.f, 100.f};
+
+  Camera camera;
+  camera.setPerspectiveProjection(glm::radians(60.f), 1.5f, 0.1f, 300.f);
+  camera.setView({coordinate(random), coordinate(random), coordinate(random)},
+                 {angle(random), angle(random), 0.f});
+  return Frustum::fromMatrix(camera.getProjection() * camera.getView());
+}
+
+// Runs both paths over the first count boxes and checks that they agree and
+// that neither writes past count
+bool agree(const Frustum &frustum, const BoxList &boxes, uint32_t count) {
+  vector<uint8_t> simd(boxes.getCapacity() + 1, UNTOUCHED);
+  vector<uint8_t> scalar(boxes.getCapacity() + 1, UNTOUCHED);
+  frustum.testBoxes(boxes, count, simd.data());
+  frustum.testBoxesScalar(boxes, count, scalar.data());
+
+  for (uint32_t i = 0; i < count; i++)
+    if (simd[i] != scalar[i] || scalar[i] > 1)
+      return false;
+  for (uint32_t i = count; i < simd.size(); i++)
+    if (simd[i] != UNTOUCHED)
+      return false;
+  return true;
+}
+
+void testRandomBoxes(mt19937 &random) {
+  uniform_real_distribution<float> coordinate{-200.f, 200.f};
+  uniform_real_distribution<float> size{0.f, 40.f};
+
+  bool allAgree = true;
+  for (uint32_t count : {0u, 1u, 2u, 3u, 4u, 5u, 7u, 9u, 63u, 1000u, 1003u}) {
+    for (int round = 0; round < 20; round++) {
+      Frustum frustum = randomFrustum(random);
+      BoxList boxes{count};
+      for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 min{coordinate(random), coordinate(random),
+                      coordinate(random)};
+        boxes.set(i, min, min + glm::vec3{size(random)});
+      }
+      allAgree = allAgree && agree(frustum, boxes, count);
+    }
+  }
+  check(allAgree, "testBoxes matches testBoxesScalar on random boxes");
+}
+
+// Boxes centred on a plane of the frustum, and boxes whose nearest corner
+// just touches it from either side
+void testStraddlingBoxes(mt19937 &random) {
+  uniform_real_distribution<float> offset{-50.f, 50.f};
+  uniform_real_distribution<float> size{0.01f, 4.f};
+
+  bool allAgree = true;
+  for (int round = 0; round < 50; round++) {
+    Frustum frustum = randomFrustum(random);
+    // The spare box keeps the count off a multiple of 4
+    const uint32_t count = 6 * 3 + 1;
+    BoxList boxes{count};
+
+    for (int p = 0; p < 6; p++) {
+      glm::vec3 normal{frustum.planes[p]};
+      glm::vec3 tangent = glm::normalize(glm::cross(
+          normal, glm::abs(normal.x) < 0.9f ? glm::vec3{1.f, 0.f, 0.f}
+                                            : glm::vec3{0.f, 1.f, 0.f}));
+      glm::vec3 onPlane =
+          -frustum.planes[p].w * normal + tangent * offset(random);
+
+      glm::vec3 half{size(random)};
+      boxes.set(p * 3, onPlane - half, onPlane + half);
+
+      // Extends from the plane away from the normal, its positive corner
+      // lies on the plane give or take rounding
+      glm::vec3 extent{size(random)};
+      glm::vec3 toPositive{normal.x >= 0.f ? extent.x : -extent.x,
+                           normal.y >= 0.f ? extent.y : -extent.y,
+                           normal.z >= 0.f ? extent.z : -extent.z};
+      for (int side = 0; side < 2; side++) {
+        glm::vec3 corner = onPlane + normal * (side == 0 ? 1e-4f : -1e-4f);
+        glm::vec3 other = corner - toPositive;
+        boxes.set(p * 3 + 1 + side, glm::min(corner, other),
+                  glm::max(corner, other));
+      }
+    }
+    allAgree = allAgree && agree(frustum, boxes, count);
+  }
+  check(allAgree, "testBoxes matches testBoxesScalar on straddling boxes");
+}
+
+void testKnownBoxes() {
+  Camera camera;
+  camera.setPerspectiveProjection(glm::radians(60.f), 1.f, 0.1f, 100.f);
+  camera.setView(glm::vec3{0.f}, glm::vec3{0.f});
+  Frustum frustum =
+      Frustum::fromMatrix(camera.getProjection() * camera.getView());
+
+  // The camera looks along +z
+  BoxList boxes{5};
+  boxes.set(0, {-1.f, -1.f, 9.f}, {1.f, 1.f, 11.f});
+  boxes.set(1, {-1.f, -1.f, -11.f}, {1.f, 1.f, -9.f});
+  boxes.set(2, {-1.f, -1.f, 200.f}, {1.f, 1.f, 202.f});
+  boxes.set(3, {50.f, -1.f, 9.f}, {52.f, 1.f, 11.f});
+  // Every corner lies outside, but the box spans the whole view
+  boxes.set(4, {-100.f, -100.f, 20.f}, {100.f, 100.f, 21.f});
+
+  uint8_t visible[5];
+  frustum.testBoxes(boxes, 5, visible);
+  check(visible[0] == 1, "a box in front of the camera is visible");
+  check(visible[1] == 0, "a box behind the camera is culled");
+  check(visible[2] == 0, "a box past the far plane is culled");
+  check(visible[3] == 0, "a box off to the side is culled");
+  check(visible[4] == 1, "a box around the view is visible");
+}
+
+} // namespace
+
+int main() {
+  mt19937 random{35};
+  testRandomBoxes(random);
+  testStraddlingBoxes(random);
+  testKnownBoxes();
+  return finishTest("frustum_test");
+}
@@ -0,0 +1,163 @@
+#include "check.hpp"
+#include "core/camera.hpp"
+#include "core/occlusion_culler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace engine;
+
+namespace {
+
+constexpr uint32_t WIDTH = 64;
+constexpr uint32_t HEIGHT = 64;
+constexpr float NEAR = 0.1f;
+constexpr float FAR = 100.f;
+
+struct Box {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// 90 degrees with a square buffer, so a point at (x, y, z) lands on pixel
+// (32 + 32 * x / z, 32 - 32 * y / z). The camera sits at the origin and
+// looks along +z.
+glm::mat4 projectionView() {
+  Camera camera;
+  camera.setPerspectiveProjection(glm::radians(90.f), 1.f, NEAR, FAR);
+  camera.setView(glm::vec3{0.f}, glm::vec3{0.f});
+  return camera.getProjection() * camera.getView();
+}
+
+Box randomBox(mt19937 &random, float nearestZ) {
+  uniform_real_distribution<float> x{-30.f, 30.f};
+  uniform_real_distribution<float> z{nearestZ, 60.f};
+  uniform_real_distribution<float> size{0.2f, 12.f};
+  glm::vec3 min{x(random), x(random), z(random)};
+  return {min, min + glm::vec3{size(random), size(random), size(random)}};
+}
+
+// Depth of the nearest hit of the ray through a screen point with any box,
+// 2 if it hits none
+float nearestHit(const vector<Box> &boxes, float screenX, float screenY) {
+  glm::vec3 direction{screenX / (WIDTH / 2.f) - 1.f,
+                      1.f - screenY / (HEIGHT / 2.f), 1.f};
+  float nearest = 2.f;
+  for (const Box &box : boxes) {
+    float enter = NEAR;
+    float exit = INFINITY;
+    for (int axis = 0; axis < 3; axis++) {
+      float a = box.min[axis] / direction[axis];
+      float b = box.max[axis] / direction[axis];
+      enter = max(enter, min(a, b));
+      exit = min(exit, max(a, b));
+    }
+    // The direction has z = 1, so the ray parameter is the view depth
+    if (enter <= exit)
+      nearest = min(nearest, FAR / (FAR - NEAR) * (1.f - NEAR / enter));
+  }
+  return nearest;
+}
+
+void testSimdMatchesScalar(mt19937 &random) {
+  bool buffersMatch = true;
+  bool resultsMatch = true;
+  for (int round = 0; round < 20; round++) {
+    OcclusionCuller3D simd{WIDTH, HEIGHT};
+    OcclusionCuller3D scalar{WIDTH, HEIGHT};
+    simd.clear(projectionView());
+    scalar.clear(projectionView());
+
+    // Some occluders reach behind the camera and get cut at the near plane
+    for (int i = 0; i < 12; i++) {
+      Box box = randomBox(random, i < 3 ? -20.f : 1.f);
+      simd.addOccluder(box.min, box.max);
+      scalar.addOccluderScalar(box.min, box.max);
+    }
+    buffersMatch = buffersMatch &&
+                   simd.getDepthBuffer() == scalar.getDepthBuffer();
+
+    for (int i = 0; i < 200; i++) {
+      Box box = randomBox(random, 1.f);
+      bool occluded = simd.isOccluded(box.min, box.max);
+      resultsMatch = resultsMatch &&
+                     occluded == simd.isOccludedScalar(box.min, box.max) &&
+                     occluded == scalar.isOccluded(box.min, box.max);
+    }
+  }
+  check(buffersMatch, "addOccluder fills the same pixels as the scalar path");
+  check(resultsMatch, "isOccluded agrees with isOccludedScalar");
+}
+
+// Every covered pixel has to be covered over its whole area, at a depth no
+// nearer than the occluders really are
+void testCoverageIsConservative(mt19937 &random) {
+  const float inset = 0.01f;
+  bool conservative = true;
+  for (int round = 0; round < 10; round++) {
+    OcclusionCuller3D culler{WIDTH, HEIGHT};
+    culler.clear(projectionView());
+    vector<Box> boxes;
+    for (int i = 0; i < 8; i++) {
+      boxes.push_back(randomBox(random, 1.f));
+      culler.addOccluder(boxes.back().min, boxes.back().max);
+    }
+
+    const vector<float> &depth = culler.getDepthBuffer();
+    for (uint32_t y = 0; y < HEIGHT; y++) {
+      for (uint32_t x = 0; x < WIDTH; x++) {
+        float stored = depth[x + y * WIDTH];
+        if (stored == 1.f)
+          continue;
+        for (auto [sampleX, sampleY] :
+             {pair{x + inset, y + inset}, pair{x + 1 - inset, y + inset},
+              pair{x + inset, y + 1 - inset},
+              pair{x + 1 - inset, y + 1 - inset}, pair{x + 0.5f, y + 0.5f}})
+          if (nearestHit(boxes, sampleX, sampleY) > stored + 1e-5f)
+            conservative = false;
+      }
+    }
+  }
+  check(conservative, "occluders only cover pixels they cover completely");
+}
+
+void testKnownBoxes() {
+  OcclusionCuller3D culler{WIDTH, HEIGHT};
+  culler.clear(projectionView());
+  // The near face's right edge lands on x = 40.7, inside pixel column 40
+  culler.addOccluder({-20.f, -20.f, 10.f}, {2.71875f, 20.f, 11.f});
+
+  for (bool scalar : {false, true}) {
+    auto isOccluded = [&](const glm::vec3 &min, const glm::vec3 &max) {
+      return scalar ? culler.isOccludedScalar(min, max)
+                    : culler.isOccluded(min, max);
+    };
+
+    check(isOccluded({-2.f, -1.f, 20.f}, {-1.f, 1.f, 21.f}),
+          "a box behind an occluder is occluded");
+    check(!isOccluded({-1.f, -1.f, 5.f}, {1.f, 1.f, 6.f}),
+          "a box in front of an occluder is visible");
+    check(!isOccluded({10.f, -1.f, 20.f}, {12.f, 1.f, 21.f}),
+          "a box beside an occluder is visible");
+    // Falls on x = 40.76 to 40.96, behind the occluder at pixel centres but
+    // not past its edge
+    check(!isOccluded({5.5f, -1.f, 20.f}, {5.6f, 1.f, 20.1f}),
+          "a box peeking past an occluder within one pixel is visible");
+  }
+}
+
+} // namespace
+
+int main() {
+  mt19937 random{33};
+  testSimdMatchesScalar(random);
+  testCoverageIsConservative(random);
+  testKnownBoxes();
+  return finishTest("occlusion_test");
+}
@@ -0,0 +1,160 @@
+#include "check.hpp"
+#include "core/tlsf_allocator.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace engine;
+
+namespace {
+
+using Allocation = TlsfAllocator::Allocation;
+
+// Whether the allocations are in range and none of them overlap
+bool isDisjoint(vector<Allocation> allocations, uint64_t size) {
+  sort(allocations.begin(), allocations.end(),
+       [](const Allocation &a, const Allocation &b) {
+         return a.offset < b.offset;
+       });
+  for (size_t i = 0; i < allocations.size(); i++) {
+    if (allocations[i].offset + allocations[i].size > size)
+      return false;
+    if (i > 0 && allocations[i - 1].offset + allocations[i - 1].size >
+                     allocations[i].offset)
+      return false;
+  }
+  return true;
+}
+
+void testAlignedOffsets() {
+  TlsfAllocator allocator{1 << 16};
+  vector<Allocation> allocations;
+  bool aligned = true;
+  for (uint64_t alignment : {1, 4, 16, 256, 3, 1000}) {
+    for (uint64_t size : {1, 7, 100, 257}) {
+      Allocation allocation;
+      aligned = allocator.allocate(size, allocation, alignment) && aligned &&
+                allocation.offset % alignment == 0 &&
+                allocation.size == size;
+      allocations.push_back(allocation);
+    }
+  }
+  check(aligned, "allocations start on their alignment");
+  check(isDisjoint(allocations, allocator.getSize()),
+        "aligned allocations don't overlap");
+
+  // The only free block needs no padding, so it fits even though the
+  // worst case padding does not
+  TlsfAllocator exact{4096};
+  Allocation whole;
+  check(exact.allocate(4096, whole, 256) && whole.offset == 0,
+        "a block that needs no padding fits at its full size");
+}
+
+void testMergesNeighbours() {
+  TlsfAllocator allocator{300};
+  Allocation a, b, c;
+  allocator.allocate(100, a);
+  allocator.allocate(100, b);
+  allocator.allocate(100, c);
+  check(allocator.getStatistics().freeBlockCount == 0,
+        "three allocations fill the allocator");
+
+  allocator.free(a);
+  allocator.free(c);
+  TlsfAllocator::Statistics split = allocator.getStatistics();
+  check(split.freeBlockCount == 2 && split.largestFreeBlock == 100,
+        "freeing both ends leaves two free blocks");
+
+  // b's neighbours are free on both sides
+  allocator.free(b);
+  TlsfAllocator::Statistics merged = allocator.getStatistics();
+  check(merged.freeBlockCount == 1 && merged.largestFreeBlock == 300,
+        "freeing the middle merges it with both neighbours");
+
+  allocator.allocate(100, a);
+  allocator.allocate(100, b);
+  allocator.allocate(100, c);
+  allocator.free(b);
+  allocator.free(a);
+  check(allocator.getStatistics().largestFreeBlock == 200,
+        "a block merges with its free neighbour after it");
+  allocator.free(c);
+  check(allocator.getStatistics().largestFreeBlock == 300,
+        "a block merges with its free neighbour before it");
+}
+
+void testStatistics(mt19937 &random) {
+  constexpr uint64_t SIZE = 100000;
+  TlsfAllocator allocator{SIZE};
+  uniform_int_distribution<uint64_t> size{1, 2000};
+  uniform_int_distribution<int> alignmentLog2{0, 8};
+  vector<Allocation> allocations;
+  for (int i = 0; i < 2000; i++) {
+    if (!allocations.empty() && random() % 3 == 0) {
+      size_t index = random() % allocations.size();
+      allocator.free(allocations[index]);
+      allocations[index] = allocations.back();
+      allocations.pop_back();
+      continue;
+    }
+    Allocation allocation;
+    if (allocator.allocate(size(random), allocation,
+                           uint64_t{1} << alignmentLog2(random)))
+      allocations.push_back(allocation);
+  }
+
+  uint64_t used = 0;
+  for (const Allocation &allocation : allocations)
+    used += allocation.size;
+  TlsfAllocator::Statistics statistics = allocator.getStatistics();
+  check(isDisjoint(allocations, SIZE),
+        "mixed allocations and frees never overlap");
+  check(statistics.totalSize == SIZE && statistics.usedSize == used &&
+            statistics.freeSize == SIZE - used &&
+            statistics.allocationCount == allocations.size(),
+        "statistics count the live allocations after mixed operations");
+  check(statistics.freeBlockCount > 0 &&
+            statistics.largestFreeBlock <= statistics.freeSize &&
+            statistics.fragmentation() >= 0.f &&
+            statistics.fragmentation() < 1.f,
+        "statistics describe the free blocks after mixed operations");
+
+  for (Allocation &allocation : allocations)
+    allocator.free(allocation);
+  TlsfAllocator::Statistics empty = allocator.getStatistics();
+  check(allocator.isEmpty() && empty.usedSize == 0 &&
+            empty.freeBlockCount == 1 && empty.largestFreeBlock == SIZE,
+        "freeing everything leaves a single free block");
+
+  Allocation whole;
+  check(allocator.allocate(SIZE, whole) && whole.offset == 0 &&
+            whole.size == SIZE,
+        "the full size can be allocated once everything is freed");
+}
+
+void testFullSize() {
+  // Sizes on and off the boundaries of the free lists
+  bool allFit = true;
+  for (uint64_t size : {1, 31, 32, 33, 1000, 4096, 123457, 1 << 20}) {
+    TlsfAllocator allocator{size};
+    Allocation whole;
+    allFit = allFit && allocator.allocate(size, whole) && whole.size == size;
+    Allocation more;
+    allFit = allFit && !allocator.allocate(1, more);
+  }
+  check(allFit, "an empty allocator hands out its full size");
+}
+
+} // namespace
+
+int main() {
+  mt19937 random{26};
+  testAlignedOffsets();
+  testMergesNeighbours();
+  testStatistics(random);
+  testFullSize();
+  return finishTest("tlsf_allocator_test");
+}
@@ -0,0 +1,230 @@
+#include "block.hpp"
+#include "check.hpp"
+#include "chunk.hpp"
+#include "chunk_world.hpp"
+#include "voxel_raycast.hpp"
+#include "world_view.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/common.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <glm/geometric.hpp>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace engine;
+
+namespace {
+
+// Step of the brute force march, in blocks
+constexpr float MARCH_STEP = 1e-3f;
+
+// About one block in eight is solid, scattered by a hash of the position
+bool isSolid(const glm::ivec3 &block) {
+  uint32_t hash = static_cast<uint32_t>(block.x) * 73856093u ^
+                  static_cast<uint32_t>(block.y) * 19349663u ^
+                  static_cast<uint32_t>(block.z) * 83492791u;
+  hash ^= hash >> 13;
+  hash *= 0x5bd1e995u;
+  return (hash >> 15) % 8 == 0;
+}
+
+// Distances along the ray at which it enters and leaves the block
+pair<float, float> chord(const Ray &ray, const glm::ivec3 &block) {
+  glm::vec3 direction = glm::normalize(ray.direction);
+  float enter = -INFINITY;
+  float exit = INFINITY;
+  for (int axis = 0; axis < 3; axis++) {
+    if (direction[axis] == 0.f) {
+      if (ray.origin[axis] < block[axis] ||
+          ray.origin[axis] >= block[axis] + 1)
+        return {INFINITY, -INFINITY};
+      continue;
+    }
+    float a = (block[axis] - ray.origin[axis]) / direction[axis];
+    float b = (block[axis] + 1 - ray.origin[axis]) / direction[axis];
+    enter = max(enter, min(a, b));
+    exit = min(exit, max(a, b));
+  }
+  return {enter, exit};
+}
+
+// Samples the ray every MARCH_STEP blocks up to maxDistance included, and
+// stops in the first solid block
+RayHit march(const WorldView &world, const Ray &ray) {
+  glm::vec3 direction = glm::normalize(ray.direction);
+  int steps = static_cast<int>(ceil(ray.maxDistance / MARCH_STEP));
+  RayHit hit;
+  for (int i = 0; i <= steps; i++) {
+    float t = min(i * MARCH_STEP, ray.maxDistance);
+    glm::ivec3 block{glm::floor(ray.origin + direction * t)};
+    BlockType type = world.getBlock(block);
+    if (type != BlockType::Air) {
+      hit.hit = true;
+      hit.block = block;
+      hit.distance = t;
+      hit.type = type;
+      return hit;
+    }
+  }
+  return hit;
+}
+
+// The march finds the same block a little later, or misses a corner of it
+// shorter than its step. The face has to be the one the ray enters through,
+// which a ray starting on a face enters at distance 0.
+bool agreesWithMarch(const WorldView &world, const Ray &ray) {
+  RayHit hit = raycast(world, ray);
+  RayHit marched = march(world, ray);
+  if (!hit.hit)
+    return !marched.hit;
+
+  auto [enter, exit] = chord(ray, hit.block);
+  bool sameBlock = marched.hit && marched.block == hit.block &&
+                   marched.distance >= hit.distance - 1e-4f &&
+                   marched.distance <= hit.distance + 2 * MARCH_STEP;
+  bool skippedCorner =
+      exit - enter < MARCH_STEP &&
+      (!marched.hit || marched.distance > hit.distance);
+  if (!sameBlock && !skippedCorner)
+    return false;
+  if (world.getBlock(hit.block) != hit.type ||
+      abs(max(enter, 0.f) - hit.distance) > 1e-3f)
+    return false;
+
+  if (hit.block == glm::ivec3{glm::floor(ray.origin)})
+    return hit.distance == 0.f && hit.face == glm::ivec3{0};
+  glm::vec3 face{hit.face};
+  return glm::dot(face, face) == 1.f && glm::dot(face, ray.direction) < 0.f;
+}
+
+glm::vec3 randomPoint(mt19937 &random) {
+  uniform_real_distribution<float> coordinate{-60.f, 60.f};
+  return {coordinate(random), coordinate(random), coordinate(random)};
+}
+
+void testRandomRays(const WorldView &world, mt19937 &random) {
+  uniform_real_distribution<float> component{-1.f, 1.f};
+  bool allAgree = true;
+  for (int i = 0; i < 500; i++) {
+    Ray ray{randomPoint(random),
+            {component(random), component(random), component(random)},
+            30.f};
+    allAgree = allAgree && agreesWithMarch(world, ray);
+  }
+  check(allAgree, "raycast matches the march on random rays");
+}
+
+void testAxisAlignedRays(const WorldView &world, mt19937 &random) {
+  bool allAgree = true;
+  for (int i = 0; i < 100; i++) {
+    glm::vec3 origin = randomPoint(random);
+    // Every other ray starts on a block corner
+    if (i % 2 == 0)
+      origin = glm::floor(origin);
+    for (int axis = 0; axis < 3; axis++) {
+      for (float sign : {1.f, -1.f}) {
+        glm::vec3 direction{0.f};
+        direction[axis] = sign;
+        allAgree =
+            allAgree && agreesWithMarch(world, {origin, direction, 30.f});
+      }
+    }
+  }
+  check(allAgree, "raycast matches the march on axis aligned rays");
+}
+
+void testRaysFromInsideBlocks(const WorldView &world, mt19937 &random) {
+  uniform_real_distribution<float> component{-1.f, 1.f};
+  bool hitsStart = true;
+  int tested = 0;
+  while (tested < 100) {
+    glm::vec3 origin = randomPoint(random);
+    if (world.getBlock(glm::ivec3{glm::floor(origin)}) == BlockType::Air)
+      continue;
+    tested++;
+
+    RayHit hit = raycast(
+        world, {origin,
+                {component(random), component(random), component(random)},
+                30.f});
+    hitsStart = hitsStart && hit.hit &&
+                hit.block == glm::ivec3{glm::floor(origin)} &&
+                hit.distance == 0.f && hit.face == glm::ivec3{0};
+  }
+  check(hitsStart, "a ray starting inside a block hits it at distance 0");
+}
+
+void testNegativeChunkBorders(const WorldView &world, mt19937 &random) {
+  uniform_real_distribution<float> nearBorder{-34.f, -30.f};
+  uniform_real_distribution<float> component{-1.f, 1.f};
+  bool allAgree = true;
+  for (int i = 0; i < 300; i++) {
+    // Starts next to the corner where eight chunks around (-1, -1, -1) meet
+    glm::vec3 origin{nearBorder(random), nearBorder(random),
+                     nearBorder(random)};
+    glm::vec3 direction{component(random), component(random),
+                        component(random)};
+    allAgree = allAgree && agreesWithMarch(world, {origin, direction, 20.f});
+  }
+
+  // Along the x border of chunks 0 and -1, then along the z border of
+  // chunks -1 and -2
+  for (glm::vec3 origin : {glm::vec3{0.f, -0.5f, -40.5f},
+                           glm::vec3{-10.5f, -20.5f, -32.f}})
+    for (glm::vec3 direction : {glm::vec3{0.f, 0.f, 1.f},
+                                glm::vec3{1.f, 0.f, 0.f},
+                                glm::vec3{-1.f, 0.f, 0.f}})
+      allAgree = allAgree && agreesWithMarch(world, {origin, direction, 30.f});
+  check(allAgree, "raycast matches the march across negative chunk borders");
+}
+
+void testThreadedBatch(const unordered_map<int, Chunk> &chunks,
+                       mt19937 &random) {
+  uniform_real_distribution<float> component{-1.f, 1.f};
+  vector<Ray> rays;
+  for (int i = 0; i < 1001; i++)
+    rays.push_back({randomPoint(random),
+                    {component(random), component(random), component(random)},
+                    30.f});
+
+  vector<RayHit> serial(rays.size());
+  raycast(WorldView{chunks}, rays.data(), rays.size(), serial.data());
+
+  // Counts that don't split evenly, and more threads than rays
+  bool allMatch = true;
+  for (auto [count, threadCount] :
+       {pair{1001u, 1u}, pair{1001u, 3u}, pair{1001u, 8u}, pair{5u, 16u},
+        pair{0u, 4u}}) {
+    vector<RayHit> threaded(rays.size());
+    raycast(chunks, rays.data(), count, threaded.data(), threadCount);
+    for (size_t i = 0; i < count; i++)
+      allMatch = allMatch && threaded[i].hit == serial[i].hit &&
+                 threaded[i].block == serial[i].block &&
+                 threaded[i].face == serial[i].face &&
+                 threaded[i].distance == serial[i].distance;
+  }
+  check(allMatch, "the threaded batch matches casting the rays in turn");
+}
+
+} // namespace
+
+int main() {
+  // Chunks -2 to 1 on every axis, so rays cross chunk borders at negative
+  // coordinates
+  unordered_map<int, Chunk> chunks =
+      makeWorld(isSolid, {-2, -2, -2}, {1, 1, 1});
+  WorldView world{chunks};
+  mt19937 random{50};
+  testRandomRays(world, random);
+  testAxisAlignedRays(world, random);
+  testRaysFromInsideBlocks(world, random);
+  testNegativeChunkBorders(world, random);
+  testThreadedBatch(chunks, random);
+  return finishTest("voxel_raycast_test");
+}